@@ -1,7 +1,14 @@
+import os
+import pickle
+import tempfile
+import threading
+import time
 import unittest
+import zlib
 import numpy as np
 import fastvoxel as fv
-from fastvoxel.np_voxel import np_voxel
+from fastvoxel.np_voxel import np_voxel, get_label_statistics, get_label_runs, extract_volume, export_npy, chunk_store, get_runs, \
+    create_mesh, get_mesh_arrays, query_points
 
 
 class TestNpVoxel(unittest.TestCase):
@@ -57,9 +64,11 @@ class TestNpVoxel(unittest.TestCase):
             [100, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100]
         ], dtype=np.short)
 
-    def _create_voxelizator(self):
+    def _create_voxelizator(self, thread_count=0, label=True, parity=False):
         """Creates and configures a voxelizator with the test cube"""
         voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+        voxelizator.set_thread_count(thread_count)
+        voxelizator.set_parity_mode(parity)
         voxelizator.first_step_params(self.boxmin, self.boxmax)
 
         # Add the cube faces
@@ -71,7 +80,8 @@ class TestNpVoxel(unittest.TestCase):
                 facedata[4]
             )
 
-        voxelizator.third_step_volumescreator()
+        if label:
+            voxelizator.third_step_volumescreator()
         return voxelizator
 
     def test_cube_middle_slice(self):
@@ -205,6 +215,728 @@ class TestNpVoxel(unittest.TestCase):
             "All interior values should be 102"
         )
 
+    def test_labels_independent_of_thread_count(self):
+        """Test that the volume ids do not depend on the number of labeling threads"""
+        size = self._create_voxelizator().get_domain_size()
+        matrices = []
+        for thread_count in (1, 3, 8):
+            voxelizator = self._create_voxelizator(thread_count)
+            matrix = np.empty((size, size, size), dtype=np.short)
+            voxelizator.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+            matrices.append(matrix)
+            self.assertEqual(voxelizator.get_volume_count(), 2)
+        for matrix in matrices[1:]:
+            self.assertTrue(np.array_equal(matrices[0], matrix))
+
+    def test_copy_matrix_concurrent(self):
+        """Test copies of the same field from several Python threads"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        filt_array = np.arange(103, dtype=np.short) % 5
+        results = [np.empty((size - 2, size - 3, size - 4), dtype=np.short) for _ in range(4)]
+
+        def copy(result):
+            voxelizator.copy_matrix_filtered(result, fv.ivec3(2, 3, 4), filt_array)
+        threads = [threading.Thread(target=copy, args=(result,)) for result in results]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for result in results:
+            self.assertTrue(np.array_equal(result, filt_array[expected[2:, 3:, 4:]]))
+
+    def test_np_voxel_indexing(self):
+        """Test that np_voxel gives the numpy result for steps, negative indices and index arrays"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        voxel_array = np_voxel(voxelizator)
+        keys = [np.s_[::2, ::3, ::4],
+                np.s_[::-1, 5, 12:1:-3],
+                np.s_[-1, :, ::5],
+                np.s_[[3, 1, 3, 12], ::4, -5],
+                np.s_[[1, 2], [3, 4], :],
+                np.s_[np.arange(size) % 3 == 0, 7, 7],
+                np.s_[6]]
+        for key in keys:
+            self.assertTrue(np.array_equal(voxel_array[key], expected[key]), key)
+        with self.assertRaises(IndexError):
+            voxel_array[size, 0, 0]
+        filt_array = np.arange(103, dtype=np.short) % 5
+        voxel_array.set_filter(filt_array)
+        for key in keys:
+            self.assertTrue(np.array_equal(voxel_array[key], filt_array[expected[key]]), key)
+
+    def test_block_cache(self):
+        """Test that a sweep of slices read through the brick cache gives the field values"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        voxel_array = np_voxel(voxelizator, cache_size=1024 * 1024)
+        for repeat in range(2):
+            for j in range(size):
+                self.assertTrue(np.array_equal(voxel_array[:, j, :], expected[:, j, :]))
+        self.assertGreater(voxel_array._block_cache.get_hit_count(), 0)
+        # Bricks of 4x4x4 cells, only 3 of them are kept
+        cache = fv.BlockCache(voxelizator, 3 * 4 * 4 * 4 * 2, 4)
+        block = np.empty((size, 2, size), dtype=np.short)
+        for j in range(0, size - 1, 2):
+            cache.copy_matrix(block, fv.ivec3(0, j, 0))
+            self.assertTrue(np.array_equal(block, expected[:, j:j + 2, :]))
+        self.assertLessEqual(cache.get_brick_count(), 3)
+        # The bricks are decoded again after the field changed
+        voxelizator.third_step_volumescreator()
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        self.assertTrue(np.array_equal(voxel_array[:, :, :], expected))
+        # The cache keeps its field alive
+        cache = fv.BlockCache(self._create_voxelizator())
+        cache.copy_matrix(block, fv.ivec3(0, 0, 0))
+        self.assertTrue(np.array_equal(block, expected[:, 0:2, :]))
+
+    def test_label_volumes_from_seeds(self):
+        """Test that only the seeded volumes are labeled"""
+        voxelizator = self._create_voxelizator(label=False)
+        self.assertTrue(voxelizator.is_seed_enclosed(fv.dvec3(2.5, 2.5, 2.5)))
+        self.assertFalse(voxelizator.is_seed_enclosed(fv.dvec3(-0.5, 2.5, 2.5)))
+        labels = voxelizator.label_volumes_from_seeds([fv.dvec3(2.5, 2.5, 2.5), fv.dvec3(-0.5, 2.5, 2.5)])
+        self.assertEqual(tuple(labels), (102, 101))
+        self.assertEqual(voxelizator.get_volume_count(), 2)
+        self.assertEqual(voxelizator.get_matrix_value(voxelizator.get_cell_id_by_coord(fv.dvec3(1, 1, 1))), 102)
+
+    def test_label_statistics(self):
+        """Test the statistics accumulated while labeling"""
+        voxelizator = self._create_voxelizator()
+        stats = get_label_statistics(voxelizator)
+        self.assertEqual(len(stats["cell_count"]), voxelizator.get_label_count())
+        # Interior of the cube, 9x9x9 cells of 0.5 m
+        self.assertEqual(stats["cell_count"][102], 729)
+        self.assertAlmostEqual(stats["volume"][102], 91.125)
+        self.assertEqual(list(stats["bounding_box"][102]), [3, 3, 3, 12, 12, 12])
+        self.assertTrue(np.allclose(stats["centroid"][102], [2.5, 2.5, 2.5]))
+        self.assertEqual(stats["boundary_face_count"][102], 6 * 81)
+        self.assertAlmostEqual(voxelizator.get_volume_value(1), stats["volume"][102])
+
+    def test_small_volume_merge(self):
+        """Test that the volumes below the minimal size are merged in the surrounding surface"""
+        voxelizator = self._create_voxelizator(label=False)
+        voxelizator.set_minimal_cell_count(730)
+        voxelizator.third_step_volumescreator()
+        self.assertEqual(voxelizator.get_merged_volume_count(), 1)
+        self.assertEqual(voxelizator.get_volume_count(), 1)
+        # The side walls share more faces with the interior than the floor and ceiling
+        center = voxelizator.get_cell_id_by_coord(fv.dvec3(2.5, 2.5, 2.5))
+        self.assertEqual(voxelizator.get_matrix_value(center), 100)
+        # Interior volume is 91.125 m3, merged in a given surface
+        voxelizator = self._create_voxelizator(label=False)
+        voxelizator.set_minimal_volume(100)
+        voxelizator.set_small_volume_value(66)
+        voxelizator.third_step_volumescreator()
+        self.assertEqual(voxelizator.get_merged_volume_count(), 1)
+        self.assertEqual(voxelizator.get_matrix_value(center), 66)
+        self.assertRaises(ValueError, voxelizator.set_small_volume_value, -2)
+
+    def test_transparent_markers(self):
+        """Test the labeling again with open surfaces, without pushing the triangles again"""
+        voxelizator = self._create_voxelizator()
+        center = fv.dvec3(2.5, 2.5, 2.5)
+        cellid = voxelizator.get_cell_id_by_coord(center)
+        self.assertEqual(voxelizator.get_matrix_value(cellid), 102)
+        # Floor and ceiling are open, the interior is part of the exterior volume
+        voxelizator.set_transparent_markers([66])
+        self.assertFalse(voxelizator.is_seed_enclosed(center))
+        voxelizator.third_step_volumescreator()
+        self.assertEqual(voxelizator.get_volume_count(), 1)
+        self.assertEqual(voxelizator.get_matrix_value(cellid), 101)
+        self.assertEqual(voxelizator.get_matrix_value(voxelizator.get_cell_id_by_coord(fv.dvec3(2.5, 2.5, 0))), 66)
+        # Closed again
+        voxelizator.set_transparent_markers([])
+        voxelizator.third_step_volumescreator()
+        self.assertEqual(voxelizator.get_volume_count(), 2)
+        self.assertEqual(voxelizator.get_matrix_value(cellid), 102)
+
+    def test_parity_volumes(self):
+        """Test the ray casting labeling against the propagation on the closed cube"""
+        voxelizator = self._create_voxelizator(label=False, parity=True)
+        voxelizator.third_step_parity_volumescreator()
+        self.assertEqual(voxelizator.get_parity_fallback_column_count(), 0)
+        self.assertEqual(voxelizator.get_volume_count(), 2)
+        self.assertEqual(voxelizator.get_matrix_value(voxelizator.get_cell_id_by_coord(fv.dvec3(2.5, 2.5, 2.5))), 102)
+        size = voxelizator.get_domain_size()
+        parity_matrix = np.zeros((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(parity_matrix, fv.ivec3(0, 0, 0))
+        flood_matrix = np.zeros((size, size, size), dtype=np.short)
+        self._create_voxelizator().copy_matrix(flood_matrix, fv.ivec3(0, 0, 0))
+        self.assertTrue(np.array_equal(parity_matrix, flood_matrix))
+        # The crossings are kept to label again
+        voxelizator.set_transparent_markers([66])
+        voxelizator.third_step_parity_volumescreator()
+        self.assertEqual(voxelizator.get_volume_count(), 2)
+        voxelizator.copy_matrix(parity_matrix, fv.ivec3(0, 0, 0))
+        self.assertTrue(np.array_equal(parity_matrix, flood_matrix))
+        # A triangle pushed after the labeling is not in the crossings
+        voxelizator.second_step_pushtri(fv.dvec3(1, 1, 1), fv.dvec3(2, 1, 1), fv.dvec3(1, 2, 1), 100)
+        with self.assertRaises(RuntimeError):
+            voxelizator.third_step_parity_volumescreator()
+
+    def test_extract_volume(self):
+        """Test the extraction of the padded block of a volume"""
+        voxelizator = self._create_voxelizator()
+        origin, block = extract_volume(voxelizator, 102, padding=1)
+        self.assertEqual(origin, (2, 2, 2))
+        self.assertEqual(block.shape, (11, 11, 11))
+        self.assertTrue(np.array_equal(block[:, :, 5], self.expected_res))
+        runs = get_label_runs(voxelizator, 102)
+        self.assertEqual(runs.shape, (81, 4))
+        self.assertEqual(int(np.sum(runs[:, 3] - runs[:, 2])), 729)
+        # Filtered extraction, the walls are dropped
+        filt = np.full(voxelizator.get_label_count(), -1, dtype=np.short)
+        filt[102] = 1
+        origin, block = extract_volume(voxelizator, 102, padding=1, filt_array=filt)
+        self.assertEqual(int(np.sum(block == 1)), 729)
+        self.assertEqual(int(np.sum(block == -1)), 11 ** 3 - 729)
+
+    def test_save_load(self):
+        """Test that a saved field reads back the same cells and volumes, from a file or a pickle"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, "cube.fvx")
+            voxelizator.save(filename)
+            loaded = fv.TriangleScalarFieldCreator(1.)
+            loaded.load(filename)
+            unpickled = pickle.loads(pickle.dumps(voxelizator))
+            for field in (loaded, unpickled):
+                self.assertEqual(field.get_domain_size(), size)
+                self.assertEqual(field.get_volume_count(), 2)
+                self.assertAlmostEqual(field.get_volume_value(1), voxelizator.get_volume_value(1))
+                matrix = np.empty((size, size, size), dtype=np.short)
+                field.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+                self.assertTrue(np.array_equal(matrix, expected))
+            # The loaded field can be labeled again
+            loaded.set_transparent_markers([66])
+            loaded.third_step_volumescreator()
+            self.assertEqual(loaded.get_volume_count(), 1)
+            del loaded
+
+    def test_pickle_options(self):
+        """Test that a pickle keeps the settings of the field that are not part of the serialization"""
+        voxelizator = self._create_voxelizator(thread_count=2, parity=True)
+        voxelizator.set_minimal_volume(0.5)
+        voxelizator.set_minimal_cell_count(3)
+        voxelizator.set_small_volume_value(66)
+        voxelizator.set_transparent_markers([66, 100])
+        voxelizator.set_model_bounds(fv.dvec3(-1, -1, -1), fv.dvec3(6, 6, 6))
+        with tempfile.TemporaryDirectory() as tmpdir:
+            voxelizator.set_cache(tmpdir, 1 << 20)
+            unpickled = pickle.loads(pickle.dumps(voxelizator))
+            self.assertIsInstance(unpickled, fv.TriangleScalarFieldCreator)
+            self.assertEqual(unpickled.get_thread_count(), 2)
+            self.assertTrue(unpickled.get_parity_mode())
+            self.assertAlmostEqual(unpickled.get_minimal_volume(), 0.5)
+            self.assertEqual(unpickled.get_minimal_cell_count(), 3)
+            self.assertEqual(unpickled.get_small_volume_value(), 66)
+            self.assertEqual(list(unpickled.get_transparent_markers()), [66, 100])
+            self.assertEqual(unpickled.get_cache_directory(), tmpdir)
+            self.assertEqual(unpickled.get_cache_max_size(), 1 << 20)
+            box_min, box_max = fv.dvec3(), fv.dvec3()
+            self.assertTrue(unpickled.get_model_bounds(box_min, box_max))
+            self.assertEqual([box_min[i] for i in range(3)], [-1, -1, -1])
+            self.assertEqual([box_max[i] for i in range(3)], [6, 6, 6])
+            self.assertEqual(unpickled.get_volume_count(), voxelizator.get_volume_count())
+        # Default settings round-trip too
+        unpickled = pickle.loads(pickle.dumps(self._create_voxelizator()))
+        self.assertFalse(unpickled.get_parity_mode())
+        self.assertEqual(unpickled.get_cache_directory(), "")
+        self.assertFalse(unpickled.get_model_bounds(fv.dvec3(), fv.dvec3()))
+        self.assertEqual(list(unpickled.get_transparent_markers()), [])
+
+    def test_load_corrupted(self):
+        """Test that a truncated or corrupted serialization is rejected"""
+        voxelizator = self._create_voxelizator()
+        state = np.empty(voxelizator.get_serialized_size(), dtype=np.uint8)
+        voxelizator.serialize(state)
+        field = fv.TriangleScalarFieldCreator(1.)
+        with self.assertRaises(RuntimeError):
+            field.deserialize(state[:-9])
+        # Run ends of the first column set to zero, the 208 bytes header is followed by the column offsets
+        corrupted = state.copy()
+        run_end_offset = (208 + 8 * (voxelizator.get_domain_size() ** 2 + 1) + 7) // 8 * 8
+        corrupted[run_end_offset:run_end_offset + 8] = 0
+        with self.assertRaises(RuntimeError):
+            field.deserialize(corrupted)
+
+    def test_seed_enclosed_without_surfaces(self):
+        """Test the enclosed seeds of a loaded field saved without its surface runs"""
+        voxelizator = self._create_voxelizator()
+        state = np.empty(voxelizator.get_serialized_size(), dtype=np.uint8)
+        voxelizator.serialize(state)
+        # Remove the surface runs section, the counts of the 208 bytes header start at byte 160
+        header = state[:208].copy()
+        offset_count, run_count, surface_run_count = header[160:184].view(np.uint64)
+        self.assertEqual(surface_run_count, run_count)
+        surface_offset = 208 + 8 * int(offset_count)
+        for item_size in (4, 2):
+            surface_offset = (surface_offset + item_size * int(run_count) + 7) // 8 * 8
+        label_offset = (surface_offset + 2 * int(run_count) + 7) // 8 * 8
+        header[176:184] = 0
+        field = fv.TriangleScalarFieldCreator(1.)
+        field.deserialize(np.concatenate((header, state[208:surface_offset], state[label_offset:])))
+        self.assertTrue(field.is_seed_enclosed(fv.dvec3(2.5, 2.5, 2.5)))
+        self.assertFalse(field.is_seed_enclosed(fv.dvec3(-0.2, 2.5, 2.5)))
+        self.assertFalse(field.is_seed_enclosed(fv.dvec3(0, 0, 0)))
+
+    def _write_cube_ply(self, filename):
+        """Writes the test cube in an ascii PLY file, the face markers in the layer_id property"""
+        with open(filename, "w") as f:
+            f.write("ply\nformat ascii 1.0\n")
+            f.write("element vertex %d\nproperty float x\nproperty float y\nproperty float z\n" % len(self.sommets))
+            f.write("element face %d\nproperty list uchar int vertex_indices\nproperty int layer_id\n" % len(self.faces))
+            f.write("end_header\n")
+            for vertex in self.sommets:
+                f.write("%g %g %g\n" % (vertex.x, vertex.y, vertex.z))
+            for facedata in self.faces:
+                f.write("3 %d %d %d %d\n" % (facedata[0], facedata[1], facedata[2], facedata[4]))
+
+    def _write_binary_cube_ply(self, filename):
+        """Writes the test cube in a binary little endian PLY file, with a vertex property that is not read"""
+        with open(filename, "wb") as f:
+            f.write(b"ply\nformat binary_little_endian 1.0\n")
+            f.write(b"element vertex %d\nproperty double x\nproperty double y\nproperty double z\nproperty uchar red\n" % len(self.sommets))
+            f.write(b"element face %d\nproperty list uchar int vertex_indices\nproperty int layer_id\n" % len(self.faces))
+            f.write(b"end_header\n")
+            vertices = np.zeros(len(self.sommets), dtype=[("xyz", "<f8", 3), ("red", "u1")])
+            vertices["xyz"] = [[vertex.x, vertex.y, vertex.z] for vertex in self.sommets]
+            f.write(vertices.tobytes())
+            faces = np.zeros(len(self.faces), dtype=[("count", "u1"), ("indices", "<i4", 3), ("layer_id", "<i4")])
+            faces["count"] = 3
+            faces["indices"] = [facedata[:3] for facedata in self.faces]
+            faces["layer_id"] = [facedata[4] for facedata in self.faces]
+            f.write(faces.tobytes())
+
+    def test_binary_ply(self):
+        """Test that a binary little endian PLY file gives the same mesh as the ascii file"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ascii_filename = os.path.join(tmpdir, "cube.ply")
+            binary_filename = os.path.join(tmpdir, "cube_binary.ply")
+            self._write_cube_ply(ascii_filename)
+            self._write_binary_cube_ply(binary_filename)
+            ascii_mesh = fv.Mesh()
+            binary_mesh = fv.Mesh()
+            self.assertTrue(ascii_mesh.load_ply(ascii_filename))
+            self.assertTrue(binary_mesh.load_ply(binary_filename))
+            ascii_arrays = get_mesh_arrays(ascii_mesh)
+            binary_arrays = get_mesh_arrays(binary_mesh)
+            for name in ("vertices", "faces", "markers"):
+                self.assertTrue(np.array_equal(ascii_arrays[name], binary_arrays[name]), name)
+            # A truncated file is not loaded
+            with open(binary_filename, "rb") as f:
+                content = f.read()
+            with open(binary_filename, "wb") as f:
+                f.write(content[:-10])
+            self.assertFalse(fv.Mesh().load_ply(binary_filename))
+
+    def test_ascii_ply(self):
+        """Test that an ascii PLY file with windows line ends and extra spaces gives the same mesh as the binary file"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ascii_filename = os.path.join(tmpdir, "cube.ply")
+            binary_filename = os.path.join(tmpdir, "cube_binary.ply")
+            self._write_cube_ply(ascii_filename)
+            self._write_binary_cube_ply(binary_filename)
+            with open(ascii_filename, "r") as f:
+                lines = f.read().splitlines()
+            with open(ascii_filename, "w", newline="") as f:
+                f.write("\r\n".join(" %s  " % line if line[:1].isdigit() else line for line in lines) + "\r\n\r\n")
+            ascii_mesh = fv.Mesh()
+            ascii_mesh.set_thread_count(1)
+            binary_mesh = fv.Mesh()
+            self.assertTrue(ascii_mesh.load_ply(ascii_filename))
+            self.assertTrue(binary_mesh.load_ply(binary_filename))
+            ascii_arrays = get_mesh_arrays(ascii_mesh)
+            binary_arrays = get_mesh_arrays(binary_mesh)
+            for name in ("vertices", "faces", "markers"):
+                self.assertTrue(np.array_equal(ascii_arrays[name], binary_arrays[name]), name)
+
+    def test_cache(self):
+        """Test that a model loaded twice with a cache directory is read back from the cache"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ply_filename = os.path.join(tmpdir, "cube.ply")
+            self._write_cube_ply(ply_filename)
+            cache_dir = os.path.join(tmpdir, "cache")
+            matrices = []
+            for run in range(2):
+                voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+                voxelizator.set_cache(cache_dir)
+                self.assertTrue(voxelizator.load_ply_model(ply_filename))
+                self.assertEqual(len([name for name in os.listdir(cache_dir) if name.endswith(".fvx")]), 1)
+                size = voxelizator.get_domain_size()
+                matrix = np.empty((size, size, size), dtype=np.short)
+                voxelizator.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+                matrices.append(matrix)
+                del voxelizator
+            self.assertTrue(np.array_equal(matrices[0], matrices[1]))
+            self.assertEqual(matrices[0][5, 5, 5], 102)
+            # Other labeling parameters give another cache entry
+            voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+            voxelizator.set_cache(cache_dir)
+            voxelizator.set_parity_mode(True)
+            self.assertTrue(voxelizator.load_ply_model(ply_filename))
+            self.assertEqual(len([name for name in os.listdir(cache_dir) if name.endswith(".fvx")]), 2)
+            del voxelizator
+            # A cache that can not be written does not fail the load
+            voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+            voxelizator.set_cache(os.path.join(ply_filename, "cache"))
+            self.assertTrue(voxelizator.load_ply_model(ply_filename))
+            self.assertEqual(voxelizator.get_matrix_value(fv.ivec3(5, 5, 5)), 102)
+
+    def test_cache_eviction(self):
+        """Test that the least recently used field is removed when the cache is over its size cap"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ply_filename = os.path.join(tmpdir, "cube.ply")
+            self._write_cube_ply(ply_filename)
+            cache_dir = os.path.join(tmpdir, "cache")
+
+            def load(minimal_cell_count, max_size=0):
+                # The minimal cell count is part of the cache key, returns the cache file of the load
+                cached = set(os.listdir(cache_dir)) if os.path.isdir(cache_dir) else set()
+                voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+                voxelizator.set_cache(cache_dir, max_size)
+                voxelizator.set_minimal_cell_count(minimal_cell_count)
+                self.assertTrue(voxelizator.load_ply_model(ply_filename))
+                stored = set(os.listdir(cache_dir)) - cached
+                return stored.pop() if stored else None
+
+            names = [load(minimal_cell_count) for minimal_cell_count in range(3)]
+            sizes = [os.path.getsize(os.path.join(cache_dir, name)) for name in names]
+            for name in names:
+                os.remove(os.path.join(cache_dir, name))
+            # Room for two of the three fields
+            max_size = sum(sizes) - 1
+            now = time.time()
+            for minimal_cell_count in range(2):
+                load(minimal_cell_count, max_size)
+                os.utime(os.path.join(cache_dir, names[minimal_cell_count]), (now - 20 + 10 * minimal_cell_count,) * 2)
+            # Fetching the first field makes the second one the least recently used
+            self.assertIsNone(load(0, max_size))
+            load(2, max_size)
+            self.assertEqual(sorted(name for name in os.listdir(cache_dir) if name.endswith(".fvx")), sorted((names[0], names[2])))
+
+    def test_submit_load(self):
+        """Test that a model loaded by a job on a native thread is labeled like a direct load"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ply_filename = os.path.join(tmpdir, "cube.ply")
+            self._write_cube_ply(ply_filename)
+            jobs = [fv.submit_load(ply_filename, self.voxel_size) for _ in range(2)]
+            voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+            self.assertTrue(voxelizator.load_ply_model(ply_filename))
+            size = voxelizator.get_domain_size()
+            expected = np.empty((size, size, size), dtype=np.short)
+            voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+            for job in jobs:
+                field = job.result()
+                self.assertTrue(job.done())
+                self.assertEqual(job.progress(), 1.)
+                self.assertIs(job.result(), field)
+                matrix = np.empty((size, size, size), dtype=np.short)
+                field.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+                self.assertTrue(np.array_equal(matrix, expected))
+            # Threads waiting for the same job get the same field
+            job = fv.submit_load(ply_filename, self.voxel_size)
+            results = []
+            threads = [threading.Thread(target=lambda: results.append(job.result())) for _ in range(4)]
+            for thread in threads:
+                thread.start()
+            for thread in threads:
+                thread.join()
+            self.assertEqual(len(results), 4)
+            self.assertTrue(all(result is results[0] for result in results))
+            job = fv.submit_load(os.path.join(tmpdir, "missing.ply"), self.voxel_size)
+            for _ in range(2):
+                with self.assertRaises(RuntimeError):
+                    job.result()
+
+    def test_mesh(self):
+        """Test that a mesh parsed once is voxelized at several resolutions like a direct load"""
+        vertices = np.array([[v.x, v.y, v.z] for v in self.sommets])
+        faces = np.array([facedata[:3] for facedata in self.faces])
+        markers = np.array([facedata[4] for facedata in self.faces])
+        mesh = create_mesh(vertices, faces, markers)
+        self.assertEqual(mesh.get_face_count(), 12)
+        self.assertEqual(mesh.get_box_max().x, 5.)
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ply_filename = os.path.join(tmpdir, "cube.ply")
+            self._write_cube_ply(ply_filename)
+            ply_mesh = fv.Mesh()
+            self.assertTrue(ply_mesh.load_ply(ply_filename))
+            self.assertFalse(fv.Mesh().load_ply(os.path.join(tmpdir, "missing.ply")))
+            for voxel_size in (self.voxel_size, self.voxel_size / 2):
+                loaded = fv.TriangleScalarFieldCreator(voxel_size)
+                self.assertTrue(loaded.load_ply_model(ply_filename))
+                size = loaded.get_domain_size()
+                expected = np.empty((size, size, size), dtype=np.short)
+                loaded.copy_matrix(expected, fv.ivec3(0, 0, 0))
+                for source in (mesh, ply_mesh):
+                    voxelizator = fv.TriangleScalarFieldCreator(voxel_size)
+                    voxelizator.voxelize_mesh(source)
+                    matrix = np.empty((size, size, size), dtype=np.short)
+                    voxelizator.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+                    self.assertTrue(np.array_equal(matrix, expected))
+        mesh.build_face_boxes()
+        mesh.build_morton_order()
+        arrays = get_mesh_arrays(mesh)
+        self.assertTrue(np.array_equal(arrays["faces"], faces))
+        self.assertTrue(np.array_equal(arrays["markers"], markers))
+        self.assertTrue(np.array_equal(arrays["face_boxes"][:, :3], vertices[faces].min(axis=1)))
+        self.assertTrue(np.array_equal(np.sort(arrays["morton_order"]), np.arange(12)))
+        with self.assertRaises(IndexError):
+            create_mesh(vertices, [[0, 1, 8]])
+
+    def test_query_points(self):
+        """Test that the batch query gives the cells and values of the point by point calls"""
+        voxelizator = self._create_voxelizator()
+        rng = np.random.default_rng(7)
+        points = rng.uniform(-1., 6., (500, 3))
+        cells, labels = query_points(voxelizator, points)
+        size = voxelizator.get_domain_size()
+        for point, cell, label in zip(points, cells, labels):
+            expected_cell = voxelizator.get_cell_id_by_coord(fv.dvec3(*point))
+            self.assertEqual(list(cell), [expected_cell.a, expected_cell.b, expected_cell.c])
+            if all(0 <= value < size for value in cell):
+                self.assertEqual(label, voxelizator.get_matrix_value(expected_cell))
+            else:
+                self.assertEqual(label, -1)
+        with self.assertRaises(ValueError):
+            voxelizator.query_points(points, cells[:10], labels)
+
+    def test_stl_obj(self):
+        """Test that the STL and OBJ files give the triangles of the PLY file, the OBJ materials as markers"""
+        vertices = np.array([[v.x, v.y, v.z] for v in self.sommets])
+        faces = np.array([facedata[:3] for facedata in self.faces])
+        markers = [facedata[4] for facedata in self.faces]
+        with tempfile.TemporaryDirectory() as tmpdir:
+            stl_filename = os.path.join(tmpdir, "cube.stl")
+            records = np.zeros(len(faces), dtype=[("normal", "<f4", 3), ("vertices", "<f4", 9), ("attribute", "<u2")])
+            records["vertices"] = vertices[faces].reshape(-1, 9)
+            with open(stl_filename, "wb") as f:
+                f.write(b"solid cube".ljust(80, b" ") + np.array([len(faces)], dtype="<u4").tobytes() + records.tobytes())
+            stl_mesh = fv.Mesh()
+            stl_mesh.set_thread_count(1)
+            self.assertTrue(stl_mesh.load(stl_filename))
+            stl_arrays = get_mesh_arrays(stl_mesh)
+            self.assertTrue(np.array_equal(stl_arrays["vertices"][stl_arrays["faces"]], vertices[faces]))
+            self.assertTrue(np.all(stl_arrays["markers"] == 1))
+            obj_filename = os.path.join(tmpdir, "cube.obj")
+            with open(obj_filename, "w") as f:
+                f.write("# cube\nmtllib cube.mtl\n")
+                for vertex in vertices:
+                    f.write("v %g %g %g\n" % tuple(vertex))
+                for face, marker in zip(faces, markers):
+                    f.write("usemtl layer%d\nf %d/1 %d//1 %d\n" % (marker, face[0] + 1, face[1] + 1, face[2] - len(vertices)))
+            obj_mesh = fv.Mesh()
+            self.assertTrue(obj_mesh.load(obj_filename))
+            obj_arrays = get_mesh_arrays(obj_mesh)
+            self.assertTrue(np.array_equal(obj_arrays["vertices"], vertices))
+            self.assertTrue(np.array_equal(obj_arrays["faces"], faces))
+            names = list(obj_mesh.get_marker_names())
+            self.assertEqual([names[marker] for marker in obj_arrays["markers"]], ["layer%d" % marker for marker in markers])
+            with open(obj_filename, "a") as f:
+                f.write("f 1 2 %d\n" % (len(vertices) + 1))
+            self.assertFalse(fv.Mesh().load(obj_filename))
+            # The index would wrap to the first vertex in an unsigned int
+            with open(obj_filename, "w") as f:
+                f.write("v 0 0 0\nv 1 0 0\nv 0 1 0\nf 1 2 %d\n" % (2 ** 32 + 1))
+            self.assertFalse(fv.Mesh().load(obj_filename))
+
+    def test_streamed_load(self):
+        """Test that the triangles fed while the file is read give the field of the whole mesh, whatever the thread count"""
+        with tempfile.TemporaryDirectory() as tmpdir:
+            ply_filename = os.path.join(tmpdir, "cube.ply")
+            self._write_binary_cube_ply(ply_filename)
+            mesh = fv.Mesh()
+            self.assertTrue(mesh.load_ply(ply_filename))
+            voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+            voxelizator.voxelize_mesh(mesh)
+            size = voxelizator.get_domain_size()
+            expected = np.empty((size, size, size), dtype=np.short)
+            voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+            for thread_count in (1, 3):
+                for bounds in (None, (mesh.get_box_min(), mesh.get_box_max())):
+                    voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+                    voxelizator.set_thread_count(thread_count)
+                    if bounds is not None:
+                        voxelizator.set_model_bounds(*bounds)
+                    self.assertTrue(voxelizator.load_ply_model(ply_filename))
+                    self.assertEqual(voxelizator.get_domain_size(), size)
+                    matrix = np.empty((size, size, size), dtype=np.short)
+                    voxelizator.copy_matrix(matrix, fv.ivec3(0, 0, 0))
+                    self.assertTrue(np.array_equal(matrix, expected))
+            # The cached fields are fitted to the model bounds, and a field of other bounds is not returned
+            box_min, box_max = mesh.get_box_min(), mesh.get_box_max()
+            large_bounds = (fv.dvec3(box_min.x - 2, box_min.y - 2, box_min.z - 2), fv.dvec3(box_max.x + 2, box_max.y + 2, box_max.z + 2))
+            voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+            voxelizator.set_model_bounds(*large_bounds)
+            self.assertTrue(voxelizator.load_ply_model(ply_filename))
+            large_size = voxelizator.get_domain_size()
+            self.assertGreater(large_size, size)
+            cache_directory = os.path.join(tmpdir, "cache")
+            for bounds, bounds_size in (None, size), (large_bounds, large_size), (None, size), (large_bounds, large_size):
+                voxelizator = fv.TriangleScalarFieldCreator(self.voxel_size)
+                voxelizator.set_cache(cache_directory)
+                if bounds is not None:
+                    voxelizator.set_model_bounds(*bounds)
+                self.assertTrue(voxelizator.load_ply_model(ply_filename))
+                self.assertEqual(voxelizator.get_domain_size(), bounds_size)
+            self.assertEqual(len([name for name in os.listdir(cache_directory) if name.endswith(".fvx")]), 2)
+            # A face refers to a missing vertex
+            with open(ply_filename, "rb") as f:
+                content = f.read()
+            header_end = content.index(b"end_header\n") + len(b"end_header\n")
+            vertex_count = len(self.sommets)
+            with open(ply_filename, "wb") as f:
+                f.write(content[:header_end + vertex_count * 25 + 1] + np.array([vertex_count], dtype="<i4").tobytes()
+                        + content[header_end + vertex_count * 25 + 5:])
+            self.assertFalse(fv.TriangleScalarFieldCreator(self.voxel_size).load_ply_model(ply_filename))
+
+    def test_export_npy(self):
+        """Test that the .npy export reads back the same cells as copy_matrix, with and without filter"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, "cube.npy")
+            export_npy(voxelizator, filename)
+            values = np.load(filename, mmap_mode='r')
+            self.assertTrue(np.array_equal(values, expected))
+            del values
+            # Block partially out of the domain, the outer cells are -1
+            export_npy(voxelizator, filename, origin=(2, 3, 4), shape=(size, 5, 6), filt_array=[0, 1, 2])
+            values = np.load(filename)
+            self.assertEqual(values.shape, (size, 5, 6))
+            self.assertTrue(np.all(values[size - 2:] == -1))
+            block = np.full((size - 2, 5, 6), -1, dtype=np.short)
+            voxelizator.copy_matrix_filtered(block, fv.ivec3(2, 3, 4), np.asarray([0, 1, 2], dtype=np.short))
+            self.assertTrue(np.array_equal(values[:size - 2], block))
+
+    def test_export_chunks(self):
+        """Test that np_voxel reads the same slices from a chunk directory as from the field"""
+        voxelizator = self._create_voxelizator()
+        with tempfile.TemporaryDirectory() as tmpdir:
+            voxelizator.export_chunks(tmpdir, 4)
+            store = chunk_store(tmpdir)
+            self.assertEqual(store.shape, (14, 14, 14))
+            from_field = np_voxel(voxelizator)
+            from_store = np_voxel(store)
+            self.assertTrue(np.array_equal(from_store[:, :, :], from_field[:, :, :]))
+            self.assertTrue(np.array_equal(from_store[3:9, 5, 2:13], from_field[3:9, 5, 2:13]))
+            # The filter covers all the cell values, np_voxel does not initialize the cells out of the filter
+            filt_array = np.arange(103, dtype=np.short) % 7
+            from_field.set_filter(filt_array)
+            from_store.set_filter(filt_array)
+            self.assertTrue(np.array_equal(from_store[1:6, 1:6, 1:6], from_field[1:6, 1:6, 1:6]))
+            # A second export to the same directory removes the chunks of the first one
+            voxelizator.export_chunks(tmpdir, 8)
+            self.assertFalse(os.path.exists(os.path.join(tmpdir, "3_3_3.bin")))
+            self.assertTrue(np.array_equal(np_voxel(chunk_store(tmpdir))[:, :, :], np_voxel(voxelizator)[:, :, :]))
+
+    def test_get_runs(self):
+        """Test that the runs decode to the dense matrix"""
+        voxelizator = self._create_voxelizator()
+        size = voxelizator.get_domain_size()
+        expected = np.empty((size, size, size), dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(0, 0, 0))
+        runs = get_runs(voxelizator)
+        self.assertEqual(len(runs["column_offset"]), size * size + 1)
+        self.assertEqual(runs["column_offset"][-1], len(runs["label"]))
+        # Each column is covered by its runs
+        columns = np.repeat(np.arange(size * size), np.diff(runs["column_offset"]).astype(np.intp))
+        self.assertTrue(np.array_equal(np.bincount(columns, weights=runs["length"], minlength=size * size), np.full(size * size, size)))
+        decoded = np.repeat(runs["label"], runs["length"].astype(np.intp)).reshape((size, size, size))
+        self.assertTrue(np.array_equal(decoded, expected))
+        self.assertFalse(runs["label"].flags.writeable)
+        # The views keep the runs alive when the field drops them
+        del voxelizator
+        decoded = np.repeat(runs["label"], runs["length"].astype(np.intp)).reshape((size, size, size))
+        self.assertTrue(np.array_equal(decoded, expected))
+
+    def test_export_vti(self):
+        """Test the binary XML ImageData export against the extracted block"""
+        voxelizator = self._create_voxelizator()
+        origin, block = extract_volume(voxelizator, 102, padding=1)
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, "cube.vti")
+            voxelizator.export_vtk(filename, 102, fv.ScalarFieldCreator.EXPORT_VTI)
+            with open(filename, "rb") as f:
+                content = f.read()
+        self.assertIn(b'WholeExtent="0 10 0 10 0 10"', content)
+        data_start = content.index(b"\n   _") + 5
+        byte_count = int(np.frombuffer(content[data_start:data_start + 8], dtype=np.uint64)[0])
+        self.assertEqual(byte_count, 2 * 11 ** 3)
+        values = np.frombuffer(content[data_start + 8:data_start + 8 + byte_count], dtype=np.short)
+        # X varies fastest in the VTK files
+        self.assertTrue(np.array_equal(values.reshape((11, 11, 11)).transpose(), block))
+
+    def test_export_vtk_binary(self):
+        """Test the big endian legacy VTK export against the copied matrix"""
+        voxelizator = self._create_voxelizator()
+        origin, block = extract_volume(voxelizator, 102, padding=1)
+        expected = np.empty(block.shape, dtype=np.short)
+        voxelizator.copy_matrix(expected, fv.ivec3(*origin))
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, "cube.vtk")
+            voxelizator.export_vtk(filename, 102, fv.ScalarFieldCreator.EXPORT_VTK_BINARY)
+            with open(filename, "rb") as f:
+                content = f.read()
+        self.assertIn(b"BINARY\nDATASET STRUCTURED_POINTS\nDIMENSIONS 11 11 11\n", content)
+        data_start = content.index(b"LOOKUP_TABLE default\n") + len(b"LOOKUP_TABLE default\n")
+        values = np.frombuffer(content, dtype=">i2", count=11 ** 3, offset=data_start)
+        self.assertEqual(content[data_start + 2 * 11 ** 3:], b"\n")
+        # X varies fastest in the VTK files
+        self.assertTrue(np.array_equal(values.reshape((11, 11, 11)).transpose(), expected))
+
+    def test_export_vti_zlib(self):
+        """Test the compressed XML ImageData export against the extracted block"""
+        voxelizator = self._create_voxelizator()
+        origin, block = extract_volume(voxelizator, 102, padding=1)
+        with tempfile.TemporaryDirectory() as tmpdir:
+            filename = os.path.join(tmpdir, "cube.vti")
+            try:
+                voxelizator.export_vtk(filename, 102, fv.ScalarFieldCreator.EXPORT_VTI_ZLIB)
+            except ValueError:
+                self.skipTest("fastvoxel built without zlib")
+            with open(filename, "rb") as f:
+                content = f.read()
+        self.assertIn(b'compressor="vtkZLibDataCompressor"', content)
+        data_start = content.index(b"\n   _") + 5
+        block_count = int(np.frombuffer(content[data_start:data_start + 8], dtype=np.uint64)[0])
+        header = np.frombuffer(content[data_start:data_start + 8 * (3 + block_count)], dtype=np.uint64)
+        data = b""
+        position = data_start + 8 * (3 + block_count)
+        for compressed_size in header[3:]:
+            data += zlib.decompress(content[position:position + int(compressed_size)])
+            position += int(compressed_size)
+        values = np.frombuffer(data, dtype=np.short)
+        self.assertTrue(np.array_equal(values.reshape((11, 11, 11)).transpose(), block))
+
+
+    def test_export_volumes_vtk(self):
+        """Test that each exported volume gets its own file, equal to the single volume export"""
+        voxelizator = self._create_voxelizator()
+        with tempfile.TemporaryDirectory() as tmpdir:
+            voxelizator.export_volumes_vtk(os.path.join(tmpdir, "room.vti"), [101, 102, 102],
+                                           fv.ScalarFieldCreator.EXPORT_VTI)
+            voxelizator.export_vtk(os.path.join(tmpdir, "single.vti"), 102, fv.ScalarFieldCreator.EXPORT_VTI)
+            self.assertTrue(os.path.exists(os.path.join(tmpdir, "room_101.vti")))
+            with open(os.path.join(tmpdir, "room_102.vti"), "rb") as f:
+                content = f.read()
+            with open(os.path.join(tmpdir, "single.vti"), "rb") as f:
+                self.assertEqual(content, f.read())
+            self.assertRaises(ValueError, voxelizator.export_volumes_vtk, os.path.join(tmpdir, "room.vti"), [-1])
 
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,289 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "block_cache.hpp"
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#ifndef MIN
+	#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+	#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
+
+namespace ScalarFieldBuilders
+{
+	BlockCache::BlockCache(ScalarFieldCreator& _field,const unsigned long long& maxSize,const int& _brickSize)
+		:field(_field),brickSize(_brickSize),readAhead(1),hitCount(0),missCount(0),hasLastWindow(false),stopReadAhead(false)
+	{
+		if(brickSize<=0)
+			throw std::invalid_argument("The brick size must be positive");
+		const unsigned long long brickBytes((unsigned long long)brickSize*brickSize*brickSize*sizeof(SpatialDiscretization::weight_t));
+		maxBrickCount=MAX(maxSize/brickBytes,1ULL);
+	}
+	BlockCache::~BlockCache()
+	{
+		StopReadAhead();
+	}
+	std::size_t BlockCache::GetDomainSize()
+	{
+		return field.GetDomainSize();
+	}
+	void BlockCache::SetReadAhead(const int& _readAhead)
+	{
+		readAhead=_readAhead;
+	}
+	void BlockCache::Clear()
+	{
+		StopReadAhead();
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		bricks.clear();
+		useOrder.clear();
+		hasLastWindow=false;
+	}
+	std::size_t BlockCache::GetBrickCount()
+	{
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		return bricks.size();
+	}
+	unsigned long long BlockCache::GetHitCount()
+	{
+		return hitCount;
+	}
+	unsigned long long BlockCache::GetMissCount()
+	{
+		return missCount;
+	}
+	PTR<SpatialDiscretization::RunMatrix> BlockCache::Synchronize()
+	{
+		std::lock_guard<std::mutex> lock(synchronizeMutex);
+		PTR<SpatialDiscretization::RunMatrix> currentRuns(field.GetSharedRunMatrix());
+		if(currentRuns.get()!=runs.get())
+		{
+			//Bricks of the previous runs are dropped, the read-ahead thread is stopped first
+			Clear();
+			std::lock_guard<std::mutex> cacheLock(cacheMutex);
+			runs=currentRuns;
+		}
+		return runs;
+	}
+	BlockCache::brick_ptr BlockCache::DecodeBrick(const SpatialDiscretization::RunMatrix& brickRuns,const unsigned long long& key) const
+	{
+		using namespace SpatialDiscretization;
+		const int cellCount((int)brickRuns.size);
+		const int brickCount((cellCount+brickSize-1)/brickSize);
+		const ivec3 brick(key/((unsigned long long)brickCount*brickCount),(key/brickCount)%brickCount,key%brickCount);
+		const ivec3 brickOrigin(brick.x*brickSize,brick.y*brickSize,brick.z*brickSize);
+		const ivec3 brickShape(MIN(brickSize,cellCount-brickOrigin.x),MIN(brickSize,cellCount-brickOrigin.y),MIN(brickSize,cellCount-brickOrigin.z));
+		std::shared_ptr<brick_t> cells(new brick_t((std::size_t)brickSize*brickSize*brickSize,emptyValue));
+		for(int i=0;i<brickShape.x;i++)
+		{
+			for(int j=0;j<brickShape.y;j++)
+				brickRuns.DecodeColumn(brickRuns.ColumnIndex(brickOrigin.x+i,brickOrigin.y+j),brickOrigin.z,brickOrigin.z+brickShape.z,&(*cells)[((std::size_t)i*brickSize+j)*brickSize]);
+		}
+		return cells;
+	}
+	void BlockCache::InsertBrick(const unsigned long long& key,const brick_ptr& cells)
+	{
+		if(bricks.find(key)!=bricks.end())
+			return;
+		useOrder.push_front(key);
+		brickEntry_t& entry(bricks[key]);
+		entry.cells=cells;
+		entry.lastUse=useOrder.begin();
+		while(bricks.size()>maxBrickCount)
+		{
+			bricks.erase(useOrder.back());
+			useOrder.pop_back();
+		}
+	}
+	BlockCache::brick_ptr BlockCache::GetBrick(const SpatialDiscretization::RunMatrix& brickRuns,const unsigned long long& key,std::unique_lock<std::mutex>& lock)
+	{
+		std::unordered_map<unsigned long long,brickEntry_t>::iterator itbrick(bricks.find(key));
+		if(itbrick!=bricks.end())
+		{
+			hitCount++;
+			useOrder.splice(useOrder.begin(),useOrder,itbrick->second.lastUse);
+			return itbrick->second.cells;
+		}
+		missCount++;
+		std::deque<unsigned long long>::iterator itqueue(std::find(readAheadQueue.begin(),readAheadQueue.end(),key));
+		if(itqueue!=readAheadQueue.end())
+			readAheadQueue.erase(itqueue);
+		lock.unlock();
+		brick_ptr cells(DecodeBrick(brickRuns,key));
+		lock.lock();
+		//The brick is not kept if the runs changed while it was decoded
+		if(&brickRuns==runs.get())
+			InsertBrick(key,cells);
+		return cells;
+	}
+	void BlockCache::CopyMatrix(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos)
+	{
+		CopyMatrixFiltered(data,ni,nj,nk,extractPos,NULL,0);
+	}
+	void BlockCache::CopyMatrixFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos,const SpatialDiscretization::weight_t* data_filter,int nindex)
+	{
+		using namespace SpatialDiscretization;
+		const PTR<RunMatrix> windowRuns(Synchronize());
+		const int cellCount((int)windowRuns->size);
+		const int brickCount((cellCount+brickSize-1)/brickSize);
+		const ivec3 extractPosEnd(MIN(ni+extractPos.x,cellCount),MIN(nj+extractPos.y,cellCount),MIN(nk+extractPos.z,cellCount));
+		if(extractPos.x>=extractPosEnd.x || extractPos.y>=extractPosEnd.y || extractPos.z>=extractPosEnd.z)
+			return;
+		const ivec3 brickMin(extractPos.x/brickSize,extractPos.y/brickSize,extractPos.z/brickSize);
+		const ivec3 brickMax((extractPosEnd.x-1)/brickSize,(extractPosEnd.y-1)/brickSize,(extractPosEnd.z-1)/brickSize);
+		std::unique_lock<std::mutex> lock(cacheMutex);
+		ScheduleReadAhead(windowRuns,brickMin,brickMax,extractPos,ivec3(ni,nj,nk));
+		for(int brickX=brickMin.x;brickX<=brickMax.x;brickX++)
+		{
+			for(int brickY=brickMin.y;brickY<=brickMax.y;brickY++)
+			{
+				for(int brickZ=brickMin.z;brickZ<=brickMax.z;brickZ++)
+				{
+					const unsigned long long key(((unsigned long long)brickX*brickCount+brickY)*brickCount+brickZ);
+					brick_ptr cells(GetBrick(*windowRuns,key,lock));
+					lock.unlock();
+					//Part of the window in the brick
+					const ivec3 brickOrigin(brickX*brickSize,brickY*brickSize,brickZ*brickSize);
+					const int zBegin(MAX(extractPos.z,brickOrigin.z)),zEnd(MIN(extractPosEnd.z,brickOrigin.z+brickSize));
+					for(int cell_x=MAX(extractPos.x,brickOrigin.x);cell_x<MIN(extractPosEnd.x,brickOrigin.x+brickSize);cell_x++)
+					{
+						for(int cell_y=MAX(extractPos.y,brickOrigin.y);cell_y<MIN(extractPosEnd.y,brickOrigin.y+brickSize);cell_y++)
+						{
+							const weight_t* source(&(*cells)[((std::size_t)(cell_x-brickOrigin.x)*brickSize+(cell_y-brickOrigin.y))*brickSize+(zBegin-brickOrigin.z)]);
+							weight_t* destination(data+((std::size_t)(cell_x-extractPos.x)*nj+(cell_y-extractPos.y))*nk+(zBegin-extractPos.z));
+							if(!data_filter)
+								memcpy(destination,source,(zEnd-zBegin)*sizeof(weight_t));
+							else
+							{
+								for(int k=0;k<zEnd-zBegin;k++)
+								{
+									if(source[k]>=0 && source[k]<nindex)
+										destination[k]=data_filter[source[k]];
+								}
+							}
+						}
+					}
+					lock.lock();
+				}
+			}
+		}
+	}
+	void BlockCache::ScheduleReadAhead(const PTR<SpatialDiscretization::RunMatrix>& windowRuns,const ivec3& brickMin,const ivec3& brickMax,const ivec3& extractPos,const ivec3& extractShape)
+	{
+		const int brickCount(((int)windowRuns->size+brickSize-1)/brickSize);
+		int movedAxis(-1),moveCount(0);
+		if(hasLastWindow && lastShape==extractShape)
+		{
+			for(int axis=0;axis<3;axis++)
+			{
+				if(extractPos.i[axis]!=lastPos.i[axis])
+				{
+					movedAxis=axis;
+					moveCount++;
+				}
+			}
+		}
+		const int direction(movedAxis>=0 && extractPos.i[movedAxis]>lastPos.i[movedAxis] ? 1 : -1);
+		lastPos=extractPos;
+		lastShape=extractShape;
+		hasLastWindow=true;
+		if(readAhead<=0 || moveCount!=1)
+			return;
+		//Next layers of bricks along the sweep, the bricks of the other axes are the ones of the window.
+		//Only the layers that fit in the cap with the bricks of the window are read, they would evict the window otherwise.
+		unsigned long long windowBrickCount(1),layerBrickCount(1);
+		for(int axis=0;axis<3;axis++)
+		{
+			windowBrickCount*=brickMax.i[axis]-brickMin.i[axis]+1;
+			if(axis!=movedAxis)
+				layerBrickCount*=brickMax.i[axis]-brickMin.i[axis]+1;
+		}
+		ivec3 layerMin(brickMin),layerMax(brickMax);
+		bool queued(false);
+		for(int layer=1;layer<=readAhead && windowBrickCount+layer*layerBrickCount<=maxBrickCount;layer++)
+		{
+			const int layerIndex(direction>0 ? brickMax.i[movedAxis]+layer : brickMin.i[movedAxis]-layer);
+			if(layerIndex<0 || layerIndex>=brickCount)
+				break;
+			layerMin.i[movedAxis]=layerIndex;
+			layerMax.i[movedAxis]=layerIndex;
+			for(int brickX=layerMin.x;brickX<=layerMax.x;brickX++)
+			{
+				for(int brickY=layerMin.y;brickY<=layerMax.y;brickY++)
+				{
+					for(int brickZ=layerMin.z;brickZ<=layerMax.z;brickZ++)
+					{
+						const unsigned long long key(((unsigned long long)brickX*brickCount+brickY)*brickCount+brickZ);
+						if(bricks.find(key)==bricks.end() && std::find(readAheadQueue.begin(),readAheadQueue.end(),key)==readAheadQueue.end())
+						{
+							readAheadQueue.push_back(key);
+							queued=true;
+						}
+					}
+				}
+			}
+		}
+		if(queued)
+		{
+			readAheadRuns=windowRuns;
+			if(!readAheadThread.joinable())
+				readAheadThread=std::thread(&BlockCache::ReadAheadLoop,this);
+			queueChanged.notify_one();
+		}
+	}
+	void BlockCache::ReadAheadLoop()
+	{
+		std::unique_lock<std::mutex> lock(cacheMutex);
+		while(true)
+		{
+			queueChanged.wait(lock,[this]() { return stopReadAhead || !readAheadQueue.empty(); });
+			if(stopReadAhead)
+				return;
+			const unsigned long long key(readAheadQueue.front());
+			readAheadQueue.pop_front();
+			if(bricks.find(key)!=bricks.end())
+				continue;
+			const PTR<SpatialDiscretization::RunMatrix> brickRuns(readAheadRuns);
+			lock.unlock();
+			brick_ptr cells(DecodeBrick(*brickRuns,key));
+			lock.lock();
+			if(!stopReadAhead && brickRuns.get()==runs.get())
+				InsertBrick(key,cells);
+		}
+	}
+	void BlockCache::StopReadAhead()
+	{
+		{
+			std::lock_guard<std::mutex> lock(cacheMutex);
+			stopReadAhead=true;
+			readAheadQueue.clear();
+			readAheadRuns=PTR<SpatialDiscretization::RunMatrix>();
+		}
+		queueChanged.notify_all();
+		if(readAheadThread.joinable())
+			readAheadThread.join();
+		std::lock_guard<std::mutex> lock(cacheMutex);
+		stopReadAhead=false;
+	}
+}
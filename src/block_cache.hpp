@@ -0,0 +1,129 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#include "scalar_field_creator.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef __BLOCK_CACHE__
+#define __BLOCK_CACHE__
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * Cubic bricks of decoded cells of a field, kept in memory up to a size cap (least recently used bricks are dropped).
+	 * When consecutive copies move along one axis, the next bricks in this direction are decoded by a background thread.
+	 * The bricks are decoded again if the field runs change (new triangles, labeling, Load).
+	 * The field must outlive the cache, the Python proxy keeps a reference on it.
+	 */
+	class BlockCache
+	{
+	public:
+		/**
+		 * @param maxSize Memory cap of the bricks in bytes
+		 * @param brickSize Cell count of the bricks on each axis
+		 */
+		BlockCache(ScalarFieldCreator& field,const unsigned long long& maxSize=256*1024*1024,const int& brickSize=32);
+		~BlockCache();
+		/**
+		 * Same behaviour as ScalarFieldCreator::CopyMatrix, the cells are read from the bricks
+		 */
+		void CopyMatrix(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos);
+		void CopyMatrixFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos,const SpatialDiscretization::weight_t* data_filter,int nindex);
+		std::size_t GetDomainSize();
+		/**
+		 * Number of brick layers decoded ahead of a sweep, 0 to disable the read-ahead. Default 1.
+		 */
+		void SetReadAhead(const int& _readAhead);
+		/**
+		 * Drop all the bricks
+		 */
+		void Clear();
+		std::size_t GetBrickCount();
+		/**
+		 * Bricks found in memory by the copies, read-ahead bricks included
+		 */
+		unsigned long long GetHitCount();
+		/**
+		 * Bricks decoded by the copies themselves
+		 */
+		unsigned long long GetMissCount();
+	private:
+		typedef std::vector<SpatialDiscretization::weight_t> brick_t;
+		typedef std::shared_ptr<const brick_t> brick_ptr;
+		struct brickEntry_t
+		{
+			brick_ptr cells;
+			std::list<unsigned long long>::iterator lastUse;
+		};
+		BlockCache(const BlockCache&);
+		BlockCache& operator=(const BlockCache&);
+		/**
+		 * Take the current runs of the field, drop the bricks if they changed
+		 * @return The runs to decode for this copy, they stay alive even if the field replaces them meanwhile
+		 */
+		PTR<SpatialDiscretization::RunMatrix> Synchronize();
+		brick_ptr DecodeBrick(const SpatialDiscretization::RunMatrix& brickRuns,const unsigned long long& key) const;
+		/**
+		 * Brick of the key, decoded if it is not in memory. Called with the lock.
+		 */
+		brick_ptr GetBrick(const SpatialDiscretization::RunMatrix& brickRuns,const unsigned long long& key,std::unique_lock<std::mutex>& lock);
+		void InsertBrick(const unsigned long long& key,const brick_ptr& cells);
+		/**
+		 * Queue the bricks after the window if the window moved along a single axis since the previous copy
+		 */
+		void ScheduleReadAhead(const PTR<SpatialDiscretization::RunMatrix>& windowRuns,const ivec3& brickMin,const ivec3& brickMax,const ivec3& extractPos,const ivec3& extractShape);
+		void ReadAheadLoop();
+		/**
+		 * Stop the read-ahead thread after its current brick, the queue is cleared
+		 */
+		void StopReadAhead();
+
+		ScalarFieldCreator& field;
+		PTR<SpatialDiscretization::RunMatrix> runs;          //Runs of the bricks, replaced with the locks synchronizeMutex and cacheMutex
+		PTR<SpatialDiscretization::RunMatrix> readAheadRuns; //Runs of the queued bricks, with the lock cacheMutex
+		unsigned long long maxBrickCount;
+		int brickSize;
+		int readAhead;
+		std::unordered_map<unsigned long long,brickEntry_t> bricks;
+		std::list<unsigned long long> useOrder; //Most recently used first
+		std::atomic<unsigned long long> hitCount;
+		std::atomic<unsigned long long> missCount;
+		ivec3 lastPos;
+		ivec3 lastShape;
+		bool hasLastWindow;
+		std::mutex synchronizeMutex; //Copies of concurrent threads check the runs one at a time
+		std::mutex cacheMutex;
+		std::condition_variable queueChanged;
+		std::deque<unsigned long long> readAheadQueue;
+		bool stopReadAhead;
+		std::thread readAheadThread;
+	};
+}
+
+#endif
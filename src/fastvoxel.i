@@ -25,16 +25,101 @@
 %{
 #define SWIG_FILE_WITH_INIT
 #include "triangle_feeder.hpp"
+#include "block_cache.hpp"
+#include "load_job.hpp"
 %}
 %include "std_string.i"
+%include "std_vector.i"
 %include "typemaps.i"
 %include "numpy.i"
+%numpy_typemaps(unsigned char, NPY_UBYTE, long long)
+%include "exception.i"
 %init %{
     import_array();
 %}
 
+%pythoncode %{
+import numpy
+import threading
 
+def _load_serialized_field(cls, state):
+    # Unpickle a ScalarFieldCreator, the resolution is part of the state
+    field = cls(1.)
+    field.deserialize(numpy.frombuffer(bytearray(state), dtype=numpy.uint8))
+    return field
+%}
+
+%exception {
+    try {
+        $action
+    } catch (const std::out_of_range& e) {
+        SWIG_exception(SWIG_IndexError, e.what());
+    } catch (const std::invalid_argument& e) {
+        SWIG_exception(SWIG_ValueError, e.what());
+    } catch (const std::exception& e) {
+        SWIG_exception(SWIG_RuntimeError, e.what());
+    } catch (...) {
+        SWIG_exception(SWIG_RuntimeError, "Unknown C++ exception");
+    }
+}
+
+
+/* The long methods release the GIL, other Python threads run meanwhile. The fields do not share any static state,
+ * so distinct fields can be used concurrently. A field must not be modified by another thread during a call that uses it. */
+%define %release_gil(method)
+%exception method {
+    PyThreadState* threadState = PyEval_SaveThread();
+    try {
+        $action
+    } catch (const std::out_of_range& e) {
+        PyEval_RestoreThread(threadState);
+        SWIG_exception(SWIG_IndexError, e.what());
+    } catch (const std::invalid_argument& e) {
+        PyEval_RestoreThread(threadState);
+        SWIG_exception(SWIG_ValueError, e.what());
+    } catch (const std::exception& e) {
+        PyEval_RestoreThread(threadState);
+        SWIG_exception(SWIG_RuntimeError, e.what());
+    } catch (...) {
+        PyEval_RestoreThread(threadState);
+        SWIG_exception(SWIG_RuntimeError, "Unknown C++ exception");
+    }
+    PyEval_RestoreThread(threadState);
+}
+%enddef
 
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrix)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::QueryPoints)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrixFiltered)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrixStrided)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrixStridedFiltered)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrixIndexed)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::CopyMatrixIndexedFiltered)
+%release_gil(ScalarFieldBuilders::BlockCache::CopyMatrix)
+%release_gil(ScalarFieldBuilders::BlockCache::CopyMatrixFiltered)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ThirdStep_VolumesCreator)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::LabelVolumesFromSeeds)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::BuildLabelRunIndex)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ExportVTK)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ExportVolumesVTK)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ExportNpy)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ExportNpyFiltered)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::ExportChunks)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::Save)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::Load)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::Serialize)
+%release_gil(ScalarFieldBuilders::ScalarFieldCreator::Deserialize)
+%release_gil(ScalarFieldBuilders::TriangleScalarFieldCreator::LoadPlyModel)
+%release_gil(ScalarFieldBuilders::TriangleScalarFieldCreator::VoxelizeMesh)
+%release_gil(ScalarFieldBuilders::Mesh::LoadPly)
+%release_gil(ScalarFieldBuilders::Mesh::LoadStl)
+%release_gil(ScalarFieldBuilders::Mesh::LoadObj)
+%release_gil(ScalarFieldBuilders::Mesh::Load)
+%release_gil(ScalarFieldBuilders::Mesh::BuildMortonOrder)
+%release_gil(ScalarFieldBuilders::TriangleScalarFieldCreator::ThirdStep_ParityVolumesCreator)
+%release_gil(ScalarFieldBuilders::LoadJob::TakeResult)
+%release_gil(ScalarFieldBuilders::LoadJob::~LoadJob)
+%newobject ScalarFieldBuilders::LoadJob::TakeResult;
 
 namespace core_mathlib
 {
@@ -143,6 +228,12 @@ namespace core_mathlib
         }
    };
 };
+namespace std
+{
+    %template(dvec3_vector) vector<core_mathlib::dvec3>;
+    %template(short_vector) vector<short>;
+    %template(string_vector) vector<std::string>;
+};
 namespace ScalarFieldBuilders
 {
     using namespace core_mathlib;
@@ -150,31 +241,176 @@ namespace ScalarFieldBuilders
     class ScalarFieldCreator
 	{
         public:
+            enum EXPORT_FORMAT
+            {
+                EXPORT_VTK_ASCII,
+                EXPORT_VTK_BINARY,
+                EXPORT_VTI,
+                EXPORT_VTI_ZLIB
+            };
             ScalarFieldCreator(const double& resolution);
             %rename(first_step_params) FirstStep_Params;
             void FirstStep_Params(const dvec3& boxMin,const dvec3& boxMax);
             %rename(third_step_volumescreator) ThirdStep_VolumesCreator;
             void ThirdStep_VolumesCreator();
+            %rename(set_transparent_markers) SetTransparentMarkers;
+            void SetTransparentMarkers(const std::vector<short>& markers);
+            %rename(get_transparent_markers) GetTransparentMarkers;
+            std::vector<short> GetTransparentMarkers();
+            %rename(restore_surfaces) RestoreSurfaces;
+            void RestoreSurfaces();
+            %rename(label_volumes_from_seeds) LabelVolumesFromSeeds;
+            std::vector<short> LabelVolumesFromSeeds(const std::vector<dvec3>& seeds);
+            %rename(is_seed_enclosed) IsSeedEnclosed;
+            bool IsSeedEnclosed(const dvec3& seed);
+            %rename(set_thread_count) SetThreadCount;
+            void SetThreadCount(const unsigned int& threadCount);
+            %rename(get_thread_count) GetThreadCount;
+            unsigned int GetThreadCount();
+            %rename(set_minimal_volume) SetMinimalVolume;
+            void SetMinimalVolume(const double& minimalVolume);
+            %rename(get_minimal_volume) GetMinimalVolume;
+            double GetMinimalVolume();
+            %rename(set_minimal_cell_count) SetMinimalCellCount;
+            void SetMinimalCellCount(const size_t& minimalCellCount);
+            %rename(get_minimal_cell_count) GetMinimalCellCount;
+            size_t GetMinimalCellCount();
+            %rename(set_small_volume_value) SetSmallVolumeValue;
+            void SetSmallVolumeValue(const short& smallVolumeValue);
+            %rename(get_small_volume_value) GetSmallVolumeValue;
+            short GetSmallVolumeValue();
+            %rename(get_merged_volume_count) GetMergedVolumeCount;
+            size_t GetMergedVolumeCount();
+            %rename(get_parity_fallback_column_count) GetParityFallbackColumnCount;
+            size_t GetParityFallbackColumnCount();
             %rename(get_volume_value) GetVolumeValue;
             double GetVolumeValue(short volId);
             %rename(get_volume_count) GetVolumeCount;
             short GetVolumeCount();
+            %rename(get_label_count) GetLabelCount;
+            short GetLabelCount();
+            %rename(copy_label_statistics) CopyLabelStatistics;
+            void CopyLabelStatistics(long long* INPLACE_ARRAY1,int DIM1,double* INPLACE_ARRAY1,int DIM1,int* INPLACE_ARRAY2,int DIM1,int DIM2,double* INPLACE_ARRAY2,int DIM1,int DIM2,long long* INPLACE_ARRAY1,int DIM1);
             %rename(get_center_cell_coordinates) GetCenterCellCoordinates;
             dvec3 GetCenterCellCoordinates( ivec3 cell_id) const;
             %rename(get_cell_id_by_coord) GetCellIdByCoord;
             ivec3 GetCellIdByCoord(const dvec3& position);
             %rename(get_matrix_value) GetMatrixValue;
             short GetMatrixValue(const ivec3& index);
+            %rename(query_points) QueryPoints;
+            void QueryPoints(double* IN_ARRAY2,int DIM1,int DIM2,int* INPLACE_ARRAY2,int DIM1,int DIM2,short* INPLACE_ARRAY1,int DIM1);
             %rename(get_domain_size) GetDomainSize;
             unsigned int GetDomainSize();
             %rename(copy_matrix) CopyMatrix;
             void CopyMatrix(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& extractPos);
             %rename(copy_matrix_filtered) CopyMatrixFiltered;
             void CopyMatrixFiltered(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& extractPos,short* IN_ARRAY1,int DIM1 );
+            %rename(copy_matrix_strided) CopyMatrixStrided;
+            void CopyMatrixStrided(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& start,const ivec3& step);
+            %rename(copy_matrix_strided_filtered) CopyMatrixStridedFiltered;
+            void CopyMatrixStridedFiltered(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& start,const ivec3& step,short* IN_ARRAY1,int DIM1);
+            %rename(copy_matrix_indexed) CopyMatrixIndexed;
+            void CopyMatrixIndexed(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,int* IN_ARRAY1,int DIM1,int* IN_ARRAY1,int DIM1,int* IN_ARRAY1,int DIM1);
+            %rename(copy_matrix_indexed_filtered) CopyMatrixIndexedFiltered;
+            void CopyMatrixIndexedFiltered(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,int* IN_ARRAY1,int DIM1,int* IN_ARRAY1,int DIM1,int* IN_ARRAY1,int DIM1,short* IN_ARRAY1,int DIM1);
             %rename(get_cell_value_boundaries) GetCellValueBoundaries;
             void GetCellValueBoundaries(ivec3& min,ivec3& max,const short& volid);
             %rename(get_first_volume_index) GetFirstVolumeIndex;
             short GetFirstVolumeIndex();
+            %rename(build_label_run_index) BuildLabelRunIndex;
+            void BuildLabelRunIndex();
+            %rename(get_label_run_count) GetLabelRunCount;
+            size_t GetLabelRunCount(const short& label);
+            %rename(copy_label_runs) CopyLabelRuns;
+            void CopyLabelRuns(const short& label,int* INPLACE_ARRAY2,int DIM1,int DIM2);
+            %rename(export_vtk) ExportVTK;
+            void ExportVTK(const std::string& filename,const short& idVol=-1,EXPORT_FORMAT format=EXPORT_VTK_ASCII);
+            %rename(export_volumes_vtk) ExportVolumesVTK;
+            void ExportVolumesVTK(const std::string& filename,const std::vector<short>& volumeIds,EXPORT_FORMAT format=EXPORT_VTK_ASCII);
+            %rename(export_npy) ExportNpy;
+            void ExportNpy(const std::string& filename,const ivec3& origin,const ivec3& shape);
+            %rename(export_npy_filtered) ExportNpyFiltered;
+            void ExportNpyFiltered(const std::string& filename,const ivec3& origin,const ivec3& shape,short* IN_ARRAY1,int DIM1);
+            %rename(export_chunks) ExportChunks;
+            void ExportChunks(const std::string& directory,const int& chunkSize=64);
+            %rename(get_volume_block) GetVolumeBlock;
+            void GetVolumeBlock(const short& volId,const int& padding,ivec3& origin,ivec3& shape);
+            %rename(save) Save;
+            void Save(const std::string& path);
+            %rename(load) Load;
+            void Load(const std::string& path);
+            %rename(get_serialized_size) GetSerializedSize;
+            size_t GetSerializedSize();
+            %rename(serialize) Serialize;
+            void Serialize(unsigned char* INPLACE_ARRAY1,long long DIM1);
+            %rename(deserialize) Deserialize;
+            void Deserialize(unsigned char* IN_ARRAY1,long long DIM1);
+            %pythoncode %{
+                def _get_options(self):
+                    # Settings that are not part of the serialized field
+                    return {"thread_count": self.get_thread_count(),
+                            "minimal_volume": self.get_minimal_volume(),
+                            "minimal_cell_count": self.get_minimal_cell_count(),
+                            "small_volume_value": self.get_small_volume_value(),
+                            "transparent_markers": list(self.get_transparent_markers())}
+
+                def __setstate__(self, options):
+                    self.set_thread_count(options["thread_count"])
+                    self.set_minimal_volume(options["minimal_volume"])
+                    self.set_minimal_cell_count(options["minimal_cell_count"])
+                    self.set_small_volume_value(options["small_volume_value"])
+                    self.set_transparent_markers(options["transparent_markers"])
+
+                def __reduce__(self):
+                    state = numpy.empty(self.get_serialized_size(), dtype=numpy.uint8)
+                    self.serialize(state)
+                    return (_load_serialized_field, (type(self), state.tobytes()), self._get_options())
+            %}
+    };
+    class Mesh
+    {
+        public:
+            Mesh();
+            %rename(set_thread_count) SetThreadCount;
+            void SetThreadCount(const unsigned int& threadCount);
+            %rename(load_ply) LoadPly;
+            bool LoadPly(const std::string& path);
+            %rename(load_stl) LoadStl;
+            bool LoadStl(const std::string& path);
+            %rename(load_obj) LoadObj;
+            bool LoadObj(const std::string& path);
+            %rename(load) Load;
+            bool Load(const std::string& path);
+            %rename(set_arrays) SetArrays;
+            void SetArrays(double* IN_ARRAY2,int DIM1,int DIM2,int* IN_ARRAY2,int DIM1,int DIM2);
+            %rename(set_markers) SetMarkers;
+            void SetMarkers(short* IN_ARRAY1,int DIM1);
+            %rename(get_vertex_count) GetVertexCount;
+            size_t GetVertexCount() const;
+            %rename(get_face_count) GetFaceCount;
+            size_t GetFaceCount() const;
+            %rename(get_box_min) GetBoxMin;
+            const dvec3& GetBoxMin() const;
+            %rename(get_box_max) GetBoxMax;
+            const dvec3& GetBoxMax() const;
+            %rename(get_marker_names) GetMarkerNames;
+            const std::vector<std::string>& GetMarkerNames() const;
+            %rename(build_face_boxes) BuildFaceBoxes;
+            void BuildFaceBoxes();
+            %rename(build_morton_order) BuildMortonOrder;
+            void BuildMortonOrder();
+            %rename(clear_morton_order) ClearMortonOrder;
+            void ClearMortonOrder();
+            %rename(copy_vertices) CopyVertices;
+            void CopyVertices(double* INPLACE_ARRAY2,int DIM1,int DIM2) const;
+            %rename(copy_faces) CopyFaces;
+            void CopyFaces(int* INPLACE_ARRAY2,int DIM1,int DIM2) const;
+            %rename(copy_markers) CopyMarkers;
+            void CopyMarkers(short* INPLACE_ARRAY1,int DIM1) const;
+            %rename(copy_face_boxes) CopyFaceBoxes;
+            void CopyFaceBoxes(double* INPLACE_ARRAY2,int DIM1,int DIM2) const;
+            %rename(copy_morton_order) CopyMortonOrder;
+            void CopyMortonOrder(int* INPLACE_ARRAY1,int DIM1) const;
     };
     class TriangleScalarFieldCreator : public ScalarFieldCreator
     {
@@ -184,5 +420,111 @@ namespace ScalarFieldBuilders
             void SecondStep_PushTri(const dvec3& A,const dvec3& B,const dvec3& C,const short& marker=1);
             %rename(load_ply_model) LoadPlyModel;
             bool LoadPlyModel(const std::string& fileInput);
+            %rename(voxelize_mesh) VoxelizeMesh;
+            void VoxelizeMesh(const Mesh& mesh);
+            %rename(set_parity_mode) SetParityMode;
+            void SetParityMode(bool _parityMode);
+            %rename(get_parity_mode) GetParityMode;
+            bool GetParityMode();
+            %rename(third_step_parity_volumescreator) ThirdStep_ParityVolumesCreator;
+            void ThirdStep_ParityVolumesCreator();
+            %rename(set_cache) SetCache;
+            void SetCache(const std::string& directory,const unsigned long long& maxSize=0);
+            %rename(set_model_bounds) SetModelBounds;
+            void SetModelBounds(const dvec3& boxMin,const dvec3& boxMax);
+            %rename(get_cache_directory) GetCacheDirectory;
+            std::string GetCacheDirectory();
+            %rename(get_cache_max_size) GetCacheMaxSize;
+            unsigned long long GetCacheMaxSize();
+            %rename(get_model_bounds) GetModelBounds;
+            bool GetModelBounds(dvec3& boxMin,dvec3& boxMax);
+            %rename(clear_model_bounds) ClearModelBounds;
+            void ClearModelBounds();
+            %pythoncode %{
+                def _get_options(self):
+                    options = ScalarFieldCreator._get_options(self)
+                    options["parity_mode"] = self.get_parity_mode()
+                    options["cache"] = None
+                    if self.get_cache_directory():
+                        options["cache"] = (self.get_cache_directory(), self.get_cache_max_size())
+                    options["model_bounds"] = None
+                    box_min, box_max = dvec3(), dvec3()
+                    if self.get_model_bounds(box_min, box_max):
+                        options["model_bounds"] = tuple((bound[0], bound[1], bound[2]) for bound in (box_min, box_max))
+                    return options
+
+                def __setstate__(self, options):
+                    ScalarFieldCreator.__setstate__(self, options)
+                    self.set_parity_mode(options["parity_mode"])
+                    if options["cache"] is not None:
+                        self.set_cache(*options["cache"])
+                    if options["model_bounds"] is not None:
+                        self.set_model_bounds(*[dvec3(*bound) for bound in options["model_bounds"]])
+            %}
+    };
+    class RunViews
+    {
+        public:
+            RunViews(ScalarFieldCreator& field);
+            %rename(get_views) GetViews;
+            void GetViews(unsigned long long** ARGOUTVIEW_ARRAY1,int* DIM1,unsigned int** ARGOUTVIEW_ARRAY1,int* DIM1,short** ARGOUTVIEW_ARRAY1,int* DIM1);
+    };
+    /* The cache reads the field, the proxy keeps it alive. The default arguments make SWIG wrap the constructor
+     * with *args, the field is the first one. */
+    %pythonappend BlockCache::BlockCache %{
+        self._field = args[0]
+    %}
+    class BlockCache
+    {
+        public:
+            BlockCache(ScalarFieldCreator& field,const unsigned long long& maxSize=256*1024*1024,const int& brickSize=32);
+            %rename(copy_matrix) CopyMatrix;
+            void CopyMatrix(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& extractPos);
+            %rename(copy_matrix_filtered) CopyMatrixFiltered;
+            void CopyMatrixFiltered(short* INPLACE_ARRAY3,int DIM1,int DIM2,int DIM3,const ivec3& extractPos,short* IN_ARRAY1,int DIM1 );
+            %rename(get_domain_size) GetDomainSize;
+            size_t GetDomainSize();
+            %rename(set_read_ahead) SetReadAhead;
+            void SetReadAhead(const int& readAhead);
+            %rename(clear) Clear;
+            void Clear();
+            %rename(get_brick_count) GetBrickCount;
+            size_t GetBrickCount();
+            %rename(get_hit_count) GetHitCount;
+            unsigned long long GetHitCount();
+            %rename(get_miss_count) GetMissCount;
+            unsigned long long GetMissCount();
+    };
+    %pythonappend LoadJob::LoadJob %{
+        self._result_lock = threading.Lock()
+    %}
+    class LoadJob
+    {
+        public:
+            LoadJob(const std::string& path,const double& resolution);
+            ~LoadJob();
+            %rename(progress) GetProgress;
+            float GetProgress() const;
+            %rename(cancel) Cancel;
+            void Cancel();
+            %rename(done) IsDone;
+            bool IsDone() const;
+            %rename(_take_result) TakeResult;
+            TriangleScalarFieldCreator* TakeResult();
+            %pythoncode %{
+                def result(self):
+                    # Wait for the end of the job and return the field, raise RuntimeError if it failed or was canceled.
+                    # Concurrent calls return the same field.
+                    with self._result_lock:
+                        if not hasattr(self, "_result"):
+                            self._result = self._take_result()
+                    return self._result
+            %}
     };
 };
+
+%pythoncode %{
+def submit_load(path, resolution):
+    # Load and label a PLY model on a native thread, the returned job has progress(), cancel(), done() and result()
+    return LoadJob(path, resolution)
+%}
@@ -0,0 +1,205 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "field_cache.hpp"
+#include <tools/file_mapping.hpp>
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <cstdio>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <windows.h>
+	#include <process.h>
+	#include <sys/utime.h>
+#else
+	#include <unistd.h>
+	#include <utime.h>
+#endif
+
+namespace ScalarFieldBuilders
+{
+	ContentHash::ContentHash()
+	{
+		lanes[0]=14695981039346656037ULL;
+		lanes[1]=0x6c62272e07bb0142ULL;
+	}
+	void ContentHash::Add(const void* data,const std::size_t& size)
+	{
+		const unsigned char* bytes((const unsigned char*)data);
+		unsigned long long lane0(lanes[0]),lane1(lanes[1]);
+		for(std::size_t idByte=0;idByte<size;idByte++)
+		{
+			lane0=(lane0^bytes[idByte])*1099511628211ULL;
+			lane1=(lane1^bytes[idByte])*0x100000001b3ULL+(lane1>>29);
+		}
+		lanes[0]=lane0;
+		lanes[1]=lane1;
+	}
+	void ContentHash::AddString(const std::string& value)
+	{
+		AddValue((unsigned long long)value.size());
+		Add(value.data(),value.size());
+	}
+	/**
+	 * Final mix of a lane, so that the last bytes change all the digits
+	 */
+	static unsigned long long MixLane(unsigned long long lane)
+	{
+		lane^=lane>>33;
+		lane*=0xff51afd7ed558ccdULL;
+		lane^=lane>>33;
+		lane*=0xc4ceb9fe1a85ec53ULL;
+		lane^=lane>>33;
+		return lane;
+	}
+	std::string ContentHash::GetHex() const
+	{
+		std::ostringstream hex;
+		hex<<std::hex<<std::setfill('0')<<std::setw(16)<<MixLane(lanes[0])<<std::setw(16)<<MixLane(lanes[1]^lanes[0]);
+		return hex.str();
+	}
+
+	struct cacheEntry_t
+	{
+		std::string path;
+		unsigned long long size;
+		time_t lastUse;
+		bool operator<(const cacheEntry_t& other) const
+		{
+			return lastUse<other.lastUse || (lastUse==other.lastUse && path<other.path);
+		}
+	};
+
+	/**
+	 * .fvx files of the directory
+	 */
+	static void ListCacheEntries(const std::string& directory,std::vector<cacheEntry_t>& entries)
+	{
+		const std::vector<std::string> names(file_tools::ListDirectory(directory,".fvx"));
+		for(std::vector<std::string>::const_iterator itname=names.begin();itname!=names.end();itname++)
+		{
+			cacheEntry_t cacheEntry;
+			cacheEntry.path=directory+"/"+*itname;
+			struct stat fileStat;
+			if(stat(cacheEntry.path.c_str(),&fileStat)!=0)
+				continue;
+			cacheEntry.size=fileStat.st_size;
+			cacheEntry.lastUse=fileStat.st_mtime;
+			entries.push_back(cacheEntry);
+		}
+	}
+
+	FieldCache::FieldCache(const std::string& _directory,const unsigned long long& _maxSize)
+		:directory(_directory),maxSize(_maxSize)
+	{
+		//The fields are still computed without the directory, Store reports each failed write
+		if(!file_tools::MakeDirectory(directory))
+			std::cerr<<"Can not create the cache directory "<<directory<<", the fields will not be cached"<<std::endl;
+	}
+	const std::string& FieldCache::GetDirectory() const
+	{
+		return directory;
+	}
+	const unsigned long long& FieldCache::GetMaxSize() const
+	{
+		return maxSize;
+	}
+	std::string FieldCache::GetPath(const std::string& key) const
+	{
+		return directory+"/"+key+".fvx";
+	}
+	bool FieldCache::Fetch(const std::string& key,ScalarFieldCreator& field)
+	{
+		const std::string path(GetPath(key));
+		struct stat fileStat;
+		if(stat(path.c_str(),&fileStat)!=0)
+			return false;
+		try
+		{
+			field.Load(path);
+		}catch(const std::runtime_error&)
+		{
+			//Truncated or outdated file, it is replaced by the next Store
+			return false;
+		}
+		//Last use time for the eviction
+		#ifdef _WIN32
+		_utime(path.c_str(),NULL);
+		#else
+		utime(path.c_str(),NULL);
+		#endif
+		return true;
+	}
+	bool FieldCache::Store(const std::string& key,ScalarFieldCreator& field)
+	{
+		//Written under a temporary name then renamed, so a concurrent Fetch never reads a partial file.
+		//The name is unique for each process, thread and call, fields of the same key can be stored at the same time.
+		static std::atomic<unsigned long long> storeCount(0);
+		std::ostringstream temporaryPath;
+		#ifdef _WIN32
+		temporaryPath<<GetPath(key)<<"."<<_getpid();
+		#else
+		temporaryPath<<GetPath(key)<<"."<<getpid();
+		#endif
+		temporaryPath<<"."<<std::this_thread::get_id()<<"."<<storeCount++<<".tmp";
+		try
+		{
+			field.Save(temporaryPath.str());
+			#ifdef _WIN32
+			std::remove(GetPath(key).c_str()); //rename does not replace a file on Windows
+			#endif
+			if(std::rename(temporaryPath.str().c_str(),GetPath(key).c_str())!=0)
+				throw std::runtime_error("Can not write the cached field "+GetPath(key));
+		}catch(const std::exception& error)
+		{
+			std::remove(temporaryPath.str().c_str());
+			std::cerr<<"The field is not cached: "<<error.what()<<std::endl;
+			return false;
+		}
+		Evict();
+		return true;
+	}
+	void FieldCache::Evict()
+	{
+		if(maxSize==0)
+			return;
+		std::vector<cacheEntry_t> entries;
+		ListCacheEntries(directory,entries);
+		unsigned long long totalSize(0);
+		for(std::vector<cacheEntry_t>::const_iterator itentry=entries.begin();itentry!=entries.end();itentry++)
+			totalSize+=itentry->size;
+		std::sort(entries.begin(),entries.end());
+		for(std::vector<cacheEntry_t>::const_iterator itentry=entries.begin();itentry!=entries.end() && totalSize>maxSize;itentry++)
+		{
+			if(std::remove(itentry->path.c_str())==0)
+				totalSize-=itentry->size;
+		}
+	}
+}
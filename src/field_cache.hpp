@@ -0,0 +1,89 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#include "scalar_field_creator.hpp"
+#include <string>
+
+#ifndef __FIELD_CACHE__
+#define __FIELD_CACHE__
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * 128 bits hash of a byte stream, to name the cached fields by their input.
+	 * Two 64 bits FNV-1a lanes with different bases, not a cryptographic hash.
+	 */
+	class ContentHash
+	{
+	public:
+		ContentHash();
+		void Add(const void* data,const std::size_t& size);
+		template<typename T>
+		void AddValue(const T& value)
+		{
+			Add(&value,sizeof(T));
+		}
+		void AddString(const std::string& value);
+		/**
+		 * @return 32 hexadecimal characters
+		 */
+		std::string GetHex() const;
+	private:
+		unsigned long long lanes[2];
+	};
+
+	/**
+	 * Directory of labeled fields saved as .fvx files named by their key.
+	 * Fetch refresh the modification time of the file, the oldest files are removed when the directory exceeds its size cap.
+	 */
+	class FieldCache
+	{
+	public:
+		/**
+		 * @param directory Cache directory, created if it does not exist
+		 * @param maxSize Size cap of the .fvx files of the directory in bytes, 0 for no cap
+		 */
+		FieldCache(const std::string& directory,const unsigned long long& maxSize);
+		/**
+		 * Load the field of the key in field
+		 * @return False if the key is not in the cache
+		 */
+		bool Fetch(const std::string& key,ScalarFieldCreator& field);
+		/**
+		 * Save the field under the key then remove the least recently used fields above the size cap.
+		 * The cache is optional: if the field can not be written the error is printed and the cache is left unchanged.
+		 * @return False if the field has not been stored
+		 */
+		bool Store(const std::string& key,ScalarFieldCreator& field);
+		/**
+		 * Remove the least recently used fields until the directory is under the size cap
+		 */
+		void Evict();
+		const std::string& GetDirectory() const;
+		const unsigned long long& GetMaxSize() const;
+	private:
+		std::string GetPath(const std::string& key) const;
+		std::string directory;
+		unsigned long long maxSize;
+	};
+}
+
+#endif
@@ -0,0 +1,194 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "obj_interface.hpp"
+#include <tools/ascii_number.hpp>
+#include <tools/file_mapping.hpp>
+#include <climits>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace formatOBJ
+{
+	static bool IsSpace(char character)
+	{
+		return character==' ' || character=='\t' || character=='\r';
+	}
+
+	/**
+	 * Read the vertex index of a face corner (v, v/vt, v//vn or v/vt/vn), move the cursor after the corner
+	 * @return False if there is no corner before the end of the line, or if the index does not fit in an unsigned int.
+	 * Then the cursor is left before the end of the line.
+	 */
+	static bool ParseCorner(const char*& cursor,const char* lineEnd,long long& index)
+	{
+		while(cursor<lineEnd && IsSpace(*cursor))
+			cursor++;
+		bool negative(false);
+		if(cursor<lineEnd && (*cursor=='-' || *cursor=='+'))
+		{
+			negative=(*cursor=='-');
+			cursor++;
+		}
+		if(cursor>=lineEnd || *cursor<'0' || *cursor>'9')
+			return false;
+		index=0;
+		for(;cursor<lineEnd && *cursor>='0' && *cursor<='9';cursor++)
+		{
+			index=index*10+(*cursor-'0');
+			if(index>UINT_MAX)
+				return false;
+		}
+		if(negative)
+			index=-index;
+		//Texture and normal indices
+		while(cursor<lineEnd && !IsSpace(*cursor))
+			cursor++;
+		return true;
+	}
+
+	/**
+	 * @return True if the line begin with the keyword followed by a space
+	 */
+	static bool IsStatement(const char* cursor,const char* lineEnd,const char* keyword)
+	{
+		const std::size_t length(strlen(keyword));
+		return (std::size_t)(lineEnd-cursor)>length && strncmp(cursor,keyword,length)==0 && IsSpace(cursor[length]);
+	}
+
+	bool CObj::ImportObj(t_model& model, const std::string& filename)
+	{
+		model.modelVertices.clear();
+		model.modelFaces.clear();
+		model.modelMaterials.clear();
+		model.modelFacesMaterialIndex.clear();
+		std::unique_ptr<file_tools::FileMapping> mapping;
+		try
+		{
+			mapping.reset(new file_tools::FileMapping(filename));
+		} catch(std::runtime_error&)
+		{
+			return false;
+		}
+		const char* data(mapping->GetData());
+		const char* dataEnd(data+mapping->GetSize());
+		std::map<std::string,std::size_t> materialIndex;
+		std::size_t currentMaterial(0);
+		bool hasMaterial(false);
+		bool hasUseMaterial(false);
+		std::vector<long long> polygon;
+		for(const char* lineBegin=data;lineBegin<dataEnd;)
+		{
+			const char* lineEnd((const char*)memchr(lineBegin,'\n',dataEnd-lineBegin));
+			if(!lineEnd)
+				lineEnd=dataEnd;
+			const char* cursor(lineBegin);
+			lineBegin=lineEnd+1;
+			while(cursor<lineEnd && IsSpace(*cursor))
+				cursor++;
+			if(IsStatement(cursor,lineEnd,"v"))
+			{
+				cursor++;
+				dvec3 vertex;
+				for(int axis=0;axis<3;axis++)
+				{
+					double value;
+					//The optional w and colors are skipped
+					const char* tokenEnd(cursor);
+					while(tokenEnd<lineEnd && IsSpace(*tokenEnd))
+						tokenEnd++;
+					while(tokenEnd<lineEnd && !IsSpace(*tokenEnd))
+						tokenEnd++;
+					if(!file_tools::ParseAsciiNumber(cursor,tokenEnd,value))
+						return false;
+					vertex[axis]=value;
+				}
+				model.modelVertices.push_back(vertex);
+			}else if(IsStatement(cursor,lineEnd,"f"))
+			{
+				cursor++;
+				polygon.clear();
+				long long index;
+				while(ParseCorner(cursor,lineEnd,index))
+				{
+					if(index==0)
+						return false;
+					polygon.push_back(index>0 ? index-1 : (long long)model.modelVertices.size()+index);
+				}
+				while(cursor<lineEnd && IsSpace(*cursor))
+					cursor++;
+				if(cursor<lineEnd)
+					return false;
+				if(polygon.size()<3)
+					continue;
+				if(!hasMaterial)
+				{
+					//Faces before the first usemtl
+					materialIndex[std::string()]=currentMaterial=model.modelMaterials.size();
+					model.modelMaterials.push_back(std::string());
+					hasMaterial=true;
+				}
+				for(std::size_t idVert=0;idVert<polygon.size();idVert++)
+				{
+					if(polygon[idVert]<0 || polygon[idVert]>UINT_MAX)
+						return false;
+				}
+				for(std::size_t idVert=2;idVert<polygon.size();idVert++)
+				{
+					model.modelFaces.push_back((unsigned int)polygon[0]);
+					model.modelFaces.push_back((unsigned int)polygon[idVert-1]);
+					model.modelFaces.push_back((unsigned int)polygon[idVert]);
+					model.modelFacesMaterialIndex.push_back(currentMaterial);
+				}
+			}else if(IsStatement(cursor,lineEnd,"usemtl"))
+			{
+				cursor+=6;
+				while(cursor<lineEnd && IsSpace(*cursor))
+					cursor++;
+				const char* nameEnd(lineEnd);
+				while(nameEnd>cursor && IsSpace(nameEnd[-1]))
+					nameEnd--;
+				const std::string name(cursor,nameEnd);
+				std::map<std::string,std::size_t>::const_iterator itmaterial(materialIndex.find(name));
+				if(itmaterial==materialIndex.end())
+				{
+					itmaterial=materialIndex.insert(std::make_pair(name,model.modelMaterials.size())).first;
+					model.modelMaterials.push_back(name);
+				}
+				currentMaterial=itmaterial->second;
+				hasMaterial=true;
+				hasUseMaterial=true;
+			}
+		}
+		for(std::vector<unsigned int>::const_iterator itindex=model.modelFaces.begin();itindex!=model.modelFaces.end();itindex++)
+		{
+			if(*itindex>=model.modelVertices.size())
+				return false;
+		}
+		if(!hasUseMaterial)
+		{
+			model.modelMaterials.clear();
+			model.modelFacesMaterialIndex.clear();
+		}
+		return true;
+	}
+}
@@ -0,0 +1,54 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include <Core/mathlib.h>
+#include <string>
+#include <vector>
+
+#ifndef __OBJ_INTERFACE__
+#define __OBJ_INTERFACE__
+
+namespace formatOBJ
+{
+	/**
+	 * Triangles of a Wavefront OBJ file and their material
+	 */
+	struct t_model
+	{
+		std::vector<dvec3> modelVertices;
+		std::vector<unsigned int> modelFaces; /*!< 3 vertex indices per triangle */
+		std::vector<std::string> modelMaterials; /*!< usemtl names in order of first use */
+		std::vector<std::size_t> modelFacesMaterialIndex; /*!< Material of each triangle, empty if the file has no usemtl */
+	};
+
+	class CObj
+	{
+	public:
+		/**
+		 * Import the v, f and usemtl statements of an OBJ file, the other statements are skipped. The polygons are split
+		 * in triangles fans and the negative indices are relative to the last vertex. The faces before the first usemtl
+		 * have an unnamed material.
+		 * @return False if the file can not be opened, a statement can not be read or a face refers to a missing vertex
+		 */
+		static bool ImportObj(t_model& model, const std::string& filename);
+	};
+}
+
+#endif
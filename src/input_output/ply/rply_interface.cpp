@@ -30,6 +30,19 @@
 
 #include "rply_interface.hpp"
 #include "rply.h"
+#include <tools/ascii_number.hpp>
+#include <tools/file_mapping.hpp>
+#include <tools/parallel_for.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#ifndef MAX
+	#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
 
 namespace formatRPLY
 {
@@ -141,16 +154,549 @@ namespace formatRPLY
 	};
 
 
-	bool CPly::ImportPly(t_model& sceneconst, std::string mfilename)
+	/**
+	 * Scalar types of the binary PLY files
+	 */
+	enum binary_type_t
+	{
+		BINARY_INT8,
+		BINARY_UINT8,
+		BINARY_INT16,
+		BINARY_UINT16,
+		BINARY_INT32,
+		BINARY_UINT32,
+		BINARY_FLOAT32,
+		BINARY_FLOAT64,
+		BINARY_UNKNOWN
+	};
+
+	static binary_type_t GetBinaryType(const std::string& name)
+	{
+		if(name=="char" || name=="int8") return BINARY_INT8;
+		if(name=="uchar" || name=="uint8") return BINARY_UINT8;
+		if(name=="short" || name=="int16") return BINARY_INT16;
+		if(name=="ushort" || name=="uint16") return BINARY_UINT16;
+		if(name=="int" || name=="int32") return BINARY_INT32;
+		if(name=="uint" || name=="uint32") return BINARY_UINT32;
+		if(name=="float" || name=="float32") return BINARY_FLOAT32;
+		if(name=="double" || name=="float64") return BINARY_FLOAT64;
+		return BINARY_UNKNOWN;
+	}
+
+	static std::size_t GetBinaryTypeSize(binary_type_t type)
+	{
+		static const std::size_t typeSize[]={1,1,2,2,4,4,4,8};
+		return typeSize[type];
+	}
+
+	/**
+	 * Little endian value at data, the host must be little endian
+	 */
+	static double ReadBinaryValue(const char* data,binary_type_t type)
+	{
+		switch(type)
+		{
+			case BINARY_INT8: { signed char value; memcpy(&value,data,1); return value; }
+			case BINARY_UINT8: { unsigned char value; memcpy(&value,data,1); return value; }
+			case BINARY_INT16: { short value; memcpy(&value,data,2); return value; }
+			case BINARY_UINT16: { unsigned short value; memcpy(&value,data,2); return value; }
+			case BINARY_INT32: { int value; memcpy(&value,data,4); return value; }
+			case BINARY_UINT32: { unsigned int value; memcpy(&value,data,4); return value; }
+			case BINARY_FLOAT32: { float value; memcpy(&value,data,4); return value; }
+			default: { double value; memcpy(&value,data,8); return value; }
+		}
+	}
+
+	struct header_property_t
+	{
+		std::string name;
+		bool isList;
+		binary_type_t countType; //Only for lists
+		binary_type_t valueType;
+	};
+
+	struct header_element_t
+	{
+		std::string name;
+		std::size_t count;
+		std::vector<header_property_t> properties;
+	};
+
+	/**
+	 * Reads the header of a PLY file
+	 * @param[out] format Storage of the elements: ascii, binary_little_endian or binary_big_endian
+	 * @param[out] dataOffset Position of the first element
+	 * @return False if the header is not valid or uses a type that is not known
+	 */
+	static bool ReadPlyHeader(const char* data,std::size_t size,std::vector<header_element_t>& elements,std::string& format,std::size_t& dataOffset)
+	{
+		if(size<3 || memcmp(data,"ply",3)!=0)
+			return false;
+		const char* headerEnd(NULL);
+		static const char endHeader[]="end_header";
+		for(std::size_t position=0;position+sizeof(endHeader)<=size && !headerEnd;position++)
+		{
+			if(memcmp(data+position,endHeader,sizeof(endHeader)-1)==0 && (position==0 || data[position-1]=='\n'))
+				headerEnd=data+position;
+		}
+		if(!headerEnd)
+			return false;
+		const char* dataBegin((const char*)memchr(headerEnd,'\n',size-(headerEnd-data)));
+		if(!dataBegin)
+			return false;
+		dataOffset=dataBegin+1-data;
+		std::istringstream header(std::string(data,headerEnd-data));
+		std::string line;
+		while(std::getline(header,line))
+		{
+			std::istringstream lineStream(line);
+			std::string keyword;
+			lineStream>>keyword;
+			if(keyword=="format")
+				lineStream>>format;
+			else if(keyword=="element")
+			{
+				header_element_t element;
+				if(!(lineStream>>element.name>>element.count))
+					return false;
+				elements.push_back(element);
+			}else if(keyword=="property")
+			{
+				if(elements.empty())
+					return false;
+				header_property_t property;
+				std::string typeName;
+				lineStream>>typeName;
+				property.isList=(typeName=="list");
+				if(property.isList)
+				{
+					std::string countTypeName;
+					lineStream>>countTypeName>>typeName;
+					property.countType=GetBinaryType(countTypeName);
+					if(property.countType==BINARY_UNKNOWN)
+						return false;
+				}
+				property.valueType=GetBinaryType(typeName);
+				if(property.valueType==BINARY_UNKNOWN || !(lineStream>>property.name))
+					return false;
+				elements.back().properties.push_back(property);
+			}
+		}
+		return !format.empty();
+	}
+
+	/**
+	 * Reserve the model arrays from the element counts of the header
+	 */
+	static void ReserveModel(t_model& model,const std::vector<header_element_t>& elements)
+	{
+		for(std::vector<header_element_t>::const_iterator itelement=elements.begin();itelement!=elements.end();itelement++)
+		{
+			if(itelement->name=="vertex")
+				model.modelVertices.reserve(model.modelVertices.size()+itelement->count);
+			else if(itelement->name=="face")
+			{
+				model.modelFaces.reserve(model.modelFaces.size()+itelement->count);
+				model.modelFacesLayerIndex.reserve(model.modelFacesLayerIndex.size()+itelement->count);
+			}else if(itelement->name=="layer")
+				model.modelLayers.reserve(model.modelLayers.size()+itelement->count);
+		}
+	}
+
+	/**
+	 * Give the vertices and faces of an import to its listener
+	 */
+	class ImportNotifier
+	{
+	public:
+		ImportNotifier(t_import_listener* _listener)
+			:listener(_listener),faceRowCount(0),verticesNotified(false),notifiedFaceCount(0)
+		{
+		}
+		void SetFaceRowCount(std::size_t _faceRowCount)
+		{
+			faceRowCount=_faceRowCount;
+		}
+		void VerticesRead(const t_model& model)
+		{
+			if(listener && !verticesNotified)
+				listener->VerticesRead(model,faceRowCount);
+			verticesNotified=true;
+		}
+		/**
+		 * Give the faces read since the last call if there are at least minimalCount of them
+		 */
+		void FacesRead(const t_model& model,std::size_t minimalCount)
+		{
+			const std::size_t faceCount(model.modelFaces.size());
+			if(listener && verticesNotified && faceCount>notifiedFaceCount && faceCount-notifiedFaceCount>=minimalCount)
+			{
+				listener->FacesRead(model,notifiedFaceCount,faceCount);
+				notifiedFaceCount=faceCount;
+			}
+		}
+		/**
+		 * The import is done, give the remaining faces
+		 */
+		void Finish(const t_model& model)
+		{
+			VerticesRead(model);
+			FacesRead(model,0);
+		}
+	private:
+		t_import_listener* listener;
+		std::size_t faceRowCount;
+		bool verticesNotified;
+		std::size_t notifiedFaceCount;
+	};
+
+	/**
+	 * Import of a memory mapped binary little endian file, the vertex and face arrays are decoded in bulk. The host must be little endian.
+	 * @param position Position of the first element
+	 * @return True if the file is read, false if it is truncated
+	 */
+	static bool ImportBinaryLittleEndianPly(t_model& model,const std::vector<header_element_t>& elements,const char* data,std::size_t size,std::size_t position,
+		ImportNotifier& notifier)
+	{
+		const std::size_t notifiedBatchSize(4096);
+		ReserveModel(model,elements);
+		bool lastFaceSplited(false);
+		for(std::vector<header_element_t>::const_iterator itelement=elements.begin();itelement!=elements.end();itelement++)
+		{
+			const std::vector<header_property_t>& properties(itelement->properties);
+			//Fixed size rows: offsets of the properties
+			bool fixedSize(true);
+			std::size_t rowSize(0);
+			std::vector<std::size_t> propertyOffset;
+			for(std::vector<header_property_t>::const_iterator itproperty=properties.begin();itproperty!=properties.end();itproperty++)
+			{
+				fixedSize=fixedSize && !itproperty->isList;
+				propertyOffset.push_back(rowSize);
+				rowSize+=GetBinaryTypeSize(itproperty->valueType);
+			}
+			if(itelement->name=="vertex" && fixedSize)
+			{
+				if(itelement->count>0 && (size-position)/itelement->count<rowSize)
+					return false;
+				int axisProperty[3]={-1,-1,-1};
+				for(std::size_t idProperty=0;idProperty<properties.size();idProperty++)
+				{
+					const std::string& name(properties[idProperty].name);
+					if(name.size()==1 && name[0]>='x' && name[0]<='z')
+						axisProperty[name[0]-'x']=(int)idProperty;
+				}
+				//As rply, a vertex is added by its x property
+				if(axisProperty[0]!=-1)
+				{
+					for(std::size_t idVertex=0;idVertex<itelement->count;idVertex++)
+					{
+						const char* row(data+position+idVertex*rowSize);
+						dvec3 vertex;
+						for(int axis=0;axis<3;axis++)
+						{
+							if(axisProperty[axis]!=-1)
+								vertex[axis]=ReadBinaryValue(row+propertyOffset[axisProperty[axis]],properties[axisProperty[axis]].valueType);
+						}
+						model.modelVertices.push_back(vertex);
+					}
+				}
+				position+=itelement->count*rowSize;
+				notifier.VerticesRead(model);
+				continue;
+			}
+			//Properties read by the importer, the others are skipped
+			enum { SKIP_PROPERTY, FACE_INDICES, FACE_LAYER, LAYER_NAME };
+			std::vector<int> propertyUse(properties.size(),SKIP_PROPERTY);
+			for(std::size_t idProperty=0;idProperty<properties.size();idProperty++)
+			{
+				const std::string& name(properties[idProperty].name);
+				if(itelement->name=="face" && properties[idProperty].isList && (name=="vertex_indices" || name=="vertex_index"))
+					propertyUse[idProperty]=FACE_INDICES;
+				else if(itelement->name=="face" && !properties[idProperty].isList && name=="layer_id")
+					propertyUse[idProperty]=FACE_LAYER;
+				else if(itelement->name=="layer" && properties[idProperty].isList && name=="layer_name")
+					propertyUse[idProperty]=LAYER_NAME;
+			}
+			for(std::size_t idRow=0;idRow<itelement->count;idRow++)
+			{
+				for(std::size_t idProperty=0;idProperty<properties.size();idProperty++)
+				{
+					const header_property_t& property(properties[idProperty]);
+					const std::size_t valueSize(GetBinaryTypeSize(property.valueType));
+					if(!property.isList)
+					{
+						if(size-position<valueSize)
+							return false;
+						if(propertyUse[idProperty]==FACE_LAYER)
+						{
+							const std::size_t layerIndex((std::size_t)ReadBinaryValue(data+position,property.valueType));
+							model.modelFacesLayerIndex.push_back(layerIndex);
+							if(lastFaceSplited)
+								model.modelFacesLayerIndex.push_back(layerIndex);
+						}
+						position+=valueSize;
+						continue;
+					}
+					const std::size_t countSize(GetBinaryTypeSize(property.countType));
+					if(size-position<countSize)
+						return false;
+					const double listCount(ReadBinaryValue(data+position,property.countType));
+					if(listCount<0)
+						return false;
+					const std::size_t valueCount((std::size_t)listCount);
+					position+=countSize;
+					if((size-position)/valueSize<valueCount)
+						return false;
+					const char* values(data+position);
+					position+=valueCount*valueSize;
+					if(propertyUse[idProperty]==FACE_INDICES)
+					{
+						if(valueCount==0)
+							continue;
+						//Same triangles than the rply callbacks, quads are split in two triangles
+						ivec3 triangle;
+						for(std::size_t idVert=0;idVert<3 && idVert<valueCount;idVert++)
+							triangle.i[idVert]=(long)ReadBinaryValue(values+idVert*valueSize,property.valueType);
+						model.modelFaces.push_back(t_face(triangle));
+						lastFaceSplited=(valueCount>=4);
+						if(lastFaceSplited)
+							model.modelFaces.push_back(t_face(ivec3(triangle.i[0],triangle.i[2],(long)ReadBinaryValue(values+3*valueSize,property.valueType))));
+						for(std::size_t idVert=4;idVert<valueCount;idVert++)
+							fprintf(stderr, "Unhandled polygon with %li vertices\n", (long)idVert);
+					}else if(propertyUse[idProperty]==LAYER_NAME)
+					{
+						std::string layerName(valueCount,' ');
+						for(std::size_t idChar=0;idChar<valueCount;idChar++)
+							layerName[idChar]=(unsigned char)ReadBinaryValue(values+idChar*valueSize,property.valueType);
+						model.modelLayers.push_back(t_layer(layerName));
+					}
+				}
+				notifier.FacesRead(model,notifiedBatchSize);
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Parse the lines of a chunk of an ascii PLY file
+	 * @param elementLine First line of each element, and the line after the last element
+	 * @return False if a line does not match the properties of its element
+	 */
+	static bool ParseAsciiChunk(t_model& model,const std::vector<header_element_t>& elements,const std::vector<std::size_t>& elementLine,
+		const char* chunkBegin,const char* chunkEnd,std::size_t line)
+	{
+		std::size_t idElement(0);
+		bool lastFaceSplited(false);
+		std::vector<double> listValues;
+		for(const char* lineBegin=chunkBegin;lineBegin<chunkEnd;line++)
+		{
+			const char* lineEnd((const char*)memchr(lineBegin,'\n',chunkEnd-lineBegin));
+			if(!lineEnd)
+				lineEnd=chunkEnd;
+			const char* cursor(lineBegin);
+			lineBegin=lineEnd+1;
+			while(idElement<elements.size() && line>=elementLine[idElement+1])
+				idElement++;
+			if(idElement>=elements.size())
+			{
+				//Only blank lines after the last element
+				while(cursor<lineEnd && (*cursor==' ' || *cursor=='\t' || *cursor=='\r'))
+					cursor++;
+				if(cursor<lineEnd)
+					return false;
+				continue;
+			}
+			const header_element_t& element(elements[idElement]);
+			const bool isVertex(element.name=="vertex"),isFace(element.name=="face"),isLayer(element.name=="layer");
+			dvec3 vertex;
+			bool hasX(false);
+			for(std::vector<header_property_t>::const_iterator itproperty=element.properties.begin();itproperty!=element.properties.end();itproperty++)
+			{
+				double value;
+				if(!file_tools::ParseAsciiNumber(cursor,lineEnd,value))
+					return false;
+				if(!itproperty->isList)
+				{
+					const std::string& name(itproperty->name);
+					if(isVertex && name.size()==1 && name[0]>='x' && name[0]<='z')
+					{
+						vertex[name[0]-'x']=value;
+						hasX=hasX || name[0]=='x';
+					}else if(isFace && name=="layer_id")
+					{
+						model.modelFacesLayerIndex.push_back((std::size_t)value);
+						if(lastFaceSplited)
+							model.modelFacesLayerIndex.push_back((std::size_t)value);
+					}
+					continue;
+				}
+				if(value<0)
+					return false;
+				listValues.resize((std::size_t)value);
+				for(std::size_t idValue=0;idValue<listValues.size();idValue++)
+				{
+					if(!file_tools::ParseAsciiNumber(cursor,lineEnd,listValues[idValue]))
+						return false;
+				}
+				if(isFace && (itproperty->name=="vertex_indices" || itproperty->name=="vertex_index") && !listValues.empty())
+				{
+					//Same triangles than the rply callbacks, quads are split in two triangles
+					ivec3 triangle;
+					for(std::size_t idVert=0;idVert<3 && idVert<listValues.size();idVert++)
+						triangle.i[idVert]=(long)listValues[idVert];
+					model.modelFaces.push_back(t_face(triangle));
+					lastFaceSplited=(listValues.size()>=4);
+					if(lastFaceSplited)
+						model.modelFaces.push_back(t_face(ivec3(triangle.i[0],triangle.i[2],(long)listValues[3])));
+					for(std::size_t idVert=4;idVert<listValues.size();idVert++)
+						fprintf(stderr, "Unhandled polygon with %li vertices\n", (long)idVert);
+				}else if(isLayer && itproperty->name=="layer_name")
+				{
+					std::string layerName(listValues.size(),' ');
+					for(std::size_t idChar=0;idChar<listValues.size();idChar++)
+						layerName[idChar]=(unsigned char)listValues[idChar];
+					model.modelLayers.push_back(t_layer(layerName));
+				}
+			}
+			if(isVertex && hasX)
+				model.modelVertices.push_back(vertex);
+			//A row per line
+			while(cursor<lineEnd && (*cursor==' ' || *cursor=='\t' || *cursor=='\r'))
+				cursor++;
+			if(cursor<lineEnd)
+				return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Import of a memory mapped ascii file with one element per line. The file is split in chunks of lines parsed in parallel.
+	 * @param position Position of the first element
+	 * @param requestedThreadCount Thread count, 0 to use all hardware threads
+	 * @return False if the file does not have one element per line, then it must be read by rply
+	 */
+	static bool ImportAsciiPly(t_model& model,const std::vector<header_element_t>& elements,const char* data,std::size_t size,std::size_t position,unsigned int requestedThreadCount)
+	{
+		const std::size_t minimalChunkSize(1<<20);
+		const std::size_t dataSize(size-position);
+		const unsigned int threadCount(parallel_tools::ResolveThreadCount(requestedThreadCount,dataSize/minimalChunkSize+1));
+		//Chunks boundaries are moved after the next end of line
+		const std::size_t chunkCount(dataSize/minimalChunkSize>threadCount*4 ? threadCount*4 : dataSize/minimalChunkSize+1);
+		std::vector<const char*> chunkBegin(chunkCount+1,data+size);
+		chunkBegin[0]=data+position;
+		for(std::size_t chunk=1;chunk<chunkCount;chunk++)
+		{
+			const char* boundary(MAX(data+position+dataSize*chunk/chunkCount,chunkBegin[chunk-1]));
+			const char* lineEnd((const char*)memchr(boundary,'\n',data+size-boundary));
+			chunkBegin[chunk]=lineEnd ? lineEnd+1 : data+size;
+		}
+		//First line of each chunk
+		std::vector<std::size_t> chunkLine(chunkCount+1,0);
+		parallel_tools::ParallelFor(threadCount,0,chunkCount,[&](std::size_t begin,std::size_t end,unsigned int)
+		{
+			for(std::size_t chunk=begin;chunk<end;chunk++)
+				chunkLine[chunk+1]=std::count(chunkBegin[chunk],chunkBegin[chunk+1],'\n');
+		});
+		for(std::size_t chunk=0;chunk<chunkCount;chunk++)
+			chunkLine[chunk+1]+=chunkLine[chunk];
+		std::vector<std::size_t> elementLine(elements.size()+1,0);
+		for(std::size_t idElement=0;idElement<elements.size();idElement++)
+			elementLine[idElement+1]=elementLine[idElement]+elements[idElement].count;
+		const bool lastLineEnded(size>position && data[size-1]=='\n');
+		if(chunkLine[chunkCount]+(lastLineEnded ? 0 : 1)<elementLine[elements.size()])
+			return false;
+		std::vector<t_model> chunkModels(chunkCount);
+		std::vector<char> chunkParsed(chunkCount,0);
+		parallel_tools::ParallelFor(threadCount,0,chunkCount,[&](std::size_t begin,std::size_t end,unsigned int)
+		{
+			for(std::size_t chunk=begin;chunk<end;chunk++)
+				chunkParsed[chunk]=ParseAsciiChunk(chunkModels[chunk],elements,elementLine,chunkBegin[chunk],chunkBegin[chunk+1],chunkLine[chunk]);
+		});
+		if(std::find(chunkParsed.begin(),chunkParsed.end(),0)!=chunkParsed.end())
+			return false;
+		if(chunkCount==1)
+		{
+			std::swap(model,chunkModels[0]);
+			return true;
+		}
+		ReserveModel(model,elements);
+		for(std::size_t chunk=0;chunk<chunkCount;chunk++)
+		{
+			const t_model& chunkModel(chunkModels[chunk]);
+			model.modelVertices.insert(model.modelVertices.end(),chunkModel.modelVertices.begin(),chunkModel.modelVertices.end());
+			model.modelFaces.insert(model.modelFaces.end(),chunkModel.modelFaces.begin(),chunkModel.modelFaces.end());
+			model.modelFacesLayerIndex.insert(model.modelFacesLayerIndex.end(),chunkModel.modelFacesLayerIndex.begin(),chunkModel.modelFacesLayerIndex.end());
+			model.modelLayers.insert(model.modelLayers.end(),chunkModel.modelLayers.begin(),chunkModel.modelLayers.end());
+		}
+		return true;
+	}
+
+	bool CPly::ImportPly(t_model& sceneconst, std::string mfilename, t_import_listener* listener, unsigned int threadCount)
 	{
 		sceneconst.modelFaces.clear();
 		sceneconst.modelVertices.clear();
+		sceneconst.modelLayers.clear();
+		sceneconst.modelFacesLayerIndex.clear();
+		ImportNotifier notifier(listener);
+		//Files read without rply: binary little endian on little endian hosts, ascii with one element per line
+		const unsigned int endianTest(1);
+		const bool littleEndianHost(*(const unsigned char*)&endianTest==1);
+		std::unique_ptr<file_tools::FileMapping> mapping;
+		try
+		{
+			mapping.reset(new file_tools::FileMapping(mfilename));
+		} catch(std::runtime_error&)
+		{
+			//rply reports the files that can not be opened
+		}
+		std::vector<header_element_t> elements;
+		std::string format;
+		std::size_t dataOffset;
+		if(mapping.get() && mapping->GetData() && ReadPlyHeader(mapping->GetData(),mapping->GetSize(),elements,format,dataOffset))
+		{
+			for(std::vector<header_element_t>::const_iterator itelement=elements.begin();itelement!=elements.end();itelement++)
+			{
+				if(itelement->name=="face")
+					notifier.SetFaceRowCount(itelement->count);
+			}
+			if(format=="binary_little_endian" && littleEndianHost)
+			{
+				if(!ImportBinaryLittleEndianPly(sceneconst,elements,mapping->GetData(),mapping->GetSize(),dataOffset,notifier))
+					return false;
+				notifier.Finish(sceneconst);
+				return true;
+			}
+			if(format=="ascii" && ImportAsciiPly(sceneconst,elements,mapping->GetData(),mapping->GetSize(),dataOffset,threadCount))
+			{
+				notifier.Finish(sceneconst);
+				return true;
+			}
+			sceneconst=t_model();
+		}
+		mapping.reset();
 		p_ply plyFile=ply_open(mfilename.c_str(),NULL, 0, NULL);
 		if(!plyFile)
 			return false;
 		CloseHandle plyCloseObj(plyFile);
 		if (!ply_read_header(plyFile))
 			return false;
+		//Reserve the arrays from the element counts
+		for(p_ply_element element=ply_get_next_element(plyFile,NULL);element;element=ply_get_next_element(plyFile,element))
+		{
+			const char* elementName;
+			long instanceCount;
+			if(!ply_get_element_info(element,&elementName,&instanceCount) || instanceCount<0)
+				continue;
+			if(strcmp(elementName,"vertex")==0)
+				sceneconst.modelVertices.reserve(instanceCount);
+			else if(strcmp(elementName,"face")==0)
+			{
+				notifier.SetFaceRowCount(instanceCount);
+				sceneconst.modelFaces.reserve(instanceCount);
+				sceneconst.modelFacesLayerIndex.reserve(instanceCount);
+			}else if(strcmp(elementName,"layer")==0)
+				sceneconst.modelLayers.reserve(instanceCount);
+		}
 
 		//setup_callbacks(plyFile);
 		parsing_instance curInstance(sceneconst);
@@ -166,7 +712,7 @@ namespace formatRPLY
 		ply_set_read_cb(plyFile, "layer", "layer_name", &layer_cb, &curInstance, 0);
 
 		if (!ply_read(plyFile)) return false;
-
+		notifier.Finish(sceneconst);
 
 		return true;
 	}
@@ -198,18 +744,18 @@ namespace formatRPLY
 			ply_add_list_property(oply,"layer_name",PLY_UCHAR, PLY_UCHAR );
 		}
 		ply_write_header(oply);
-        for(std::list<dvec3>::iterator itvert=scene.modelVertices.begin();itvert!=scene.modelVertices.end();itvert++)
+        for(std::vector<dvec3>::iterator itvert=scene.modelVertices.begin();itvert!=scene.modelVertices.end();itvert++)
 		{
 			ply_write(oply,itvert->x);
 			ply_write(oply,itvert->y);
 			ply_write(oply,itvert->z);
 		}
-		std::list<std::size_t>::iterator itLayerIndex;
+		std::vector<std::size_t>::iterator itLayerIndex;
 		if(useLayers)
 		{
 			itLayerIndex=scene.modelFacesLayerIndex.begin();
 		}
-		for(std::list<t_face>::iterator itface=scene.modelFaces.begin();itface!=scene.modelFaces.end();itface++)
+		for(std::vector<t_face>::iterator itface=scene.modelFaces.begin();itface!=scene.modelFaces.end();itface++)
 		{
 			ply_write(oply,3);
 			ply_write(oply,itface->indicesSommets.a);
@@ -221,7 +767,7 @@ namespace formatRPLY
 				itLayerIndex++;
 			}
 		}
-		for(std::list<t_layer>::iterator itLayer=scene.modelLayers.begin();itLayer!=scene.modelLayers.end();itLayer++)
+		for(std::vector<t_layer>::iterator itLayer=scene.modelLayers.begin();itLayer!=scene.modelLayers.end();itLayer++)
 		{
 			const char* layerString=(*itLayer).layerName.c_str();
 			std::size_t stringSize((*itLayer).layerName.size());
@@ -34,8 +34,8 @@
 	@see
 */
 #include <Core/mathlib.h>
-#include <list>
 #include <string>
+#include <vector>
 
 
 #ifndef _HRPLY
@@ -72,10 +72,28 @@ namespace formatRPLY
 	 */
 	struct t_model
 	{
-		std::list<t_face> modelFaces;
-        std::list<dvec3> modelVertices;
-		std::list<t_layer> modelLayers;				 /*!< Liste des calques */
-		std::list<std::size_t> modelFacesLayerIndex; /*!< Correspondance Indice de Face->Indice de calque*/
+		std::vector<t_face> modelFaces;
+        std::vector<dvec3> modelVertices;
+		std::vector<t_layer> modelLayers;				 /*!< Liste des calques */
+		std::vector<std::size_t> modelFacesLayerIndex; /*!< Correspondance Indice de Face->Indice de calque*/
+	};
+
+	/**
+	 * Receive the model while it is imported, on the thread of the import
+	 */
+	class t_import_listener
+	{
+	public:
+		virtual ~t_import_listener() {}
+		/**
+		 * All the vertices are read, called once before the faces
+		 * @param faceRowCount Count of faces in the header, the split quads give more triangles
+		 */
+		virtual void VerticesRead(const t_model& model,std::size_t faceRowCount)=0;
+		/**
+		 * The faces [faceBegin,faceEnd) and their layer index are read. The faces are given in order, by batches.
+		 */
+		virtual void FacesRead(const t_model& model,std::size_t faceBegin,std::size_t faceEnd)=0;
 	};
 
 /**
@@ -87,8 +105,13 @@ class CPly
 public:
 	/**
 	 * Méthode d'importation d'un modèle 3D
+	 * The arrays are reserved from the element counts of the header. The binary little endian files are
+	 * mapped in memory and decoded without rply, other files are read by rply.
+	 * @param listener Optional, receives the faces of the binary little endian files while they are read, the faces
+	 * of the other files once read. It may receive faces of a file that can not be imported entirely.
+	 * @param threadCount Threads that parse the ascii files, 0 to use all hardware threads
 	 */
-	static bool ImportPly(t_model& sceneconst, std::string mfilename);
+	static bool ImportPly(t_model& sceneconst, std::string mfilename, t_import_listener* listener=NULL, unsigned int threadCount=0);
 	/**
 	 * Méthode d'exportation d'un modèle 3D
 	 */
@@ -0,0 +1,122 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "stl_interface.hpp"
+#include <tools/ascii_number.hpp>
+#include <tools/file_mapping.hpp>
+#include <tools/parallel_for.hpp>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+namespace formatSTL
+{
+	static const std::size_t headerSize(84); /*!< 80 bytes of text and the triangle count */
+	static const std::size_t recordSize(50); /*!< Normal, 3 vertices and the attribute byte count */
+
+	static unsigned int ReadLittleEndianUInt(const char* data)
+	{
+		const unsigned char* bytes((const unsigned char*)data);
+		return (unsigned int)bytes[0] | ((unsigned int)bytes[1]<<8) | ((unsigned int)bytes[2]<<16) | ((unsigned int)bytes[3]<<24);
+	}
+
+	static float ReadLittleEndianFloat(const char* data)
+	{
+		const unsigned int bits(ReadLittleEndianUInt(data));
+		float value;
+		memcpy(&value,&bits,sizeof(float));
+		return value;
+	}
+
+	static bool ImportBinaryStl(t_model& model,const char* data,std::size_t triangleCount,unsigned int threadCount)
+	{
+		model.modelVertices.resize(triangleCount*3);
+		model.modelFaces.resize(triangleCount*3);
+		const std::size_t chunkSize(1<<16);
+		parallel_tools::ParallelFor(parallel_tools::ResolveThreadCount(threadCount,triangleCount/chunkSize+1),0,triangleCount,[&](std::size_t begin,std::size_t end,unsigned int)
+		{
+			for(std::size_t idTri=begin;idTri<end;idTri++)
+			{
+				const char* record(data+headerSize+idTri*recordSize+12); //The normal is computed by the fields
+				for(std::size_t idVert=0;idVert<3;idVert++)
+				{
+					dvec3& vertex(model.modelVertices[idTri*3+idVert]);
+					for(int axis=0;axis<3;axis++)
+						vertex[axis]=ReadLittleEndianFloat(record+(idVert*3+axis)*4);
+					model.modelFaces[idTri*3+idVert]=(unsigned int)(idTri*3+idVert);
+				}
+			}
+		});
+		return true;
+	}
+
+	static bool ImportAsciiStl(t_model& model,const char* data,std::size_t size)
+	{
+		const char* dataEnd(data+size);
+		for(const char* lineBegin=data;lineBegin<dataEnd;)
+		{
+			const char* lineEnd((const char*)memchr(lineBegin,'\n',dataEnd-lineBegin));
+			if(!lineEnd)
+				lineEnd=dataEnd;
+			const char* cursor(lineBegin);
+			lineBegin=lineEnd+1;
+			while(cursor<lineEnd && (*cursor==' ' || *cursor=='\t'))
+				cursor++;
+			if(lineEnd-cursor<7 || strncmp(cursor,"vertex",6)!=0 || (cursor[6]!=' ' && cursor[6]!='\t'))
+				continue;
+			cursor+=6;
+			dvec3 vertex;
+			for(int axis=0;axis<3;axis++)
+			{
+				if(!file_tools::ParseAsciiNumber(cursor,lineEnd,vertex[axis]))
+					return false;
+			}
+			model.modelFaces.push_back((unsigned int)model.modelVertices.size());
+			model.modelVertices.push_back(vertex);
+		}
+		return model.modelVertices.size()%3==0;
+	}
+
+	bool CStl::ImportStl(t_model& model, const std::string& filename, unsigned int threadCount)
+	{
+		model.modelVertices.clear();
+		model.modelFaces.clear();
+		std::unique_ptr<file_tools::FileMapping> mapping;
+		try
+		{
+			mapping.reset(new file_tools::FileMapping(filename));
+		} catch(std::runtime_error&)
+		{
+			return false;
+		}
+		const char* data(mapping->GetData());
+		const std::size_t size(mapping->GetSize());
+		if(size>=headerSize)
+		{
+			const std::size_t triangleCount(ReadLittleEndianUInt(data+80));
+			if((size-headerSize)/recordSize==triangleCount && (size-headerSize)%recordSize==0)
+				return ImportBinaryStl(model,data,triangleCount,threadCount);
+		}
+		//Binary files may also begin with solid, they are recognized by their size first
+		if(size>=5 && strncmp(data,"solid",5)==0)
+			return ImportAsciiStl(model,data,size);
+		return false;
+	}
+}
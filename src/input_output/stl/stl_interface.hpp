@@ -0,0 +1,52 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include <Core/mathlib.h>
+#include <string>
+#include <vector>
+
+#ifndef __STL_INTERFACE__
+#define __STL_INTERFACE__
+
+namespace formatSTL
+{
+	/**
+	 * Triangles of a STL file. The vertices are not shared, each triangle has its own 3 vertices.
+	 */
+	struct t_model
+	{
+		std::vector<dvec3> modelVertices;
+		std::vector<unsigned int> modelFaces; /*!< 3 vertex indices per triangle */
+	};
+
+	class CStl
+	{
+	public:
+		/**
+		 * Import a binary or ascii STL file. The binary files are memory mapped and their 50 bytes records are decoded in parallel.
+		 * A file is binary if its size match the triangle count of its header, the other files must begin with "solid".
+		 * @param threadCount Threads that decode the binary records, 0 to use all hardware threads
+		 * @return False if the file can not be opened or is not a valid STL file
+		 */
+		static bool ImportStl(t_model& model, const std::string& filename, unsigned int threadCount=0);
+	};
+}
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "load_job.hpp"
+
+namespace ScalarFieldBuilders
+{
+	JobProgress::JobProgress()
+		:progress(0.f),canceled(false)
+	{
+	}
+	void JobProgress::SetProgress(const float& _progress)
+	{
+		progress=_progress;
+	}
+	float JobProgress::GetProgress() const
+	{
+		return progress;
+	}
+	void JobProgress::Cancel()
+	{
+		canceled=true;
+	}
+	bool JobProgress::IsCanceled() const
+	{
+		return canceled;
+	}
+	void JobProgress::CheckCanceled() const
+	{
+		if(canceled)
+			throw JobCanceled();
+	}
+
+	LoadJob::LoadJob(const std::string& _path,const decimal& resolution)
+		:path(_path),field(new TriangleScalarFieldCreator(resolution)),done(false)
+	{
+		field->SetJobProgress(&jobProgress);
+		worker=std::thread(&LoadJob::Run,this);
+	}
+	LoadJob::~LoadJob()
+	{
+		Cancel();
+		if(worker.joinable())
+			worker.join();
+	}
+	void LoadJob::Run()
+	{
+		try
+		{
+			if(!field->LoadPlyModel(path))
+				throw std::runtime_error("Can not load the model "+path);
+			jobProgress.SetProgress(1.f);
+		} catch(...)
+		{
+			error=std::current_exception();
+		}
+		done=true;
+	}
+	float LoadJob::GetProgress() const
+	{
+		return jobProgress.GetProgress();
+	}
+	void LoadJob::Cancel()
+	{
+		jobProgress.Cancel();
+	}
+	bool LoadJob::IsDone() const
+	{
+		return done;
+	}
+	TriangleScalarFieldCreator* LoadJob::TakeResult()
+	{
+		std::lock_guard<std::mutex> lock(resultMutex);
+		if(worker.joinable())
+			worker.join();
+		if(error)
+			std::rethrow_exception(error);
+		if(!field)
+			throw std::runtime_error("The result of the job has already been taken");
+		field->SetJobProgress(NULL);
+		return field.release();
+	}
+}
@@ -0,0 +1,112 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "triangle_feeder.hpp"
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#ifndef __LOAD_JOB__
+#define __LOAD_JOB__
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * Thrown by a field operation when its job has been canceled
+	 */
+	class JobCanceled : public std::runtime_error
+	{
+	public:
+		JobCanceled() : std::runtime_error("The job has been canceled") { }
+	};
+
+	/**
+	 * Progress and cancel request of a job, shared between the thread of the job and the other threads
+	 */
+	class JobProgress
+	{
+	public:
+		JobProgress();
+		/**
+		 * @param progress Fraction of the job done [0-1]
+		 */
+		void SetProgress(const float& progress);
+		float GetProgress() const;
+		void Cancel();
+		bool IsCanceled() const;
+		/**
+		 * Throw JobCanceled if the job has been canceled
+		 */
+		void CheckCanceled() const;
+	private:
+		std::atomic<float> progress;
+		std::atomic<bool> canceled;
+	};
+
+	/**
+	 * Load and label a PLY model on its own native thread. The calling thread only polls or waits the job.
+	 * The job is canceled and waited for by the destructor.
+	 */
+	class LoadJob
+	{
+	public:
+		/**
+		 * Start the job
+		 * @param path PLY file
+		 * @param resolution Cell size of the field
+		 */
+		LoadJob(const std::string& path,const decimal& resolution);
+		~LoadJob();
+		/**
+		 * @return Fraction of the job done [0-1]
+		 */
+		float GetProgress() const;
+		/**
+		 * Ask the job to stop. The cancel is seen between the steps of the load and while feeding the triangles.
+		 */
+		void Cancel();
+		bool IsDone() const;
+		/**
+		 * Wait for the end of the job and give the loaded field to the caller. Concurrent calls wait for the same job,
+		 * only the first one gets the field.
+		 * Throw JobCanceled if the job has been canceled, std::runtime_error if the model could not be loaded
+		 * or the field has already been taken. The error of the job is thrown again by every call.
+		 */
+		TriangleScalarFieldCreator* TakeResult();
+	private:
+		LoadJob(const LoadJob&);
+		LoadJob& operator=(const LoadJob&);
+		void Run();
+
+		std::string path;
+		std::unique_ptr<TriangleScalarFieldCreator> field;
+		JobProgress jobProgress;
+		std::exception_ptr error;
+		std::atomic<bool> done;
+		std::mutex resultMutex; //The worker is joined and the field released once
+		std::thread worker;
+	};
+}
+
+#endif
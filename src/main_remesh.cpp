@@ -28,8 +28,10 @@
 
 #include "triangle_feeder.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
-#include <input_output/ply/rply_interface.hpp>
+#include <list>
 #include <vector>
 #include <string>
 #include <string.h>
@@ -74,14 +76,23 @@ inline int Range(const int& from,const int& to)
 #endif
 void PrintUsage(int argc, char* argv[])
 {
-	std::cout<<"Usage: "<< argv[0] <<" [-precDECIMAL] [-depthINTEGER] [-v] [-volstatsFILENAME] [-ivINTEGER] -iFILENAME -oFILENAME"<<std::endl;
+	std::cout<<"Usage: "<< argv[0] <<" [-precDECIMAL] [-depthINTEGER] [-threadsINTEGER] [-minvolDECIMAL] [-mincellsINTEGER] [-parity] [-formatNAME] [-cacheDIRECTORY] [-cachesizeINTEGER] [-v] [-volstatsFILENAME] [-npyFILENAME] [-chunksDIRECTORY] [-ivINTEGER] -iFILENAME -oFILENAME"<<std::endl;
 	std::cout<<" -prec : Absolute cell size."<<std::endl;
 	std::cout<<" -depth : [5-10] Relative cell size, cell subdivision count will be 2^depth . Default 5."<<std::endl;
+	std::cout<<" -threads : Number of threads used to identify the volumes. Default 0, all hardware threads."<<std::endl;
+	std::cout<<" -minvol : Minimal volume (m^3). Smaller enclosed volumes are merged into the surface that surround them."<<std::endl;
+	std::cout<<" -mincells : Minimal cell count. Enclosed volumes with less cells are merged into the surface that surround them."<<std::endl;
+	std::cout<<" -parity : Solid voxelization by ray casting along Z, for watertight models. All the interior cells are in one volume."<<std::endl;
+	std::cout<<" -format : Output file format, ascii (legacy VTK, default), binary (legacy VTK), vti (XML ImageData) or vtiz (zlib compressed XML ImageData)."<<std::endl;
+	std::cout<<" -cache : Directory of the labeled models. A model already processed with the same parameters is read from it instead of being computed again."<<std::endl;
+	std::cout<<" -cachesize : Size cap of the cache directory in MB, the least recently used models are removed. 0 for no cap. Default 1024."<<std::endl;
 	std::cout<<" -v : Verbose mode. Give more details about remeshing."<<std::endl;
-	std::cout<<" -i : PLY input filename."<<std::endl;
+	std::cout<<" -i : Input filename, PLY, binary or ascii STL (.stl) or Wavefront OBJ (.obj) with usemtl materials as markers."<<std::endl;
 	std::cout<<" -t : Coordinate translation. For each line, translate x,y,z coordinates into the corresponding i,j,k and volume id."<<std::endl;
 	std::cout<<" -o : Output filename.Do not write extension. The format can be read by ParaView"<<std::endl;
-	std::cout<<" -iv : [0-Volume Count] Export specified volumes,materials into separate files. You can add this parameter multiple times.You can use the option -volstats to find volumes ID."<<std::endl;
+	std::cout<<" -iv : [0-Volume Count] Export specified volumes,materials into separate files, named after the output file followed by _ID (before the extension if there is one). You can add this parameter multiple times.You can use the option -volstats to find volumes ID."<<std::endl;
+	std::cout<<" -npy : Write the cell values of the whole domain in the specified NumPy .npy file."<<std::endl;
+	std::cout<<" -chunks : Write the cell values of the whole domain in the specified directory of compressed 64^3 chunks, with an index.json file."<<std::endl;
 	std::cout<<" -volstats : Discretise with prec or depth and write volumes statistics to specified file then stop execution."<<std::endl;
 	std::cout<<std::endl;
 }
@@ -92,7 +103,7 @@ void PrintUsage(int argc, char* argv[])
 struct VolumeSelectionInfo_t
 {
 	VolumeSelectionInfo_t()
-		:minimalVol(0.f),selectionFilter(FILTER_BY_VOLUME)
+		:selectionFilter(FILTER_BY_VOLUME),minimalVol(0.f),minimalCellCount(0)
 	{}
 	enum FILTER
 	{
@@ -102,6 +113,7 @@ struct VolumeSelectionInfo_t
 		FILTER_BY_ID
 	} selectionFilter;
 	decimal minimalVol;
+	unsigned int minimalCellCount;
 	std::list<SpatialDiscretization::cell_id_t> extractedVolumes;
 
 };
@@ -122,9 +134,16 @@ int MainRemesh(int argc, char* argv[])
 	std::string fileOutput;
 	std::string volStatsOutput;
 	std::string translationFileInput;
+	std::string npyOutput;
+	std::string chunksOutput;
 	unsigned int depth(0);     //Domain subdivision in 2^n in each dimension
 	unsigned int iv_buffer(0); //Extracted volume temporary variable
+	unsigned int threadCount(0); //0 to use all hardware threads
 	bool verbose(false);
+	bool parityMode(false);
+	std::string cacheDirectory;
+	unsigned int cacheSize(1024); //MB
+	ScalarFieldCreator::EXPORT_FORMAT exportFormat(ScalarFieldCreator::EXPORT_VTK_ASCII);
 	//Scan user arguments
 	try
 	{
@@ -135,6 +154,28 @@ int MainRemesh(int argc, char* argv[])
 			else if (sscanf_s(argv[argc], "-iv%u", &iv_buffer) == 1)
 				volumeSelectionInfo.extractedVolumes.push_back(iv_buffer);
 			else if (sscanf_s(argv[argc], "-minvol%g", &volumeSelectionInfo.minimalVol) == 1);
+			else if (sscanf_s(argv[argc], "-mincells%u", &volumeSelectionInfo.minimalCellCount) == 1);
+			else if (sscanf_s(argv[argc], "-threads%u", &threadCount) == 1);
+			else if (strcmp(argv[argc], "-parity") == 0) parityMode=true;
+			else if (sscanf_s(argv[argc], "-cachesize%u", &cacheSize) == 1);
+			else if (strncmp(argv[argc], "-cache", 6) == 0)
+			  cacheDirectory = std::string(argv[argc] + 6);
+			else if (strncmp(argv[argc], "-format", 7) == 0)
+			{
+				std::string formatName(argv[argc] + 7);
+				if(formatName == "ascii") exportFormat=ScalarFieldCreator::EXPORT_VTK_ASCII;
+				else if(formatName == "binary") exportFormat=ScalarFieldCreator::EXPORT_VTK_BINARY;
+				else if(formatName == "vti") exportFormat=ScalarFieldCreator::EXPORT_VTI;
+				else if(formatName == "vtiz") exportFormat=ScalarFieldCreator::EXPORT_VTI_ZLIB;
+				else {
+				  PrintUsage(argc,argv);
+				  return -2;
+				}
+			}
+			else if (strncmp(argv[argc], "-chunks", 7) == 0)
+			  chunksOutput = std::string(argv[argc] + 7);
+			else if (strncmp(argv[argc], "-npy", 4) == 0)
+			  npyOutput = std::string(argv[argc] + 4);
 			else if (strncmp(argv[argc], "-volstats", 9) == 0)
 			  volStatsOutput = std::string(argv[argc] + 9);
 			else if (strncmp(argv[argc], "-v", 2) == 0) verbose=true;
@@ -155,7 +196,7 @@ int MainRemesh(int argc, char* argv[])
 	  return -2;
 	}
 	//Incomplete arguments
-	if(fileInput.empty() || (fileOutput.empty() && (volStatsOutput.empty() && translationFileInput.empty())))
+	if(fileInput.empty() || (fileOutput.empty() && (volStatsOutput.empty() && translationFileInput.empty() && npyOutput.empty() && chunksOutput.empty())))
 	{
 	  PrintUsage(argc,argv);
 	  return -2;
@@ -165,29 +206,27 @@ int MainRemesh(int argc, char* argv[])
 
 	//Init the bounding box of the model
 	std::cout<<"Open "<< fileInput<<std::endl;
-	formatRPLY::t_model model3D;
-	if(!formatRPLY::CPly::ImportPly(model3D,fileInput) || model3D.modelVertices.size()==0)
-		return -2;
-
-	minBoundingBox=(*model3D.modelVertices.begin());
-    maxBoundingBox=(*model3D.modelVertices.begin());
-    std::vector<dvec3> vertices_vec;
-	vertices_vec.reserve(model3D.modelVertices.size());
-    for(std::list<dvec3>::iterator itvert=model3D.modelVertices.begin();itvert!=model3D.modelVertices.end();itvert++)
+	if(precision==0 && d==0)
+		d=5;
+	//The cell size does not depend on the model and there is no cache key to compute: the PLY triangles are fed while the file is read
+	std::string inputExtension(fileInput.size()>=4 ? fileInput.substr(fileInput.size()-4) : std::string());
+	std::transform(inputExtension.begin(),inputExtension.end(),inputExtension.begin(),::tolower);
+	const bool streamedLoad(d==0 && cacheDirectory.empty() && inputExtension!=".stl" && inputExtension!=".obj");
+	ScalarFieldBuilders::Mesh mesh;
+	mesh.SetThreadCount(threadCount);
+	if(!streamedLoad)
 	{
-		MAXVEC(maxBoundingBox,(*itvert));
-		MINVEC(minBoundingBox,(*itvert));
-		vertices_vec.push_back(*itvert);
-	}
-	model3D.modelVertices.clear();
+		if(!mesh.Load(fileInput))
+			return -2;
+		minBoundingBox=mesh.GetBoxMin();
+		maxBoundingBox=mesh.GetBoxMax();
 
-    if(verbose) {
-        std::cout<<"Model bouding box ["<< minBoundingBox.x << ","<< minBoundingBox.y<<","<< minBoundingBox.z<<"] to ["<< maxBoundingBox.x << ","<< maxBoundingBox.y<<","<< maxBoundingBox.z<<"]" <<  std::endl;
-    }
+		if(verbose) {
+			std::cout<<"Model bouding box ["<< minBoundingBox.x << ","<< minBoundingBox.y<<","<< minBoundingBox.z<<"] to ["<< maxBoundingBox.x << ","<< maxBoundingBox.y<<","<< maxBoundingBox.z<<"]" <<  std::endl;
+		}
+	}
 
     //init the cell size, corresponding to specified arguments and bounding box
-	if(precision==0 && d==0)
-		d=5;
 	if(d!=0)
 	{
         dvec3 axesPrecision=(maxBoundingBox-minBoundingBox)/dvec3(pow(2,(double_t)d), pow(2.0 ,(double_t)d), pow(2.0 ,(double_t)d));
@@ -196,58 +235,84 @@ int MainRemesh(int argc, char* argv[])
 	std::cout<<"Discretization of space with a "<<precision<<" m cell width"<<std::endl;
 
 	ScalarFieldBuilders::TriangleScalarFieldCreator FromTriangleRemesh(precision);
-	FromTriangleRemesh.FirstStep_Params(minBoundingBox,maxBoundingBox);
+	FromTriangleRemesh.SetThreadCount(threadCount);
+	FromTriangleRemesh.SetMinimalVolume(volumeSelectionInfo.minimalVol);
+	FromTriangleRemesh.SetMinimalCellCount(volumeSelectionInfo.minimalCellCount);
+	FromTriangleRemesh.SetParityMode(parityMode);
+	std::string cacheKey;
+	bool labeled(false);
+	if(streamedLoad)
+	{
+		std::cout<<"Feeding matrix "<<std::endl;
+		if(!FromTriangleRemesh.LoadPlyModel(fileInput))
+			return -2;
+		labeled=true;
+	}else if(!cacheDirectory.empty())
+	{
+		FromTriangleRemesh.SetCache(cacheDirectory,(unsigned long long)cacheSize*1024*1024);
+		cacheKey=FromTriangleRemesh.GetCacheKey(mesh);
+		labeled=FromTriangleRemesh.FetchCachedField(cacheKey);
+		if(labeled)
+			std::cout<<"Labeled model read from the cache "<<cacheDirectory<<std::endl;
+	}
+	if(!labeled)
+	{
+		FromTriangleRemesh.FirstStep_Params(minBoundingBox,maxBoundingBox);
 
-	std::size_t domainSize(FromTriangleRemesh.GetDomainSize());
-	if(verbose)
-		std::cout<<"Matrix size "<<domainSize<<"x"<<domainSize<<"x"<<domainSize<<" = "<<pow((decimal)domainSize,3)<<" cells max("<<pow((decimal)domainSize,2)<<"min)"<<std::endl;
+		std::size_t domainSize(FromTriangleRemesh.GetDomainSize());
+		if(verbose)
+			std::cout<<"Matrix size "<<domainSize<<"x"<<domainSize<<"x"<<domainSize<<" = "<<pow((decimal)domainSize,3)<<" cells max("<<pow((decimal)domainSize,2)<<"min)"<<std::endl;
 
 
-	/////////////////////////////////////////////////////////////
-	//Voxelisation of surfaces
+		/////////////////////////////////////////////////////////////
+		//Voxelisation of surfaces
 
-	unsigned int idtri(0);
-	std::size_t triCount(model3D.modelFaces.size());
-	int lastprogression(0),progression(0);
-	std::cout<<"Feeding matrix "<<std::endl;
-	std::list<std::size_t>::iterator itlayerindex=model3D.modelFacesLayerIndex.begin();
-	for(std::list<formatRPLY::t_face>::iterator itface=model3D.modelFaces.begin();itface!=model3D.modelFaces.end();itface++)
-	{
-	    std::size_t layerIndex=1;
-	    //Iteration
-	    if(itlayerindex!=model3D.modelFacesLayerIndex.end())
+		unsigned int idtri(0);
+		std::size_t triCount(mesh.GetFaceCount());
+		int lastprogression(0),progression(0);
+		std::cout<<"Feeding matrix "<<std::endl;
+		const std::vector<dvec3>& vertices(mesh.GetVertices());
+		const std::vector<unsigned int>& faces(mesh.GetFaces());
+		const std::vector<SpatialDiscretization::weight_t>& markers(mesh.GetMarkers());
+		for(std::size_t idFace=0;idFace<triCount;idFace++)
 		{
-            layerIndex=*itlayerindex;
-			itlayerindex++;
+			//Add tri in voxel
+			FromTriangleRemesh.SecondStep_PushTri(vertices[faces[idFace*3]],
+				vertices[faces[idFace*3+1]],
+				vertices[faces[idFace*3+2]],
+				markers[idFace]);
+			if(verbose)
+			{
+				idtri++;
+				progression=int(((float)idtri/(float)triCount)*100);
+				if(progression!=lastprogression)
+				{
+					std::cout<<"Feeding matrix "<<progression<<"% face"<<idtri<<"/"<<triCount<<std::endl;
+					lastprogression=progression;
+				}
+			}
 		}
-		//Add tri in voxel
-		FromTriangleRemesh.SecondStep_PushTri(vertices_vec[(*itface).indicesSommets.a],
-			vertices_vec[(*itface).indicesSommets.b],
-			vertices_vec[(*itface).indicesSommets.c],
-			layerIndex);
 		if(verbose)
 		{
-			idtri++;
-			progression=int(((float)idtri/(float)triCount)*100);
-			if(progression!=lastprogression)
-			{
-				std::cout<<"Feeding matrix "<<progression<<"% face"<<idtri<<"/"<<triCount<<std::endl;
-				lastprogression=progression;
-			}
+			std::cout<<"Finish feeding matrix with intersection nodes"<<std::endl;
+			std::cout<<"There are "<<FromTriangleRemesh.count()<<" cells in the matrix"<<std::endl;
 		}
-	}
-	if(verbose)
-	{
-		std::cout<<"Finish feeding matrix with intersection nodes"<<std::endl;
-		std::cout<<"There are "<<FromTriangleRemesh.count()<<" cells in the matrix"<<std::endl;
-	}
 
 
-	/////////////////////////////////////////////////////////////
-	//Init empty cells with unique volumetric information, starting with the higher material integer + 1
+		/////////////////////////////////////////////////////////////
+		//Init empty cells with unique volumetric information, starting with the higher material integer + 1
 
 
-	FromTriangleRemesh.ThirdStep_VolumesCreator();
+		if(parityMode)
+			FromTriangleRemesh.ThirdStep_ParityVolumesCreator();
+		else
+			FromTriangleRemesh.ThirdStep_VolumesCreator();
+		FromTriangleRemesh.StoreCachedField(cacheKey);
+	}
+	if(parityMode && FromTriangleRemesh.GetParityFallbackColumnCount()>0)
+		std::cout<<FromTriangleRemesh.GetParityFallbackColumnCount()<<" columns with inconsistent crossings labeled by propagation"<<std::endl;
+	if(FromTriangleRemesh.GetMergedVolumeCount()>0)
+		std::cout<<FromTriangleRemesh.GetMergedVolumeCount()<<" small volumes merged into the surrounding surfaces"<<std::endl;
 	if(verbose)
 	{
 		std::cout<<"Volumes defined :"<<std::endl;
@@ -268,6 +333,13 @@ int MainRemesh(int argc, char* argv[])
 	{
 		FromTriangleRemesh.ExportIJKData(translationFileInput,translationFileInput+".vol");
 	}
+	if(!npyOutput.empty())
+	{
+		int domainSize((int)FromTriangleRemesh.GetDomainSize());
+		FromTriangleRemesh.ExportNpy(npyOutput,ivec3(0,0,0),ivec3(domainSize,domainSize,domainSize));
+	}
+	if(!chunksOutput.empty())
+		FromTriangleRemesh.ExportChunks(chunksOutput);
 	if(!(volStatsOutput.empty()))
 	{
 		FromTriangleRemesh.ExportVolsStats(volStatsOutput);
@@ -281,17 +353,12 @@ int MainRemesh(int argc, char* argv[])
 			//No selection done
 			//Export the main volumes
 
-			FromTriangleRemesh.ExportVTK(fileOutput);
+			FromTriangleRemesh.ExportVTK(fileOutput,-1,exportFormat);
 		}else{
-			std::size_t volumeCountToProcess(volumeSelectionInfo.extractedVolumes.size());
+			std::vector<SpatialDiscretization::weight_t> volumeIds(volumeSelectionInfo.extractedVolumes.begin(),volumeSelectionInfo.extractedVolumes.end());
 
-			std::cout<<"There are "<<volumeCountToProcess<<" volumes to export.."<<std::endl;
-			for(std::list<SpatialDiscretization::cell_id_t>::iterator itvol=volumeSelectionInfo.extractedVolumes.begin();itvol!=volumeSelectionInfo.extractedVolumes.end();itvol++)
-			{
-				SpatialDiscretization::weight_t i(*itvol);
-				std::cout<<"Export Volume "<<i<<std::endl;
-				FromTriangleRemesh.ExportVTK(fileOutput,(SpatialDiscretization::weight_t)i);
-			}
+			std::cout<<"There are "<<volumeIds.size()<<" volumes to export.."<<std::endl;
+			FromTriangleRemesh.ExportVolumesVTK(fileOutput,volumeIds,exportFormat);
 		}
 	}
 	return 0;
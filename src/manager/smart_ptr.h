@@ -6,6 +6,8 @@
 #ifndef __SMART_PTR_H__
 #define __SMART_PTR_H__
 
+#include <atomic>
+
 /**
  *
  *  \brief Classe de gestion de pointeur
@@ -41,7 +43,7 @@ public:
 private:
 	void _Release();
 
-    int* _RefCounter;
+    std::atomic<int>* _RefCounter; //Atomic, copies of the same pointer can be made and released by several threads
     T* _Pointer;
 };
 
@@ -72,7 +74,7 @@ public:
 private:
 	void _Release();
 
-    int* _RefCounter;
+    std::atomic<int>* _RefCounter; //Atomic, copies of the same pointer can be made and released by several threads
     T* _Pointer;
 };
 #include "smart_ptr.inl"
@@ -19,7 +19,7 @@ template <typename T>
 smart_ptr<T>::smart_ptr(T* Pointer) :
 	_Pointer(Pointer)
 {
-	_RefCounter = new int(1);
+	_RefCounter = new std::atomic<int>(1);
 }
 
 template <typename T>
@@ -49,7 +49,7 @@ smart_ptr<T>& smart_ptr<T>::operator=(T* Pointer)
 	_Release();
 
 	_Pointer = Pointer;
-	_RefCounter = new int(1);
+	_RefCounter = new std::atomic<int>(1);
 
 	return *this;
 }
@@ -99,8 +99,7 @@ void smart_ptr<T>::_Release()
 {
 	if(_RefCounter != 0)
 	{
-		(*_RefCounter)--;
-		if(*_RefCounter <= 0)
+		if(--(*_RefCounter) <= 0)
 		{
 			delete _RefCounter;
 			if(_Pointer != 0)
@@ -132,7 +131,7 @@ template <typename T>
 smart_ptr_ar<T>::smart_ptr_ar(T* Pointer) :
 	_Pointer(Pointer)
 {
-	_RefCounter = new int(1);
+	_RefCounter = new std::atomic<int>(1);
 }
 
 template <typename T>
@@ -168,7 +167,7 @@ smart_ptr_ar<T>& smart_ptr_ar<T>::operator=(T* Pointer)
 	_Release();
 
 	_Pointer = Pointer;
-	_RefCounter = new int(1);
+	_RefCounter = new std::atomic<int>(1);
 
 	return *this;
 }
@@ -218,8 +217,7 @@ void smart_ptr_ar<T>::_Release()
 {
 	if(_RefCounter != 0)
 	{
-		(*_RefCounter)--;
-		if(*_RefCounter <= 0)
+		if(--(*_RefCounter) <= 0)
 		{
 			delete _RefCounter;
 			if(_Pointer != 0)
@@ -0,0 +1,293 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "mesh.hpp"
+#include <input_output/ply/rply_interface.hpp>
+#include <input_output/stl/stl_interface.hpp>
+#include <input_output/obj/obj_interface.hpp>
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#ifndef MIN
+	#define MIN(a, b)  (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+	#define MAX(a, b)  (((a) > (b)) ? (a) : (b))
+#endif
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * Spread the 21 lowest bits of the value on every third bit
+	 */
+	static unsigned long long SpreadMortonBits(unsigned long long value)
+	{
+		value&=0x1fffffULL;
+		value=(value|(value<<32))&0x1f00000000ffffULL;
+		value=(value|(value<<16))&0x1f0000ff0000ffULL;
+		value=(value|(value<<8))&0x100f00f00f00f00fULL;
+		value=(value|(value<<4))&0x10c30c30c30c30c3ULL;
+		value=(value|(value<<2))&0x1249249249249249ULL;
+		return value;
+	}
+
+	Mesh::Mesh()
+		:threadCount(0)
+	{
+	}
+	void Mesh::SetThreadCount(const unsigned int& _threadCount)
+	{
+		this->threadCount=_threadCount;
+	}
+	bool Mesh::LoadPly(const std::string& path)
+	{
+		formatRPLY::t_model model3D;
+		if(!formatRPLY::CPly::ImportPly(model3D,path,NULL,threadCount) || model3D.modelVertices.empty())
+			return false;
+		std::vector<dvec3> plyVertices;
+		plyVertices.swap(model3D.modelVertices);
+		std::vector<unsigned int> plyFaces;
+		plyFaces.reserve(model3D.modelFaces.size()*3);
+		for(std::vector<formatRPLY::t_face>::const_iterator itface=model3D.modelFaces.begin();itface!=model3D.modelFaces.end();itface++)
+		{
+			for(int idVert=0;idVert<3;idVert++)
+			{
+				const long vertexIndex(itface->indicesSommets.i[idVert]);
+				if(vertexIndex<0 || (std::size_t)vertexIndex>=plyVertices.size())
+					return false;
+				plyFaces.push_back((unsigned int)vertexIndex);
+			}
+		}
+		//The faces after the last layer index have the default marker
+		std::vector<SpatialDiscretization::weight_t> plyMarkers(model3D.modelFaces.size(),1);
+		for(std::size_t idFace=0;idFace<plyMarkers.size() && idFace<model3D.modelFacesLayerIndex.size();idFace++)
+			plyMarkers[idFace]=(SpatialDiscretization::weight_t)model3D.modelFacesLayerIndex[idFace];
+		std::vector<std::string> plyMarkerNames;
+		for(std::vector<formatRPLY::t_layer>::const_iterator itlayer=model3D.modelLayers.begin();itlayer!=model3D.modelLayers.end();itlayer++)
+			plyMarkerNames.push_back(itlayer->layerName);
+		vertices.swap(plyVertices);
+		faces.swap(plyFaces);
+		markers.swap(plyMarkers);
+		markerNames.swap(plyMarkerNames);
+		Update();
+		return true;
+	}
+	bool Mesh::LoadStl(const std::string& path)
+	{
+		formatSTL::t_model model;
+		if(!formatSTL::CStl::ImportStl(model,path,threadCount) || model.modelFaces.empty())
+			return false;
+		vertices.swap(model.modelVertices);
+		faces.swap(model.modelFaces);
+		markers.assign(faces.size()/3,1);
+		markerNames.clear();
+		Update();
+		return true;
+	}
+	bool Mesh::LoadObj(const std::string& path)
+	{
+		formatOBJ::t_model model;
+		if(!formatOBJ::CObj::ImportObj(model,path) || model.modelVertices.empty())
+			return false;
+		std::vector<SpatialDiscretization::weight_t> objMarkers(model.modelFaces.size()/3,1);
+		if(model.modelMaterials.size()>SHRT_MAX+1u)
+			return false;
+		for(std::size_t idFace=0;idFace<model.modelFacesMaterialIndex.size();idFace++)
+			objMarkers[idFace]=(SpatialDiscretization::weight_t)model.modelFacesMaterialIndex[idFace];
+		vertices.swap(model.modelVertices);
+		faces.swap(model.modelFaces);
+		markers.swap(objMarkers);
+		markerNames.swap(model.modelMaterials);
+		Update();
+		return true;
+	}
+	bool Mesh::Load(const std::string& path)
+	{
+		std::string extension(path.size()>=4 ? path.substr(path.size()-4) : std::string());
+		std::transform(extension.begin(),extension.end(),extension.begin(),::tolower);
+		if(extension==".stl")
+			return LoadStl(path);
+		if(extension==".obj")
+			return LoadObj(path);
+		return LoadPly(path);
+	}
+	void Mesh::SetArrays(const double* _vertices,int vertexCount,int vertexDim,const int* _faces,int faceCount,int faceDim)
+	{
+		if(vertexDim!=3 || faceDim!=3)
+			throw std::invalid_argument("The vertices and faces arrays must have 3 columns");
+		for(std::size_t idIndex=0;idIndex<(std::size_t)faceCount*3;idIndex++)
+		{
+			if(_faces[idIndex]<0 || _faces[idIndex]>=vertexCount)
+				throw std::out_of_range("A face refers to a missing vertex");
+		}
+		vertices.resize(vertexCount);
+		for(int idVert=0;idVert<vertexCount;idVert++)
+			vertices[idVert]=dvec3(_vertices[idVert*3],_vertices[idVert*3+1],_vertices[idVert*3+2]);
+		faces.assign(_faces,_faces+(std::size_t)faceCount*3);
+		markers.assign(faceCount,1);
+		markerNames.clear();
+		Update();
+	}
+	void Mesh::SetMarkers(const SpatialDiscretization::weight_t* _markers,int markerCount)
+	{
+		if((std::size_t)markerCount!=GetFaceCount())
+			throw std::invalid_argument("There must be one marker per face");
+		markers.assign(_markers,_markers+markerCount);
+	}
+	void Mesh::Update()
+	{
+		boxMin=vertices.empty() ? dvec3() : vertices.front();
+		boxMax=boxMin;
+		for(std::vector<dvec3>::const_iterator itvert=vertices.begin();itvert!=vertices.end();itvert++)
+		{
+			boxMin.set(MIN(boxMin.x,itvert->x),MIN(boxMin.y,itvert->y),MIN(boxMin.z,itvert->z));
+			boxMax.set(MAX(boxMax.x,itvert->x),MAX(boxMax.y,itvert->y),MAX(boxMax.z,itvert->z));
+		}
+		faceBoxes.clear();
+		mortonOrder.clear();
+	}
+	std::size_t Mesh::GetVertexCount() const
+	{
+		return vertices.size();
+	}
+	std::size_t Mesh::GetFaceCount() const
+	{
+		return faces.size()/3;
+	}
+	const dvec3& Mesh::GetBoxMin() const
+	{
+		return boxMin;
+	}
+	const dvec3& Mesh::GetBoxMax() const
+	{
+		return boxMax;
+	}
+	const std::vector<dvec3>& Mesh::GetVertices() const
+	{
+		return vertices;
+	}
+	const std::vector<unsigned int>& Mesh::GetFaces() const
+	{
+		return faces;
+	}
+	const std::vector<SpatialDiscretization::weight_t>& Mesh::GetMarkers() const
+	{
+		return markers;
+	}
+	const std::vector<std::string>& Mesh::GetMarkerNames() const
+	{
+		return markerNames;
+	}
+	void Mesh::BuildFaceBoxes()
+	{
+		const std::size_t faceCount(GetFaceCount());
+		faceBoxes.resize(faceCount*2);
+		for(std::size_t idFace=0;idFace<faceCount;idFace++)
+		{
+			const dvec3& A(vertices[faces[idFace*3]]);
+			const dvec3& B(vertices[faces[idFace*3+1]]);
+			const dvec3& C(vertices[faces[idFace*3+2]]);
+			faceBoxes[idFace*2].set(MIN(MIN(A.x,B.x),C.x),MIN(MIN(A.y,B.y),C.y),MIN(MIN(A.z,B.z),C.z));
+			faceBoxes[idFace*2+1].set(MAX(MAX(A.x,B.x),C.x),MAX(MAX(A.y,B.y),C.y),MAX(MAX(A.z,B.z),C.z));
+		}
+	}
+	const std::vector<dvec3>& Mesh::GetFaceBoxes() const
+	{
+		return faceBoxes;
+	}
+	void Mesh::BuildMortonOrder()
+	{
+		const std::size_t faceCount(GetFaceCount());
+		const dvec3 extent(boxMax-boxMin);
+		const double maxExtent(MAX(MAX(extent.x,extent.y),MAX(extent.z,1e-12)));
+		const double scale(2097151./maxExtent); //21 bits per axis
+		std::vector<std::pair<unsigned long long,unsigned int> > faceCodes(faceCount);
+		for(std::size_t idFace=0;idFace<faceCount;idFace++)
+		{
+			const dvec3 centroid((vertices[faces[idFace*3]]+vertices[faces[idFace*3+1]]+vertices[faces[idFace*3+2]])/3.);
+			const dvec3 cell((centroid-boxMin)*scale);
+			faceCodes[idFace].first=SpreadMortonBits((unsigned long long)MAX(cell.x,0.))
+				|(SpreadMortonBits((unsigned long long)MAX(cell.y,0.))<<1)
+				|(SpreadMortonBits((unsigned long long)MAX(cell.z,0.))<<2);
+			faceCodes[idFace].second=(unsigned int)idFace;
+		}
+		//The face index breaks the ties, the order does not depend on the sort implementation
+		std::sort(faceCodes.begin(),faceCodes.end());
+		mortonOrder.resize(faceCount);
+		for(std::size_t idFace=0;idFace<faceCount;idFace++)
+			mortonOrder[idFace]=faceCodes[idFace].second;
+	}
+	void Mesh::ClearMortonOrder()
+	{
+		mortonOrder.clear();
+	}
+	const std::vector<unsigned int>& Mesh::GetMortonOrder() const
+	{
+		return mortonOrder;
+	}
+	void Mesh::CopyVertices(double* data,int vertexCount,int vertexDim) const
+	{
+		if((std::size_t)vertexCount!=vertices.size() || vertexDim!=3)
+			throw std::invalid_argument("The array must have one row of 3 coordinates per vertex");
+		for(std::size_t idVert=0;idVert<vertices.size();idVert++)
+		{
+			data[idVert*3]=vertices[idVert].x;
+			data[idVert*3+1]=vertices[idVert].y;
+			data[idVert*3+2]=vertices[idVert].z;
+		}
+	}
+	void Mesh::CopyFaces(int* data,int faceCount,int faceDim) const
+	{
+		if((std::size_t)faceCount!=GetFaceCount() || faceDim!=3)
+			throw std::invalid_argument("The array must have one row of 3 indices per face");
+		std::copy(faces.begin(),faces.end(),data);
+	}
+	void Mesh::CopyMarkers(SpatialDiscretization::weight_t* data,int markerCount) const
+	{
+		if((std::size_t)markerCount!=markers.size())
+			throw std::invalid_argument("The array must have one marker per face");
+		std::copy(markers.begin(),markers.end(),data);
+	}
+	void Mesh::CopyFaceBoxes(double* data,int faceCount,int boxDim) const
+	{
+		if(faceBoxes.empty())
+			throw std::runtime_error("The face boxes have not been built");
+		if((std::size_t)faceCount!=GetFaceCount() || boxDim!=6)
+			throw std::invalid_argument("The array must have one row of 6 coordinates per face");
+		for(std::size_t idBox=0;idBox<faceBoxes.size();idBox++)
+		{
+			data[idBox*3]=faceBoxes[idBox].x;
+			data[idBox*3+1]=faceBoxes[idBox].y;
+			data[idBox*3+2]=faceBoxes[idBox].z;
+		}
+	}
+	void Mesh::CopyMortonOrder(int* data,int faceCount) const
+	{
+		if(mortonOrder.empty() && GetFaceCount()>0)
+			throw std::runtime_error("The Morton order has not been built");
+		if((std::size_t)faceCount!=mortonOrder.size())
+			throw std::invalid_argument("The array must have one index per face");
+		std::copy(mortonOrder.begin(),mortonOrder.end(),data);
+	}
+}
@@ -0,0 +1,145 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include <Core/mathlib.h>
+#include "spatial_discretization.hpp"
+#include <string>
+#include <vector>
+
+#ifndef __MESH__
+#define __MESH__
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * Triangle mesh parsed once and voxelized any number of times, at any resolution.
+	 * The mesh is only read by the fields, several fields can voxelize the same mesh in parallel.
+	 */
+	class Mesh
+	{
+	public:
+		Mesh();
+		/**
+		 * Set the number of threads used to parse the files
+		 * @param _threadCount Thread count, 0 to use all hardware threads (default)
+		 */
+		void SetThreadCount(const unsigned int& _threadCount);
+		/**
+		 * Replace the mesh by the triangles of a PLY file, quads are split in two triangles.
+		 * The markers are the layer_id of the faces, 1 if the file does not have them.
+		 * @return False if the file can not be read, has no vertex or a face refers to a missing vertex
+		 */
+		bool LoadPly(const std::string& path);
+		/**
+		 * Replace the mesh by the triangles of a binary or ascii STL file, the markers are set to 1.
+		 * Each triangle has its own 3 vertices.
+		 * @return False if the file can not be read or has no triangle
+		 */
+		bool LoadStl(const std::string& path);
+		/**
+		 * Replace the mesh by the triangles of a Wavefront OBJ file, polygons are split in triangle fans.
+		 * The markers are the indices of the usemtl materials in order of first use, 1 if the file does not have usemtl.
+		 * @return False if the file can not be read, has no vertex, a face refers to a missing vertex or there are more materials than marker values
+		 */
+		bool LoadObj(const std::string& path);
+		/**
+		 * Load the file with LoadStl (.stl), LoadObj (.obj) or LoadPly (other extensions)
+		 */
+		bool Load(const std::string& path);
+		/**
+		 * Replace the mesh by the given arrays, the markers are set to 1 without names.
+		 * Throw std::invalid_argument if the second dimension of the arrays is not 3, std::out_of_range if a face refers to a missing vertex.
+		 * @param vertices Coordinates of the vertices, vertexCount rows of x,y,z
+		 * @param faces Vertex indices of the triangles, faceCount rows of 3 indices
+		 */
+		void SetArrays(const double* vertices,int vertexCount,int vertexDim,const int* faces,int faceCount,int faceDim);
+		/**
+		 * Set the marker of each triangle. Throw std::invalid_argument if there is not one marker per triangle.
+		 */
+		void SetMarkers(const SpatialDiscretization::weight_t* markers,int markerCount);
+
+		std::size_t GetVertexCount() const;
+		std::size_t GetFaceCount() const;
+		/**
+		 * Bounding box of the vertices
+		 */
+		const dvec3& GetBoxMin() const;
+		const dvec3& GetBoxMax() const;
+		const std::vector<dvec3>& GetVertices() const;
+		/**
+		 * Vertex indices, 3 per triangle
+		 */
+		const std::vector<unsigned int>& GetFaces() const;
+		const std::vector<SpatialDiscretization::weight_t>& GetMarkers() const;
+		/**
+		 * Name of each marker value: the PLY layer names or the OBJ material names, empty for the other meshes
+		 */
+		const std::vector<std::string>& GetMarkerNames() const;
+
+		/**
+		 * Compute the bounding box of each triangle
+		 */
+		void BuildFaceBoxes();
+		/**
+		 * Min and max corners of the bounding box of each triangle, empty if BuildFaceBoxes has not been called
+		 */
+		const std::vector<dvec3>& GetFaceBoxes() const;
+		/**
+		 * Sort the triangles along the Morton (Z-order) curve of their centroid. Then the fields push the neighbour triangles
+		 * one after the other, the cells they write are close in memory. A cell shared by triangles of different markers may
+		 * then take another of these markers than with the file order.
+		 */
+		void BuildMortonOrder();
+		void ClearMortonOrder();
+		/**
+		 * Triangle indices in Morton order, empty if BuildMortonOrder has not been called
+		 */
+		const std::vector<unsigned int>& GetMortonOrder() const;
+
+		/**
+		 * Copy the arrays in numpy arrays of the same size
+		 */
+		void CopyVertices(double* vertices,int vertexCount,int vertexDim) const;
+		void CopyFaces(int* faces,int faceCount,int faceDim) const;
+		void CopyMarkers(SpatialDiscretization::weight_t* markers,int markerCount) const;
+		/**
+		 * One row per triangle: min x,y,z max x,y,z
+		 */
+		void CopyFaceBoxes(double* boxes,int faceCount,int boxDim) const;
+		void CopyMortonOrder(int* order,int faceCount) const;
+	private:
+		/**
+		 * Compute the bounds and drop the faces boxes and order of the previous mesh
+		 */
+		void Update();
+
+		std::vector<dvec3> vertices;
+		std::vector<unsigned int> faces;
+		std::vector<SpatialDiscretization::weight_t> markers;
+		std::vector<std::string> markerNames;
+		dvec3 boxMin;
+		dvec3 boxMax;
+		std::vector<dvec3> faceBoxes;
+		std::vector<unsigned int> mortonOrder;
+		unsigned int threadCount;
+	};
+}
+
+#endif
@@ -2,14 +2,213 @@
 import numpy as np
 import math
 import os
-from fastvoxel import ivec3
+import json
+import zlib
+from fastvoxel import ivec3, BlockCache, ScalarFieldCreator, Mesh, RunViews
 ##
-# Use multiple memmap to handle a huge matrix
+# Long integer array of a list. A matrix too large for the memory is read with export_npy then np.load(filename,mmap_mode='r')
 def as_long_array(lst):
     return np.asarray(lst,dtype=np.long)
+##
+# Statistics of all the cell values (markers, exterior and volumes ids) computed while labeling, in a single call.
+# Arrays are indexed by cell value, bounding_box columns are min i,j,k (included) max i,j,k (excluded), centroid is in meters
+def get_label_statistics(fastvoxel):
+    label_count=fastvoxel.get_label_count()
+    stats={"cell_count":np.empty(label_count,dtype=np.longlong),
+           "volume":np.empty(label_count,dtype=np.double),
+           "bounding_box":np.empty((label_count,6),dtype=np.intc),
+           "centroid":np.empty((label_count,3),dtype=np.double),
+           "boundary_face_count":np.empty(label_count,dtype=np.longlong)}
+    fastvoxel.copy_label_statistics(stats["cell_count"],stats["volume"],stats["bounding_box"],stats["centroid"],stats["boundary_face_count"])
+    return stats
+##
+# Runs of a cell value, one row per run: i, j, k begin (included), k end (excluded)
+def get_label_runs(fastvoxel,label):
+    runs=np.empty((fastvoxel.get_label_run_count(label),4),dtype=np.intc)
+    fastvoxel.copy_label_runs(label,runs)
+    return runs
+##
+# Array that keeps its owner alive, for the views on the memory of a field or of its runs
+class _owned_view(object):
+    def __init__(self,view,owner):
+        self.__array_interface__=view.__array_interface__
+        self._owner=owner
+##
+# Runs of the whole field, without dense decoding. Arrays are indexed by run, the runs of the column (i,j) are
+# [column_offset[i*size+j],column_offset[i*size+j+1][ and cover k in [start,start+length[.
+# column_offset, end and label are read only views on the field runs. The views share the runs with the field, they stay
+# valid when the field is modified, labeled again or deleted but then they show the runs of the call.
+def get_runs(fastvoxel):
+    views=RunViews(fastvoxel)
+    column_offset,end,label=[np.asarray(_owned_view(view,views)) for view in views.get_views()]
+    for view in (column_offset,end,label):
+        view.flags.writeable=False
+    start=np.zeros(len(end),dtype=end.dtype)
+    start[1:]=end[:-1]
+    # First run of each non empty column
+    start[column_offset[:-1][column_offset[:-1]<len(end)]]=0
+    return {"column_offset":column_offset,
+            "start":start,
+            "length":end-start,
+            "end":end,
+            "label":label}
+##
+# Cell (n,3) and value (n) of the points (n,3), in one call. The value of the points outside of the domain is -1.
+def query_points(fastvoxel,points):
+    points=np.ascontiguousarray(points,dtype=np.double).reshape(-1,3)
+    cells=np.empty((len(points),3),dtype=np.intc)
+    labels=np.empty(len(points),dtype=np.short)
+    fastvoxel.query_points(points,cells,labels)
+    return cells,labels
+##
+# Mesh of the vertices (n,3) and triangles (m,3) arrays, markers (m) are 1 if not given.
+# The mesh can be voxelized by any number of fields with voxelize_mesh.
+def create_mesh(vertices,faces,markers=None):
+    mesh=Mesh()
+    mesh.set_arrays(np.ascontiguousarray(vertices,dtype=np.double),np.ascontiguousarray(faces,dtype=np.intc))
+    if markers is not None:
+        mesh.set_markers(np.ascontiguousarray(markers,dtype=np.short))
+    return mesh
+##
+# Copy of the arrays of a mesh: vertices, faces and markers, and the face_boxes (min x,y,z max x,y,z) and
+# morton_order if they have been built
+def get_mesh_arrays(mesh):
+    arrays={"vertices":np.empty((mesh.get_vertex_count(),3),dtype=np.double),
+            "faces":np.empty((mesh.get_face_count(),3),dtype=np.intc),
+            "markers":np.empty(mesh.get_face_count(),dtype=np.short)}
+    mesh.copy_vertices(arrays["vertices"])
+    mesh.copy_faces(arrays["faces"])
+    mesh.copy_markers(arrays["markers"])
+    try:
+        arrays["face_boxes"]=np.empty((mesh.get_face_count(),6),dtype=np.double)
+        mesh.copy_face_boxes(arrays["face_boxes"])
+    except RuntimeError:
+        del arrays["face_boxes"]
+    try:
+        arrays["morton_order"]=np.empty(mesh.get_face_count(),dtype=np.intc)
+        mesh.copy_morton_order(arrays["morton_order"])
+    except RuntimeError:
+        del arrays["morton_order"]
+    return arrays
+##
+# Copy the block that contains the cells of a volume, with padding cells on each side (clipped to the domain).
+# Only the columns of the block are read. Return the first cell (i,j,k) of the block and the block.
+# If filt_array is given, the values in [0,len(filt_array)[ are replaced by filt_array[value], other cells are -1
+def extract_volume(fastvoxel,vol_id,padding=1,filt_array=None):
+    origin=ivec3()
+    shape=ivec3()
+    fastvoxel.get_volume_block(vol_id,padding,origin,shape)
+    block=np.full((shape[0],shape[1],shape[2]),-1,dtype=np.short)
+    if block.size>0:
+        if filt_array is None:
+            fastvoxel.copy_matrix(block,origin)
+        else:
+            fastvoxel.copy_matrix_filtered(block,origin,np.asarray(filt_array,dtype=np.short))
+    return (origin[0],origin[1],origin[2]),block
+##
+# Write the cells of a block in a .npy file without allocating the block, for arrays larger than the memory.
+# Read it back with np.load(filename,mmap_mode='r'). The block is the whole domain if shape is None, cells out of the domain are -1
+# If filt_array is given, the values in [0,len(filt_array)[ are replaced by filt_array[value], other cells are -1
+def export_npy(fastvoxel,filename,origin=(0,0,0),shape=None,filt_array=None):
+    if shape is None:
+        size=fastvoxel.get_domain_size()
+        shape=(size-origin[0],size-origin[1],size-origin[2])
+    vorigin=ivec3(origin[0],origin[1],origin[2])
+    vshape=ivec3(shape[0],shape[1],shape[2])
+    if filt_array is None:
+        fastvoxel.export_npy(filename,vorigin,vshape)
+    else:
+        fastvoxel.export_npy_filtered(filename,vorigin,vshape,np.asarray(filt_array,dtype=np.short))
+##
+# Reader of the chunk directories written by the export_chunks method of the field.
+# Only the chunks that intersect the copied block are read and decompressed.
+# It has the copy methods of the field, so np_voxel(chunk_store(directory)) slices the stored field.
+class chunk_store(object):
+    def __init__(self,directory):
+        with open(os.path.join(directory,"index.json"),"r") as f:
+            self.index=json.load(f)
+        if self.index.get("format")!="fastvoxel-chunks":
+            raise ValueError("%s is not a FastVoxel chunk directory" % directory)
+        self._directory=directory
+        self.shape=tuple(self.index["shape"])
+        self.chunk_shape=tuple(self.index["chunk_shape"])
+        self.dtype=np.dtype(self.index["dtype"])
+    def get_domain_size(self):
+        return self.shape[0]
+    ##
+    # Cells of a chunk, chunk is the chunk index on each axis
+    def read_chunk(self,chunk):
+        with open(os.path.join(self._directory,self.index["chunk_file"].format(*chunk)),"rb") as f:
+            data=f.read()
+        if self.index["compression"]=="zlib":
+            data=zlib.decompress(data)
+        shape=tuple(min(self.chunk_shape[dim],self.shape[dim]-chunk[dim]*self.chunk_shape[dim]) for dim in range(3))
+        return np.frombuffer(data,dtype=self.dtype).reshape(shape)
+    def copy_matrix(self,data,extract_pos):
+        self.copy_matrix_filtered(data,extract_pos,None)
+    ##
+    # Same behaviour as the field method: cells out of the domain, or with a value out of the filter, are not written
+    def copy_matrix_filtered(self,data,extract_pos,filt_array):
+        begin=[extract_pos[dim] for dim in range(3)]
+        end=[min(begin[dim]+data.shape[dim],self.shape[dim]) for dim in range(3)]
+        if any(end[dim]<=begin[dim] for dim in range(3)):
+            return
+        chunk_ranges=[range(begin[dim]//self.chunk_shape[dim],(end[dim]-1)//self.chunk_shape[dim]+1) for dim in range(3)]
+        for ci in chunk_ranges[0]:
+            for cj in chunk_ranges[1]:
+                for ck in chunk_ranges[2]:
+                    chunk=(ci,cj,ck)
+                    values=self.read_chunk(chunk)
+                    chunk_origin=[chunk[dim]*self.chunk_shape[dim] for dim in range(3)]
+                    low=[max(begin[dim],chunk_origin[dim]) for dim in range(3)]
+                    high=[min(end[dim],chunk_origin[dim]+values.shape[dim]) for dim in range(3)]
+                    source=values[tuple(slice(low[dim]-chunk_origin[dim],high[dim]-chunk_origin[dim]) for dim in range(3))]
+                    destination=data[tuple(slice(low[dim]-begin[dim],high[dim]-begin[dim]) for dim in range(3))]
+                    if filt_array is None:
+                        destination[...]=source
+                    else:
+                        inside=(source>=0)&(source<len(filt_array))
+                        destination[inside]=np.asarray(filt_array,dtype=data.dtype)[source[inside]]
+    def copy_matrix_strided(self,data,start,step):
+        self.copy_matrix_strided_filtered(data,start,step,None)
+    def copy_matrix_strided_filtered(self,data,start,step,filt_array):
+        indices=[start[dim]+step[dim]*np.arange(data.shape[dim]) for dim in range(3)]
+        self.copy_matrix_indexed_filtered(data,indices[0],indices[1],indices[2],filt_array)
+    def copy_matrix_indexed(self,data,x_index,y_index,z_index):
+        self.copy_matrix_indexed_filtered(data,x_index,y_index,z_index,None)
+    ##
+    # data[i,j,k] is the cell (x_index[i],y_index[j],z_index[k]), the chunks are read one at a time
+    def copy_matrix_indexed_filtered(self,data,x_index,y_index,z_index,filt_array):
+        indices=[np.asarray(index) for index in (x_index,y_index,z_index)]
+        for dim in range(3):
+            if np.any((indices[dim]<0)|(indices[dim]>=self.shape[dim])):
+                raise IndexError("cell index out of the domain on axis %d" % dim)
+        chunk_ids=[indices[dim]//self.chunk_shape[dim] for dim in range(3)]
+        for ci in np.unique(chunk_ids[0]):
+            for cj in np.unique(chunk_ids[1]):
+                for ck in np.unique(chunk_ids[2]):
+                    chunk=(int(ci),int(cj),int(ck))
+                    values=self.read_chunk(chunk)
+                    positions=[np.flatnonzero(chunk_ids[dim]==chunk[dim]) for dim in range(3)]
+                    source=values[np.ix_(*[indices[dim][positions[dim]]-chunk[dim]*self.chunk_shape[dim] for dim in range(3)])]
+                    if filt_array is None:
+                        data[np.ix_(*positions)]=source
+                    else:
+                        destination=data[np.ix_(*positions)]
+                        inside=(source>=0)&(source<len(filt_array))
+                        destination[inside]=np.asarray(filt_array,dtype=data.dtype)[source[inside]]
+                        data[np.ix_(*positions)]=destination
+##
+# Slicing of a field, or of a chunk_store, without copying the whole matrix
+##
+# cache_size: memory cap in bytes of a cache of decoded bricks, for repeated or sweeping contiguous slices of a field.
+# The bricks after a sweep are decoded in the background. Not used with chunk_store.
 class np_voxel(object):
-    def __init__(self,fastvoxel,shape=None,range_beg=None):
+    def __init__(self,fastvoxel,shape=None,range_beg=None,cache_size=None):
         self._fastvoxel=fastvoxel
+        self._block_cache=None
+        if cache_size is not None and isinstance(fastvoxel,ScalarFieldCreator):
+            self._block_cache=BlockCache(fastvoxel,cache_size)
         self.dtype=np.short
         if shape is None:
             shape=(fastvoxel.get_domain_size(),fastvoxel.get_domain_size(),fastvoxel.get_domain_size())
@@ -20,33 +219,66 @@ class np_voxel(object):
         self._filter=None
     def set_filter(self,filt_array):
         self._filter=filt_array
+    ##
+    # Supports integers, slices with any step and integer or boolean arrays on each axis, with the numpy semantics.
+    # Only the selected cells are decoded: each cell of an index array is copied once, then numpy indexing builds the result.
     def __getitem__(self, key):
-        if len(key)!=3:
-            raise(NotImplementedError("Only 3 dimensional matrix get value supported"))
-        get_origin_pos=[0,0,0]
-        get_destination_pos=[0,0,0]
-        single_dim=[slice(None),slice(None),slice(None)]
-        has_single=False
+        if not isinstance(key,tuple):
+            key=(key,)
+        if len(key)>3:
+            raise IndexError("too many indices for a 3 dimensional matrix")
+        key=key+(slice(None),)*(3-len(key))
+        axis_cells=[]  # range of the copied cells, or array of the copied cells
+        block_key=[]   # index of the result in the copied block
         for dim in range(3):
-            if type(key[dim]) is slice:
-                #Range
-                range_get=key[dim].indices(self.shape[dim])
-                get_origin_pos[dim]=range_get[0]
-                get_destination_pos[dim]=range_get[1]
+            item=key[dim]
+            if isinstance(item,slice):
+                axis_cells.append(range(*item.indices(self.shape[dim])))
+                block_key.append(slice(None))
+            elif np.ndim(item)==0 and not isinstance(item,(bool,np.bool_)):
+                index=int(item)
+                if index<0:
+                    index+=self.shape[dim]
+                if not 0<=index<self.shape[dim]:
+                    raise IndexError("index %d is out of bounds for axis %d with size %d" % (int(item),dim,self.shape[dim]))
+                axis_cells.append(range(index,index+1))
+                block_key.append(0)
             else:
-                #get only one item
-                has_single=True 
-                single_dim[dim]=0
-                get_origin_pos[dim]=key[dim]
-                get_destination_pos[dim]=key[dim]+1
-        ret_shape=tuple(list(as_long_array(get_destination_pos)-as_long_array(get_origin_pos)))
-        ret_value=np.empty(shape=ret_shape,dtype=self.dtype)
-        vget_origin_pos=ivec3(get_origin_pos[0],get_origin_pos[1],get_origin_pos[2])
-        if self._filter is None:
-            self._fastvoxel.copy_matrix(ret_value,vget_origin_pos+self._vrange_beg)
-        else:
-            self._fastvoxel.copy_matrix_filtered(ret_value,vget_origin_pos+self._vrange_beg,self._filter)
-        if not has_single:
-            return ret_value
-        else:
-            return ret_value[tuple(single_dim)]
+                indices=np.asarray(item)
+                if indices.dtype==np.bool_:
+                    if indices.ndim!=1 or len(indices)!=self.shape[dim]:
+                        raise IndexError("boolean index of axis %d must have the size %d" % (dim,self.shape[dim]))
+                    indices=np.flatnonzero(indices)
+                elif not np.issubdtype(indices.dtype,np.integer):
+                    raise IndexError("arrays used as indices must be of integer or boolean type")
+                indices=np.where(indices<0,indices+self.shape[dim],indices)
+                if np.any((indices<0)|(indices>=self.shape[dim])):
+                    raise IndexError("index out of bounds for axis %d with size %d" % (dim,self.shape[dim]))
+                unique_cells,inverse=np.unique(indices,return_inverse=True)
+                axis_cells.append(unique_cells)
+                block_key.append(inverse.reshape(indices.shape))
+        block=np.empty(tuple(len(cells) for cells in axis_cells),dtype=self.dtype)
+        if block.size>0:
+            if all(isinstance(cells,range) for cells in axis_cells):
+                start=ivec3(axis_cells[0].start,axis_cells[1].start,axis_cells[2].start)+self._vrange_beg
+                if all(cells.step==1 for cells in axis_cells):
+                    reader=self._fastvoxel if self._block_cache is None else self._block_cache
+                    if self._filter is None:
+                        reader.copy_matrix(block,start)
+                    else:
+                        reader.copy_matrix_filtered(block,start,self._filter)
+                else:
+                    step=ivec3(axis_cells[0].step,axis_cells[1].step,axis_cells[2].step)
+                    if self._filter is None:
+                        self._fastvoxel.copy_matrix_strided(block,start,step)
+                    else:
+                        self._fastvoxel.copy_matrix_strided_filtered(block,start,step,self._filter)
+            else:
+                indices=[np.asarray(axis_cells[dim],dtype=np.intc)+self._vrange_beg[dim] for dim in range(3)]
+                if self._filter is None:
+                    self._fastvoxel.copy_matrix_indexed(block,indices[0],indices[1],indices[2])
+                else:
+                    self._fastvoxel.copy_matrix_indexed_filtered(block,indices[0],indices[1],indices[2],self._filter)
+        if all(isinstance(item,slice) for item in block_key):
+            return block
+        return block[tuple(block_key)]
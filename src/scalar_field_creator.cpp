@@ -23,16 +23,31 @@
 #include "scalar_field_creator.hpp"
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <list>
 #include <utility>
 #include <cstring>
+#include <cstdio>
+#include <cerrno>
 #include <stdexcept>
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <map>
+#include <set>
 #include <input_output/progressionInfo.h>
+#include <tools/parallel_for.hpp>
+#include <tools/concurrent_union_find.hpp>
+#include <tools/ascii_number.hpp>
+#include <tools/file_mapping.hpp>
+#ifdef __USE_ZLIB__
+	#include <zlib.h>
+#endif
 namespace ScalarFieldBuilders
 {
-    inline unsigned int cell_addr(int i,int j,int k,int nj,int nk)
+    inline std::size_t cell_addr(int i,int j,int k,int nj,int nk)
     {
-        return k+j*nk+i*nk*nj;
+        return k+(std::size_t)j*nk+(std::size_t)i*nk*nj;
     }
 	inline SpatialDiscretization::cell_id_t At(const SpatialDiscretization::cell_id_t& X,const SpatialDiscretization::cell_id_t& Y, const SpatialDiscretization::cell_id_t& Size)
 	{
@@ -52,7 +67,7 @@ namespace ScalarFieldBuilders
 	}
 
     ScalarFieldCreator::ScalarFieldCreator(const double_t& _resolution)
-		:resolution(_resolution)
+		:resolution(_resolution),threadCount(0),minimalVolume(0.),minimalCellCount(0),smallVolumeValue(SpatialDiscretization::emptyValue),mergedVolumeCount(0),parityFallbackColumnCount(0),surfaceRunLayout(0),labeledField(false)
 	{
 
 
@@ -85,10 +100,13 @@ namespace ScalarFieldBuilders
 
 		domainInformation.domainSize=this->volumeInfo.cellCount;
 		domainInformation.weight=0;
+		ClearLabeling();
 		fieldData=PTR<SpatialDiscretization::weight_matrix>(new SpatialDiscretization::weight_matrix(domainInformation));
 	}
 	unsigned int ScalarFieldCreator::count()
 	{
+		if(!this->fieldData.get())
+			return (unsigned int)GetRunMatrix().GetRunCount(); //One matrix cell per run
 		unsigned int cpt(0);
 		(*fieldData).Count(cpt);
 		return cpt;
@@ -121,11 +139,356 @@ namespace ScalarFieldBuilders
 	{
 		return this->volumeInfo.volumeCount;
     }
+	SpatialDiscretization::weight_t ScalarFieldCreator::GetLabelCount()
+	{
+		return (SpatialDiscretization::weight_t)this->volumeInfo.labelStatistics.size();
+	}
+	const labelStatistics_t& ScalarFieldCreator::GetLabelStatistics(const SpatialDiscretization::weight_t& label)
+	{
+		if(label>=0 && (std::size_t)label<this->volumeInfo.labelStatistics.size())
+			return this->volumeInfo.labelStatistics[label];
+		throw std::out_of_range(
+			"Requested label (" + std::to_string(label) +
+			") has no statistics. Ensure the matrix is labeled and label < " + std::to_string(this->volumeInfo.labelStatistics.size()));
+	}
+	void ScalarFieldCreator::CopyLabelStatistics(long long* cellCount,int nCellCount,double* volume,int nVolume,int* boundingBox,int nBox,int nBoxCoord,double* centroid,int nCentroid,int nCentroidCoord,long long* boundaryFaceCount,int nFaces)
+	{
+		const std::size_t labelCount(this->volumeInfo.labelStatistics.size());
+		if((std::size_t)nCellCount!=labelCount || (std::size_t)nVolume!=labelCount || (std::size_t)nBox!=labelCount || (std::size_t)nCentroid!=labelCount || (std::size_t)nFaces!=labelCount || nBoxCoord!=6 || nCentroidCoord!=3)
+			throw std::invalid_argument("Statistics arrays must have GetLabelCount()="+std::to_string(labelCount)+" rows, with 6 bounding box and 3 centroid columns");
+		double_t cellVolume=pow(this->volumeInfo.cellSize, 3.);
+		for(std::size_t label=0;label<labelCount;label++)
+		{
+			const labelStatistics_t& labelStats(this->volumeInfo.labelStatistics[label]);
+			cellCount[label]=(long long)labelStats.cellCount;
+			volume[label]=cellVolume*labelStats.cellCount;
+			boundaryFaceCount[label]=(long long)labelStats.boundaryFaceCount;
+			int* labelBox(boundingBox+label*6);
+			double* labelCentroid(centroid+label*3);
+			if(labelStats.cellCount>0)
+			{
+				for(int axis=0;axis<3;axis++)
+				{
+					labelBox[axis]=(int)labelStats.cellMin.i[axis];
+					labelBox[axis+3]=(int)labelStats.cellMax.i[axis];
+				}
+				dvec3 meanCell(labelStats.cellSum/(double_t)labelStats.cellCount);
+				dvec3 center(this->volumeInfo.zeroCellCenter+meanCell*this->volumeInfo.cellSize);
+				for(int axis=0;axis<3;axis++)
+					labelCentroid[axis]=center[axis];
+			}else{
+				for(int axis=0;axis<6;axis++)
+					labelBox[axis]=0;
+				for(int axis=0;axis<3;axis++)
+					labelCentroid[axis]=0.;
+			}
+		}
+	}
+	void ScalarFieldCreator::SetThreadCount(const unsigned int& _threadCount)
+	{
+		this->threadCount=_threadCount;
+	}
+	unsigned int ScalarFieldCreator::GetThreadCount()
+	{
+		return this->threadCount;
+	}
+	void ScalarFieldCreator::SetMinimalVolume(const double_t& _minimalVolume)
+	{
+		this->minimalVolume=_minimalVolume;
+	}
+	double_t ScalarFieldCreator::GetMinimalVolume()
+	{
+		return this->minimalVolume;
+	}
+	void ScalarFieldCreator::SetMinimalCellCount(const std::size_t& _minimalCellCount)
+	{
+		this->minimalCellCount=_minimalCellCount;
+	}
+	std::size_t ScalarFieldCreator::GetMinimalCellCount()
+	{
+		return this->minimalCellCount;
+	}
+	void ScalarFieldCreator::SetSmallVolumeValue(const SpatialDiscretization::weight_t& _smallVolumeValue)
+	{
+		if(_smallVolumeValue<SpatialDiscretization::emptyValue)
+			throw std::invalid_argument("The small volume value must be a surface marker or -1");
+		this->smallVolumeValue=_smallVolumeValue;
+	}
+	SpatialDiscretization::weight_t ScalarFieldCreator::GetSmallVolumeValue()
+	{
+		return this->smallVolumeValue;
+	}
+	std::size_t ScalarFieldCreator::ResolveMinimalCellCount()
+	{
+		std::size_t cellCount(this->minimalCellCount);
+		double_t cellVolume=pow(this->volumeInfo.cellSize, 3.);
+		if(this->minimalVolume>0 && cellVolume>0)
+			cellCount=MAX(cellCount,(std::size_t)ceil(this->minimalVolume/cellVolume));
+		return cellCount;
+	}
+	std::size_t ScalarFieldCreator::GetMergedVolumeCount()
+	{
+		return this->mergedVolumeCount;
+	}
+	void ScalarFieldCreator::SetTransparentMarkers(const std::vector<SpatialDiscretization::weight_t>& markers)
+	{
+		this->transparentMarker.clear();
+		for(std::vector<SpatialDiscretization::weight_t>::const_iterator itmarker=markers.begin();itmarker!=markers.end();itmarker++)
+		{
+			if(*itmarker<0)
+				throw std::invalid_argument("Transparent marker must be a positive surface marker");
+			if((std::size_t)*itmarker>=this->transparentMarker.size())
+				this->transparentMarker.resize(*itmarker+1,0);
+			this->transparentMarker[*itmarker]=1;
+		}
+	}
+	std::vector<SpatialDiscretization::weight_t> ScalarFieldCreator::GetTransparentMarkers()
+	{
+		std::vector<SpatialDiscretization::weight_t> markers;
+		for(std::size_t marker=0;marker<this->transparentMarker.size();marker++)
+		{
+			if(this->transparentMarker[marker])
+				markers.push_back((SpatialDiscretization::weight_t)marker);
+		}
+		return markers;
+	}
+	/**
+	 * FNV-1a hash of the column offsets and of the run ends, the values of the runs are not part of the layout
+	 */
+	static unsigned long long RunLayoutChecksum(const SpatialDiscretization::RunMatrix& runs)
+	{
+		unsigned long long checksum(14695981039346656037ULL);
+		for(std::size_t column=0;column<runs.columnOffset.size();column++)
+			checksum=(checksum^(unsigned long long)runs.columnOffset[column])*1099511628211ULL;
+		for(std::size_t idRun=0;idRun<runs.runEnd.size();idRun++)
+			checksum=(checksum^(unsigned long long)runs.runEnd[idRun])*1099511628211ULL;
+		return checksum;
+	}
+	bool ScalarFieldCreator::HasSurfaceRuns(const SpatialDiscretization::RunMatrix& runs) const
+	{
+		return !this->surfaceRunData.empty() && this->surfaceRunData.size()==runs.GetRunCount() && this->surfaceRunLayout==RunLayoutChecksum(runs);
+	}
+	void ScalarFieldCreator::RestoreSurfaceRuns(SpatialDiscretization::RunMatrix& runs)
+	{
+		//The matrix cells keep their layout while labeling, only the values of the empty runs change.
+		//So the surface values of the runs are saved by the first labeling and restored before the next ones.
+		if(HasSurfaceRuns(runs))
+			runs.runData=this->surfaceRunData;
+		else
+		{
+			this->surfaceRunData=runs.runData;
+			this->surfaceRunLayout=RunLayoutChecksum(runs);
+		}
+		//The caller writes the labels in fieldData
+		this->labeledField=true;
+	}
+	void ScalarFieldCreator::BuildPropagationData(const SpatialDiscretization::RunArray<SpatialDiscretization::weight_t>& surfaceData,std::vector<SpatialDiscretization::weight_t>& propagationData)
+	{
+		propagationData.assign(surfaceData.begin(),surfaceData.end());
+		if(this->transparentMarker.empty())
+			return;
+		for(std::size_t idRun=0;idRun<propagationData.size();idRun++)
+		{
+			const SpatialDiscretization::weight_t& value(propagationData[idRun]);
+			if(value>=0 && (std::size_t)value<this->transparentMarker.size() && this->transparentMarker[value])
+				propagationData[idRun]=SpatialDiscretization::emptyValue;
+		}
+	}
+	void ScalarFieldCreator::RestoreSurfaces()
+	{
+		using namespace SpatialDiscretization;
+		//Done once after a labeling, the next triangles find an unlabeled matrix
+		if(this->labeledField && !this->surfaceRunData.empty())
+		{
+			RunMatrix runs;
+			std::vector<zcell*> runCell;
+			runs.Build(GetFieldData(),parallel_tools::ResolveThreadCount(threadCount,volumeInfo.cellCount),&runCell);
+			if(HasSurfaceRuns(runs))
+			{
+				for(std::size_t idRun=0;idRun<runCell.size();idRun++)
+					runCell[idRun]->SetData(this->surfaceRunData[idRun]);
+			}
+		}
+		ClearLabeling();
+	}
+	void ScalarFieldCreator::ClearLabeling()
+	{
+		this->surfaceRunData.clear();
+		this->labeledField=false;
+		this->volumeInfo.labelStatistics.clear();
+		SetRunMatrix(PTR<SpatialDiscretization::RunMatrix>());
+	}
+	void ScalarFieldCreator::SetRunMatrix(const PTR<SpatialDiscretization::RunMatrix>& labeledRuns)
+	{
+		this->runMatrix=labeledRuns;
+		this->labelRunOffset.clear();
+		this->labelRun.clear();
+	}
+	const SpatialDiscretization::RunMatrix& ScalarFieldCreator::GetRunMatrix()
+	{
+		using namespace SpatialDiscretization;
+		std::lock_guard<std::mutex> lock(runMatrixMutex);
+		if(!this->runMatrix.get())
+		{
+			PTR<RunMatrix> matrixRuns(new RunMatrix());
+			matrixRuns->Build(GetFieldData(),parallel_tools::ResolveThreadCount(threadCount,volumeInfo.cellCount));
+			SetRunMatrix(matrixRuns);
+		}
+		return *this->runMatrix;
+	}
+	PTR<SpatialDiscretization::RunMatrix> ScalarFieldCreator::GetSharedRunMatrix()
+	{
+		GetRunMatrix();
+		std::lock_guard<std::mutex> lock(runMatrixMutex);
+		return this->runMatrix;
+	}
+	void ScalarFieldCreator::BuildLabelRunIndex()
+	{
+		using namespace SpatialDiscretization;
+		const RunMatrix& runs(GetRunMatrix());
+		if(!labelRunOffset.empty())
+			return;
+		const std::size_t runCount(runs.GetRunCount());
+		const std::size_t labelCount(runCount>0 ? (std::size_t)MAX(*std::max_element(runs.runData.begin(),runs.runData.end())+1,0) : 0);
+		//Counting sort of the runs by cell value, each chunk of runs count then place its own runs
+		const unsigned int chunkCount(parallel_tools::ResolveThreadCount(threadCount,runCount));
+		std::vector<std::vector<std::size_t> > chunkLabelCount(chunkCount);
+		parallel_tools::ParallelFor(chunkCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int chunk)
+		{
+			std::vector<std::size_t>& labelRunCount(chunkLabelCount[chunk]);
+			labelRunCount.assign(labelCount,0);
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+				if(runs.runData[idRun]>=0)
+					labelRunCount[runs.runData[idRun]]++;
+		});
+		labelRunOffset.assign(labelCount+1,0);
+		std::size_t offset(0);
+		for(std::size_t label=0;label<labelCount;label++)
+		{
+			labelRunOffset[label]=offset;
+			for(unsigned int chunk=0;chunk<chunkCount;chunk++)
+			{
+				std::size_t chunkRunCount(chunkLabelCount[chunk][label]);
+				chunkLabelCount[chunk][label]=offset;
+				offset+=chunkRunCount;
+			}
+		}
+		labelRunOffset[labelCount]=offset;
+		labelRun.resize(offset);
+		parallel_tools::ParallelFor(chunkCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int chunk)
+		{
+			std::vector<std::size_t>& labelRunPosition(chunkLabelCount[chunk]);
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+				if(runs.runData[idRun]>=0)
+					labelRun[labelRunPosition[runs.runData[idRun]]++]=idRun;
+		});
+	}
+	std::size_t ScalarFieldCreator::GetLabelRunCount(const SpatialDiscretization::weight_t& label)
+	{
+		BuildLabelRunIndex();
+		if(label<0 || (std::size_t)label+1>=labelRunOffset.size())
+			return 0;
+		return labelRunOffset[label+1]-labelRunOffset[label];
+	}
+	void ScalarFieldCreator::CopyLabelRuns(const SpatialDiscretization::weight_t& label,int* runs,int nRuns,int nRunCoord)
+	{
+		using namespace SpatialDiscretization;
+		const std::size_t runCount(GetLabelRunCount(label));
+		if((std::size_t)nRuns!=runCount || nRunCoord!=4)
+			throw std::invalid_argument("Runs array must have GetLabelRunCount(label)="+std::to_string(runCount)+" rows and 4 columns");
+		const RunMatrix& matrixRuns(GetRunMatrix());
+		for(std::size_t idLabelRun=0;idLabelRun<runCount;idLabelRun++)
+		{
+			std::size_t idRun(labelRun[labelRunOffset[label]+idLabelRun]);
+			std::size_t column(matrixRuns.FindColumn(idRun));
+			int* run(runs+idLabelRun*4);
+			run[0]=(int)(column/matrixRuns.size);
+			run[1]=(int)(column%matrixRuns.size);
+			run[2]=(int)matrixRuns.RunBegin(column,idRun);
+			run[3]=(int)matrixRuns.runEnd[idRun];
+		}
+	}
+	RunViews::RunViews(ScalarFieldCreator& field)
+		: runs(field.GetSharedRunMatrix())
+	{
+		if(runs->GetRunCount()>(std::size_t)INT_MAX || runs->columnOffset.size()>(std::size_t)INT_MAX)
+			throw std::out_of_range("The run arrays are too large for the views");
+		if(sizeof(std::size_t)!=sizeof(unsigned long long))
+			wideColumnOffset.assign(runs->columnOffset.begin(),runs->columnOffset.end());
+	}
+	void RunViews::GetViews(unsigned long long** columnOffset,int* nColumnOffset,unsigned int** runEnd,int* nRunEnd,SpatialDiscretization::weight_t** runValue,int* nRunValue)
+	{
+		using namespace SpatialDiscretization;
+		static_assert(sizeof(cell_id_t)==sizeof(unsigned int),"The run ends are exposed as 32 bits integers");
+		if(sizeof(std::size_t)==sizeof(unsigned long long))
+			*columnOffset=(unsigned long long*)runs->columnOffset.begin();
+		else
+			*columnOffset=wideColumnOffset.empty() ? NULL : &wideColumnOffset[0];
+		*nColumnOffset=(int)runs->columnOffset.size();
+		*runEnd=(unsigned int*)runs->runEnd.begin();
+		*nRunEnd=(int)runs->runEnd.size();
+		*runValue=(weight_t*)runs->runData.begin();
+		*nRunValue=(int)runs->runData.size();
+	}
+	void ScalarFieldCreator::GetLabelRangeBoundaries(ivec3& min,ivec3& max,const SpatialDiscretization::weight_t& firstLabel,const SpatialDiscretization::weight_t& lastLabel)
+	{
+		using namespace SpatialDiscretization;
+		min.set(volumeInfo.cellCount,volumeInfo.cellCount,volumeInfo.cellCount);
+		max.set(0,0,0);
+		for(long label=MAX(firstLabel,0);label<=lastLabel;label++)
+		{
+			if((std::size_t)label<volumeInfo.labelStatistics.size())
+			{
+				//Bounding box computed while labeling
+				const labelStatistics_t& labelStats(volumeInfo.labelStatistics[label]);
+				if(labelStats.cellCount>0)
+				{
+					min.set(MIN(min.x,labelStats.cellMin.x),MIN(min.y,labelStats.cellMin.y),MIN(min.z,labelStats.cellMin.z));
+					max.set(MAX(max.x,labelStats.cellMax.x),MAX(max.y,labelStats.cellMax.y),MAX(max.z,labelStats.cellMax.z));
+				}
+				continue;
+			}
+			std::size_t runCount(GetLabelRunCount((weight_t)label));
+			const RunMatrix& runs(GetRunMatrix());
+			for(std::size_t idLabelRun=labelRunOffset[label];idLabelRun<labelRunOffset[label]+runCount;idLabelRun++)
+			{
+				std::size_t idRun(labelRun[idLabelRun]);
+				std::size_t column(runs.FindColumn(idRun));
+				long cell_x(column/runs.size),cell_y(column%runs.size);
+				min.set(MIN(min.x,cell_x),MIN(min.y,cell_y),MIN(min.z,(long)runs.RunBegin(column,idRun)));
+				max.set(MAX(max.x,cell_x+1),MAX(max.y,cell_y+1),MAX(max.z,(long)runs.runEnd[idRun]));
+			}
+		}
+	}
+	void ScalarFieldCreator::GetVolumeBlock(const SpatialDiscretization::weight_t& volId,const int& padding,ivec3& origin,ivec3& shape)
+	{
+		ivec3 min,max;
+		GetCellValueBoundaries(min,max,volId);
+		origin.set(0,0,0);
+		shape.set(0,0,0);
+		if(max.x<=min.x)
+			return;
+		const long size(volumeInfo.cellCount);
+		for(int axis=0;axis<3;axis++)
+		{
+			origin[axis]=MAX(min[axis]-padding,0L);
+			shape[axis]=MIN(max[axis]+padding,size)-origin[axis];
+		}
+	}
+	ivec3 ScalarFieldCreator::ExtractVolume(const SpatialDiscretization::weight_t& volId,const int& padding,std::vector<SpatialDiscretization::weight_t>& block,ivec3& shape,const SpatialDiscretization::weight_t* filter,int nIndex)
+	{
+		ivec3 origin;
+		GetVolumeBlock(volId,padding,origin,shape);
+		block.assign((std::size_t)shape.x*shape.y*shape.z,SpatialDiscretization::emptyValue);
+		if(!block.empty())
+			CopyMatrixFiltered(&block[0],shape.x,shape.y,shape.z,origin,filter,nIndex);
+		return origin;
+	}
 
 	bool ScalarFieldCreator::IsContainsVol( const ivec2& xyCell, SpatialDiscretization::weight_t& volId)
 	{
 		using namespace SpatialDiscretization;
-		zcell* currentCell=&((*this->fieldData)[xyCell.x][xyCell.y]);
+		zcell* currentCell=&(GetFieldData()[xyCell.x][xyCell.y]);
 		while(currentCell->Next(&currentCell))
 		{
 			if(currentCell->GetData()==volId)
@@ -136,7 +499,7 @@ namespace ScalarFieldBuilders
 	void ScalarFieldCreator::GetMinMaxOnZ( const ivec2& xyCell, SpatialDiscretization::weight_t& minVolId,SpatialDiscretization::weight_t& maxVolId)
 	{
 		using namespace SpatialDiscretization;
-		zcell* currentCell=&((*this->fieldData)[xyCell.x][xyCell.y]);
+		zcell* currentCell=&(GetFieldData()[xyCell.x][xyCell.y]);
 		minVolId=currentCell->GetData();
 		maxVolId=minVolId;
 		while(currentCell->Next(&currentCell))
@@ -205,54 +568,135 @@ namespace ScalarFieldBuilders
 			return;
 
 		using namespace SpatialDiscretization;
-		cell_id_t cell_z=0;
-		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+		//Only the runs of the volume are visited
+		std::size_t runCount(GetLabelRunCount(idVol));
+		const RunMatrix& runs(GetRunMatrix());
+		for(std::size_t idLabelRun=0;idLabelRun<runCount;idLabelRun++)
 		{
-			for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+			std::size_t idRun(labelRun[labelRunOffset[idVol]+idLabelRun]);
+			std::size_t column(runs.FindColumn(idRun));
+			cell_id_t cell_x(column/runs.size),cell_y(column%runs.size);
+			for(cell_id_t cell_z=runs.RunBegin(column,idRun);cell_z<runs.runEnd[idRun];cell_z++)
 			{
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
-				{
-					if((*currentCell).GetData()==idVol)
-					{
-						for(cell_id_t cell_z_offset=0;cell_z_offset<currentCell->GetSize();cell_z_offset++)
-						{
-                            dvec3 cellCenter=CellIdToCenterCoordinate(ivec3(cell_x,cell_y,cell_z+cell_z_offset),this->volumeInfo.cellSize,this->volumeInfo.zeroCellCenter);
-							xyzFile<<cellCenter.x<<" "<<cellCenter.y<<" "<<cellCenter.z<<std::endl;
-						}
-					}
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
-				}
+				dvec3 cellCenter=CellIdToCenterCoordinate(ivec3(cell_x,cell_y,cell_z),this->volumeInfo.cellSize,this->volumeInfo.zeroCellCenter);
+				xyzFile<<cellCenter.x<<" "<<cellCenter.y<<" "<<cellCenter.z<<std::endl;
 			}
 		}
 		xyzFile.close();
 
 	}
+	/**
+	 * Append the decimal text of the integer
+	 */
+	static void AppendInteger(std::string& text,long long value)
+	{
+		char digits[24];
+		int digitCount(0);
+		const bool negative(value<0);
+		unsigned long long magnitude(negative ? 0ULL-(unsigned long long)value : (unsigned long long)value);
+		do
+		{
+			digits[digitCount++]=(char)('0'+magnitude%10);
+			magnitude/=10;
+		}while(magnitude>0);
+		if(negative)
+			text.push_back('-');
+		while(digitCount>0)
+			text.push_back(digits[--digitCount]);
+	}
+
 	void ScalarFieldCreator::ExportIJKData(const std::string& Infilename,const std::string& Outfilename)
 	{
-		std::ifstream coordinatesFile;
 		std::ofstream ijkFile;
-		ijkFile.open(Outfilename.c_str(),std::ios_base::out);
-		coordinatesFile.open(Infilename.c_str(),std::ios_base::in);
-		if(!coordinatesFile.is_open())
+		ijkFile.open(Outfilename.c_str(),std::ios_base::out | std::ios_base::binary);
+		PTR<file_tools::FileMapping> coordinatesFile;
+		try
+		{
+			coordinatesFile=PTR<file_tools::FileMapping>(new file_tools::FileMapping(Infilename));
+		} catch(std::runtime_error&)
 		{
 			std::cerr<<"Input coordinates translation file not found."<<std::endl;
 			return;
 		}
-		while (! coordinatesFile.eof() )
+		const char* data(coordinatesFile->GetData());
+		const std::size_t size(coordinatesFile->GetSize());
+		//Chunks of lines parsed in parallel: id X Y Z
+		const std::size_t minimalChunkSize(1<<20);
+		const unsigned int chunkCount(parallel_tools::ResolveThreadCount(threadCount,size/minimalChunkSize+1));
+		std::vector<const char*> chunkBegin(chunkCount+1,data+size);
+		chunkBegin[0]=data;
+		for(unsigned int chunk=1;chunk<chunkCount;chunk++)
 		{
-		  std::string line;
-		  getline (coordinatesFile,line);
-		  //id X Y Z
-		  int objectIndex;
-          dvec3 coordinate;
-          sscanf(line.c_str(),"%i %lf %lf %lf",&objectIndex,&(coordinate.x),&(coordinate.y),&(coordinate.z));
-		  ivec3 ijk=this->GetCellIdByCoord(coordinate);
-		  ijkFile<<objectIndex<<" "<<ijk.a<<" "<<ijk.b<<" "<<ijk.c<<" "<<this->GetMatrixValue(ijk)<<std::endl;
+			const char* boundary(MAX(data+size*chunk/chunkCount,chunkBegin[chunk-1]));
+			const char* lineEnd((const char*)memchr(boundary,'\n',data+size-boundary));
+			chunkBegin[chunk]=lineEnd ? lineEnd+1 : data+size;
 		}
-		coordinatesFile.close();
+		std::vector<std::vector<long long> > chunkIds(chunkCount);
+		std::vector<std::vector<double> > chunkPoints(chunkCount);
+		parallel_tools::ParallelFor(chunkCount,0,chunkCount,[&](std::size_t begin,std::size_t end,unsigned int)
+		{
+			for(std::size_t chunk=begin;chunk<end;chunk++)
+			{
+				for(const char* lineBegin=chunkBegin[chunk];lineBegin<chunkBegin[chunk+1];)
+				{
+					const char* lineEnd((const char*)memchr(lineBegin,'\n',chunkBegin[chunk+1]-lineBegin));
+					if(!lineEnd)
+						lineEnd=chunkBegin[chunk+1];
+					const char* cursor(lineBegin);
+					lineBegin=lineEnd+1;
+					long long objectId;
+					if(!file_tools::ParseAsciiInteger(cursor,lineEnd,objectId))
+						continue;
+					double values[3];
+					int valueCount(0);
+					while(valueCount<3 && file_tools::ParseAsciiNumber(cursor,lineEnd,values[valueCount]))
+						valueCount++;
+					if(valueCount<3)
+						continue;
+					chunkIds[chunk].push_back(objectId);
+					chunkPoints[chunk].insert(chunkPoints[chunk].end(),values,values+3);
+				}
+			}
+		});
+		std::vector<long long> objectIndex;
+		std::vector<double> coordinates;
+		for(unsigned int chunk=0;chunk<chunkCount;chunk++)
+		{
+			objectIndex.insert(objectIndex.end(),chunkIds[chunk].begin(),chunkIds[chunk].end());
+			coordinates.insert(coordinates.end(),chunkPoints[chunk].begin(),chunkPoints[chunk].end());
+			std::vector<long long>().swap(chunkIds[chunk]);
+			std::vector<double>().swap(chunkPoints[chunk]);
+		}
+		const std::size_t pointCount(objectIndex.size());
+		std::vector<int> cells(pointCount*3);
+		std::vector<SpatialDiscretization::weight_t> labels(pointCount);
+		//QueryPoints takes int counts, larger files are resolved by batches
+		for(std::size_t firstPoint=0;firstPoint<pointCount;firstPoint+=INT_MAX)
+		{
+			const int batchCount((int)MIN(pointCount-firstPoint,(std::size_t)INT_MAX));
+			this->QueryPoints(&coordinates[firstPoint*3],batchCount,3,&cells[firstPoint*3],batchCount,3,&labels[firstPoint],batchCount);
+		}
+		//Lines formatted in parallel, written in order
+		std::vector<std::string> chunkText(chunkCount);
+		parallel_tools::ParallelFor(chunkCount,0,pointCount,[&](std::size_t begin,std::size_t end,unsigned int chunk)
+		{
+			std::string& text(chunkText[chunk]);
+			text.reserve((end-begin)*24);
+			for(std::size_t idPoint=begin;idPoint<end;idPoint++)
+			{
+				AppendInteger(text,objectIndex[idPoint]);
+				for(int axis=0;axis<3;axis++)
+				{
+					text.push_back(' ');
+					AppendInteger(text,cells[idPoint*3+axis]);
+				}
+				text.push_back(' ');
+				AppendInteger(text,labels[idPoint]);
+				text.push_back('\n');
+			}
+		});
+		for(unsigned int chunk=0;chunk<chunkCount;chunk++)
+			ijkFile.write(chunkText[chunk].data(),chunkText[chunk].size());
 		ijkFile.close();
 	}
 
@@ -266,7 +710,7 @@ namespace ScalarFieldBuilders
 		    for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
 			{
 				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
+				zcell* currentCell=&(GetFieldData()[cell_x][cell_y]);
 				while(currentCell)
 				{
 					SpatialDiscretization::weight_t cell_type=(*currentCell).GetData();
@@ -281,331 +725,819 @@ namespace ScalarFieldBuilders
 	}
     void ScalarFieldCreator::GetCellValueBoundaries(ivec3& min,ivec3& max,const SpatialDiscretization::weight_t& volid)
     {
+		GetLabelRangeBoundaries(min,max,volid,volid);
+    }
+
+	/**
+	 * Decode the cells [zBegin,zEnd[ of a block, in the VTK order (X varies fastest)
+	 * @param slab Destination of blockShape.x*blockShape.y*(zEnd-zBegin) cells
+	 * @param column Buffer of zEnd-zBegin cells
+	 */
+	static void DecodeBlockSlab(const SpatialDiscretization::RunMatrix& runs,const ivec3& blockOrigin,const ivec3& blockShape,const int& zBegin,const int& zEnd,SpatialDiscretization::weight_t* slab,SpatialDiscretization::weight_t* column)
+	{
 		using namespace SpatialDiscretization;
-		cell_id_t min_x=volumeInfo.cellCount;
-        cell_id_t min_y=volumeInfo.cellCount;
-        cell_id_t min_z=volumeInfo.cellCount;
-        cell_id_t max_x=0;
-        cell_id_t max_y=0;
-        cell_id_t max_z=0;
-        std::size_t cell_z;
- 		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+		const std::size_t sliceSize((std::size_t)blockShape.x*blockShape.y);
+		for(int j=0;j<blockShape.y;j++)
 		{
-		    for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+			for(int i=0;i<blockShape.x;i++)
 			{
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
-				{
-					const SpatialDiscretization::weight_t& cell_type(currentCell->GetData());
-                    if (cell_type==volid)
-                    {
-					    min_x=MIN(min_x,cell_x);
-                        min_y=MIN(min_y,cell_y);
-					    min_z=MIN(min_z,cell_z);
-					    max_x=MAX(max_x,cell_x+1);
-                        max_y=MAX(max_y,cell_y+1);
-					    max_z=MAX(max_z,cell_z+currentCell->GetSize());
-                    }
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
-				}
+				runs.DecodeColumn(runs.ColumnIndex(blockOrigin.x+i,blockOrigin.y+j),blockOrigin.z+zBegin,blockOrigin.z+zEnd,column);
+				weight_t* destination(slab+(std::size_t)j*blockShape.x+i);
+				for(int k=0;k<zEnd-zBegin;k++)
+					destination[k*sliceSize]=column[k];
 			}
 		}
-		min.set(min_x,min_y,min_z);
-		max.set(max_x,max_y,max_z);
-    }
+	}
 
-	void ScalarFieldCreator::ExportVTK(const std::string& filename,const SpatialDiscretization::weight_t& idVol)
+	inline bool IsLittleEndian()
 	{
-		progressionInfo exportProgressionInformation(3);
+		const unsigned short one(1);
+		return *((const unsigned char*)&one)==1;
+	}
 
+	void ScalarFieldCreator::WriteVTKBlock(const std::string& filename,const ivec3& blockOrigin,const ivec3& blockShape,EXPORT_FORMAT format,unsigned int workerThreadCount,bool showProgression)
+	{
+		using namespace SpatialDiscretization;
 		std::ofstream xyzFile;
-		xyzFile.open(filename.c_str(),std::ios_base::out);
+		xyzFile.open(filename.c_str(),format==EXPORT_VTK_ASCII ? std::ios_base::out : std::ios_base::out | std::ios_base::binary);
 		if(!xyzFile.is_open())
-			return;
-
-		using namespace SpatialDiscretization;
-		cell_id_t cell_z=0;
-
-		// RECHERCHE DES EXTREMAS
-		cell_id_t min_x=volumeInfo.cellCount;
-        cell_id_t min_y=volumeInfo.cellCount;
-        cell_id_t min_z=volumeInfo.cellCount;
-        cell_id_t max_x=0;
-        cell_id_t max_y=0;
-        cell_id_t max_z=0;
-		bool somethingToExport=false;
-		std::cout<<"Establishing volume bounding box"<<std::endl;
- 		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
 		{
-		    for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
-			{
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
-				{
-					SpatialDiscretization::weight_t cell_type=(*currentCell).GetData();
-					for(cell_id_t cell_z_offset=0;cell_z_offset<currentCell->GetSize();cell_z_offset++)
-					{
-					  if ((idVol==-1 && cell_type<=this->volumeInfo.maximal_marker_index && cell_type!=-1) || (idVol!=-1 && cell_type==idVol))
-					  {
-					    somethingToExport=true;
-					    min_x=MIN(min_x,cell_x);
-                        min_y=MIN(min_y,cell_y);
-					    min_z=MIN(min_z,cell_z);
-					    max_x=MAX(max_x,cell_x);
-                        max_y=MAX(max_y,cell_y);
-					    max_z=MAX(max_z,cell_z+currentCell->GetSize()-1);
-					  }
-					}
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
-				}
-			}
+			std::cerr<<"Can not write "<<filename<<std::endl;
+			return;
 		}
+		progressionInfo exportProgressionInformation(2);
+		const int sizex(blockShape.x),sizey(blockShape.y),sizez(blockShape.z);
+		const std::size_t sliceSize((std::size_t)sizex*sizey);
+		const std::size_t cellCount(sliceSize*sizez);
+		const RunMatrix& runs(GetRunMatrix());
+		//Slabs of about 1M cells, a batch of slabs is decoded (and compressed) in parallel then written in order
+		const int slabDepth(MIN(sizez,MAX(1,(int)((1<<20)/sliceSize))));
+		const std::size_t slabCount((sizez+slabDepth-1)/slabDepth);
+		const unsigned int workerCount(parallel_tools::ResolveThreadCount(workerThreadCount,slabCount));
+		std::vector<std::vector<weight_t> > slab(workerCount,std::vector<weight_t>(sliceSize*slabDepth));
+		std::vector<std::vector<weight_t> > column(workerCount,std::vector<weight_t>(slabDepth));
+		std::vector<std::vector<unsigned char> > compressedSlab(format==EXPORT_VTI_ZLIB ? workerCount : 0);
+		//VTK compression header: block count, block size, last block size (0 if full) then the compressed size of each block
+		std::vector<unsigned long long> compressionHeader;
+		std::streampos compressionHeaderPos;
 		exportProgressionInformation.GetMainOperation()->Next();
-		if(somethingToExport)
+
+		//ECRITURE DANS LE FICHIER
+		dvec3 origin=this->GetCenterCellCoordinates(blockOrigin);
+		const bool swapBytes(format==EXPORT_VTK_BINARY && IsLittleEndian()); //Legacy binary VTK is big endian
+		if(format==EXPORT_VTI || format==EXPORT_VTI_ZLIB)
 		{
-			if(idVol!=-1)
+			xyzFile<<"<?xml version=\"1.0\"?>\n";
+			xyzFile<<"<VTKFile type=\"ImageData\" version=\"1.0\" byte_order=\""<<(IsLittleEndian() ? "LittleEndian" : "BigEndian")<<"\" header_type=\"UInt64\"";
+			if(format==EXPORT_VTI_ZLIB)
+				xyzFile<<" compressor=\"vtkZLibDataCompressor\"";
+			xyzFile<<">\n";
+			xyzFile<<"  <ImageData WholeExtent=\"0 "<<sizex-1<<" 0 "<<sizey-1<<" 0 "<<sizez-1<<"\" Origin=\""<<origin.x<<" "<<origin.y<<" "<<origin.z<<"\" Spacing=\""<<volumeInfo.cellSize<<" "<<volumeInfo.cellSize<<" "<<volumeInfo.cellSize<<"\">\n";
+			xyzFile<<"    <Piece Extent=\"0 "<<sizex-1<<" 0 "<<sizey-1<<" 0 "<<sizez-1<<"\">\n";
+			xyzFile<<"      <PointData Scalars=\"MATERIAL\">\n";
+			xyzFile<<"        <DataArray type=\"Int16\" Name=\"MATERIAL\" format=\"appended\" offset=\"0\"/>\n";
+			xyzFile<<"      </PointData>\n";
+			xyzFile<<"    </Piece>\n";
+			xyzFile<<"  </ImageData>\n";
+			xyzFile<<"  <AppendedData encoding=\"raw\">\n   _";
+			if(format==EXPORT_VTI_ZLIB)
 			{
-				if(min_x>0)
-					min_x--;
-				if(min_y>0)
-					min_y--;
-				if(min_z>0)
-					min_z--;
-				if(max_x<volumeInfo.cellCount-1)
-					max_x++;
-				if(max_y<volumeInfo.cellCount-1)
-					max_y++;
-				if(max_z<volumeInfo.cellCount-1)
-					max_z++;
+				//Compressed sizes are known once the blocks are written, the header is filled at the end
+				compressionHeader.resize(3+slabCount,0);
+				compressionHeader[0]=slabCount;
+				compressionHeader[1]=sliceSize*slabDepth*sizeof(weight_t);
+				compressionHeader[2]=(cellCount*sizeof(weight_t))%compressionHeader[1];
+				compressionHeaderPos=xyzFile.tellp();
+				xyzFile.write((const char*)&compressionHeader[0],compressionHeader.size()*sizeof(unsigned long long));
+			}else{
+				unsigned long long byteCount(cellCount*sizeof(weight_t));
+				xyzFile.write((const char*)&byteCount,sizeof(byteCount));
 			}
-
-			std::size_t sizex(max_x-min_x+1),sizey(max_y-min_y+1),sizez(max_z-min_z+1);
-    		exportProgressionInformation.GetMainOperation()->Next();
-
-			std::cout<<"Write file."<<std::endl;
-			//ECRITURE DANS LE FICHIER
+		}else{
 			xyzFile<<"# vtk DataFile Version 3.0"<<std::endl;
 			xyzFile<<"Exemple STRUCTURED_POINTS"<<std::endl;
-			xyzFile<<"ASCII"<<std::endl;
+			xyzFile<<(format==EXPORT_VTK_ASCII ? "ASCII" : "BINARY")<<std::endl;
 			xyzFile<<"DATASET STRUCTURED_POINTS"<<std::endl;
-			xyzFile<<"DIMENSIONS "<<(max_x-min_x+1)<<" "<<(max_y-min_y+1)<<" "<<(max_z-min_z+1)<<std::endl;
-            dvec3 origin=this->GetCenterCellCoordinates(ivec3(min_x, min_y, min_z));
+			xyzFile<<"DIMENSIONS "<<sizex<<" "<<sizey<<" "<<sizez<<std::endl;
 			xyzFile<<"ORIGIN "<<origin.x<<" "<<origin.y<<" "<<origin.z<<std::endl;
 			xyzFile<<"SPACING "<<volumeInfo.cellSize<<" "<<volumeInfo.cellSize<<" "<<volumeInfo.cellSize<<std::endl;
-			xyzFile<<"POINT_DATA "<<(max_x-min_x+1)*(max_y-min_y+1)*(max_z-min_z+1)<<std::endl;
-			xyzFile<<"SCALARS MATERIAL float"<<std::endl;
+			xyzFile<<"POINT_DATA "<<cellCount<<std::endl;
+			xyzFile<<"SCALARS MATERIAL "<<(format==EXPORT_VTK_ASCII ? "float" : "short")<<std::endl;
 			xyzFile<<"LOOKUP_TABLE default"<<std::endl;
+		}
 
-			progressOperation curProgress(exportProgressionInformation.GetMainOperation(),sizex);
+		progressOperation curProgress(exportProgressionInformation.GetMainOperation(),slabCount);
 
-			for(cell_id_t cell_z=min_z;cell_z<=max_z;cell_z++)
+		for(std::size_t batchBegin=0;batchBegin<slabCount;batchBegin+=workerCount)
+		{
+			const std::size_t batchEnd(MIN(slabCount,batchBegin+workerCount));
+			parallel_tools::ParallelFor(workerCount,batchBegin,batchEnd,[&](std::size_t slabBegin,std::size_t slabEnd,unsigned int)
 			{
-				curProgress.Next();
-				exportProgressionInformation.OutputCurrentProgression();
-				for(cell_id_t cell_y=min_y;cell_y<=max_y;cell_y++)
+				for(std::size_t idSlab=slabBegin;idSlab<slabEnd;idSlab++)
 				{
-					for(cell_id_t cell_x=min_x;cell_x<=max_x;cell_x++)
+					const std::size_t worker(idSlab-batchBegin);
+					const int zBegin(idSlab*slabDepth),zEnd(MIN(sizez,zBegin+slabDepth));
+					const std::size_t slabCellCount(sliceSize*(zEnd-zBegin));
+					std::vector<weight_t>& cells(slab[worker]);
+					DecodeBlockSlab(runs,blockOrigin,blockShape,zBegin,zEnd,&cells[0],&column[worker][0]);
+					if(swapBytes)
+					{
+						for(std::size_t idCell=0;idCell<slabCellCount;idCell++)
+						{
+							unsigned short value((unsigned short)cells[idCell]);
+							cells[idCell]=(weight_t)((value>>8) | (value<<8));
+						}
+					}
+					#ifdef __USE_ZLIB__
+					if(format==EXPORT_VTI_ZLIB)
 					{
-						SpatialDiscretization::weight_t cell_type=this->GetMatrixValue(ivec3(cell_x,cell_y,cell_z));
-                        xyzFile<< cell_type <<std::endl;
+						uLongf compressedSize(compressBound(slabCellCount*sizeof(weight_t)));
+						compressedSlab[worker].resize(compressedSize);
+						if(compress(&compressedSlab[worker][0],&compressedSize,(const Bytef*)&cells[0],slabCellCount*sizeof(weight_t))!=Z_OK)
+							throw std::runtime_error("zlib compression of the exported cells failed");
+						compressedSlab[worker].resize(compressedSize);
 					}
+					#endif
 				}
+			});
+			for(std::size_t idSlab=batchBegin;idSlab<batchEnd;idSlab++)
+			{
+				curProgress.Next();
+				if(showProgression)
+					exportProgressionInformation.OutputCurrentProgression();
+				const std::size_t worker(idSlab-batchBegin);
+				const int zBegin(idSlab*slabDepth),zEnd(MIN(sizez,zBegin+slabDepth));
+				const std::size_t slabCellCount(sliceSize*(zEnd-zBegin));
+				const std::vector<weight_t>& cells(slab[worker]);
+				if(format==EXPORT_VTK_ASCII)
+				{
+					for(std::size_t idCell=0;idCell<slabCellCount;idCell++)
+						xyzFile<<cells[idCell]<<'\n';
+				}else if(format==EXPORT_VTI_ZLIB)
+				{
+					compressionHeader[3+idSlab]=compressedSlab[worker].size();
+					xyzFile.write((const char*)&compressedSlab[worker][0],compressedSlab[worker].size());
+				}else
+					xyzFile.write((const char*)&cells[0],slabCellCount*sizeof(weight_t));
 			}
-
-		}else{
-			std::cerr<<"Nothing to export with theses parameters !"<<std::endl;
 		}
+		if(format==EXPORT_VTI_ZLIB)
+		{
+			std::streampos dataEnd(xyzFile.tellp());
+			xyzFile.seekp(compressionHeaderPos);
+			xyzFile.write((const char*)&compressionHeader[0],compressionHeader.size()*sizeof(unsigned long long));
+			xyzFile.seekp(dataEnd);
+		}
+		if(format==EXPORT_VTI || format==EXPORT_VTI_ZLIB)
+			xyzFile<<"\n  </AppendedData>\n</VTKFile>\n";
+		else if(format==EXPORT_VTK_BINARY)
+			xyzFile<<"\n";
 
 		xyzFile.close();
-
 	}
 
-	void ScalarFieldCreator::InitExteriorVolumeId()
+	void ScalarFieldCreator::ExportVTK(const std::string& filename,const SpatialDiscretization::weight_t& idVol,EXPORT_FORMAT format)
 	{
+		#ifndef __USE_ZLIB__
+		if(format==EXPORT_VTI_ZLIB)
+			throw std::invalid_argument("FastVoxel has been built without zlib, the compressed export is not available");
+		#endif
 		using namespace SpatialDiscretization;
-		//Pour chaque s�rie Z
-		// La premi�re et derni�re s�rie appartiendra au volume 2
-		cell_id_t cell_z=0;
-		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+
+		// RECHERCHE DES EXTREMAS
+		std::cout<<"Establishing volume bounding box"<<std::endl;
+		ivec3 blockOrigin,blockShape;
+		if(idVol!=-1)
 		{
-			for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+			GetVolumeBlock(idVol,1,blockOrigin,blockShape);
+		}else{
+			//All the surfaces
+			ivec3 min,max;
+			GetLabelRangeBoundaries(min,max,0,this->volumeInfo.maximal_marker_index);
+			if(max.x>min.x)
 			{
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-
-				if(currentCell->GetData()==emptyValue)
-					currentCell->SetData(weight_t(volumeInfo.maximal_marker_index+1));
-				do
-				{
-					if(!currentCell->IsNextCell() && currentCell->GetData()==emptyValue)
-						currentCell->SetData(weight_t(volumeInfo.maximal_marker_index+1));
-				}while(currentCell->Next(&currentCell));
-
+				blockOrigin=min;
+				blockShape=max-min;
 			}
 		}
+		if(blockShape.x>0)
+		{
+			std::cout<<"Write file."<<std::endl;
+			WriteVTKBlock(filename,blockOrigin,blockShape,format,threadCount,true);
+		}else{
+			std::cerr<<"Nothing to export with theses parameters !"<<std::endl;
+		}
+	}
 
+	/**
+	 * File name of an exported volume, the volume id is inserted before the extension
+	 */
+	static std::string GetVolumeFileName(const std::string& filename,const SpatialDiscretization::weight_t& idVol)
+	{
+		std::size_t extension(filename.find_last_of('.'));
+		std::size_t separator(filename.find_last_of("/\\"));
+		if(extension==std::string::npos || (separator!=std::string::npos && extension<separator))
+			extension=filename.size();
+		return filename.substr(0,extension)+"_"+std::to_string(idVol)+filename.substr(extension);
 	}
-	bool ScalarFieldCreator::CellToCellVolumePropagation(const ivec2& destinationPropa,const ivec2& sourcePropa,const SpatialDiscretization::weight_t& volumeId)
+
+	void ScalarFieldCreator::ExportVolumesVTK(const std::string& filename,const std::vector<SpatialDiscretization::weight_t>& volumeIds,EXPORT_FORMAT format)
 	{
+		#ifndef __USE_ZLIB__
+		if(format==EXPORT_VTI_ZLIB)
+			throw std::invalid_argument("FastVoxel has been built without zlib, the compressed export is not available");
+		#endif
 		using namespace SpatialDiscretization;
-		bool modification(false);
-		zcell* sourceCell=&((*this->fieldData)[sourcePropa.x][sourcePropa.y]);
-		zcell* destinationCell=&((*this->fieldData)[destinationPropa.x][destinationPropa.y]);
-		cell_id_t sourceZ(0),destinationZ(0);
-		do
+		//The blocks come from the labeling statistics, or from the run index that is built once for all the volumes
+		std::vector<ivec3> blockOrigin(volumeIds.size()),blockShape(volumeIds.size());
+		std::vector<std::size_t> exportedVolumes;
+		std::set<weight_t> scheduledIds;
+		for(std::size_t idVolume=0;idVolume<volumeIds.size();idVolume++)
+		{
+			if(volumeIds[idVolume]<0)
+				throw std::invalid_argument("Volume ids must not be negative, ExportVTK writes the whole domain");
+			//Two threads must not write the same file
+			if(!scheduledIds.insert(volumeIds[idVolume]).second)
+				continue;
+			GetVolumeBlock(volumeIds[idVolume],1,blockOrigin[idVolume],blockShape[idVolume]);
+			if(blockShape[idVolume].x>0)
+				exportedVolumes.push_back(idVolume);
+			else
+				std::cerr<<"Nothing to export for the volume "<<volumeIds[idVolume]<<std::endl;
+		}
+		GetRunMatrix();
+		//Files are written in parallel, the remaining threads decode the slabs of each file
+		const unsigned int totalThreadCount(parallel_tools::ResolveThreadCount(threadCount,(std::size_t)-1));
+		const unsigned int fileWorkerCount(parallel_tools::ResolveThreadCount(totalThreadCount,exportedVolumes.size()));
+		const unsigned int slabWorkerCount(MAX(1u,totalThreadCount/fileWorkerCount));
+		parallel_tools::ParallelFor(fileWorkerCount,0,exportedVolumes.size(),[&](std::size_t begin,std::size_t end,unsigned int)
 		{
-			if(sourceCell->GetData()==volumeId)
+			for(std::size_t idExport=begin;idExport<end;idExport++)
 			{
-				//On a trouv� une s�rie de Z correspondant � la valeur � �tendre
-				//On navigue jusqu'� la position de la source
-				while(destinationZ+destinationCell->GetSize()<sourceZ) //while(destinationZ<sourceZ)
-				{
-					destinationZ+=destinationCell->GetSize();
-					if(!destinationCell->Next(&destinationCell))
-						return modification;
-				}
-				//On affecte � partir de sourceZ jusqu'a sourceZ+sourceCell->GetSize() les noeuds dont la valeur est 0
-				//while(destinationZ>= sourceZ || destinationZ+destinationCell->GetSize()<=sourceZ+sourceCell->GetSize())
-				while(true)
-				{
-					if(destinationCell->GetData()==emptyValue)
-					{
-						destinationCell->SetData(volumeId);
-						modification=true;
-					}
-					//On avance si notre pointer est encore dans la cellule source
-					if(sourceZ+sourceCell->GetSize()>destinationZ+destinationCell->GetSize())	{
-
-						destinationZ+=destinationCell->GetSize();
-						if(!destinationCell->Next(&destinationCell))
-							return modification;
-					}else{
-						break;
-					}
-				}
+				const std::size_t idVolume(exportedVolumes[idExport]);
+				WriteVTKBlock(GetVolumeFileName(filename,volumeIds[idVolume]),blockOrigin[idVolume],blockShape[idVolume],format,slabWorkerCount,fileWorkerCount==1);
 			}
-			sourceZ+=sourceCell->GetSize();
-		}while(sourceCell->Next(&sourceCell));
-		return modification;
+		});
 	}
 
-    void ScalarFieldCreator::ComputeVolumesValue(std::vector<double_t>& volumeValue)
+	void ScalarFieldCreator::ExportNpy(const std::string& filename,const ivec3& origin,const ivec3& shape)
+	{
+		ExportNpyFiltered(filename,origin,shape,NULL,0);
+	}
+	void ScalarFieldCreator::ExportNpyFiltered(const std::string& filename,const ivec3& origin,const ivec3& shape,const SpatialDiscretization::weight_t* filter,int nIndex)
 	{
 		using namespace SpatialDiscretization;
-        volumeValue=std::vector<double_t>(this->volumeInfo.volumeCount,0.);
-        double_t cellVolume=pow(this->volumeInfo.cellSize, 3.);
-		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+		if(origin.x<0 || origin.y<0 || origin.z<0 || shape.x<0 || shape.y<0 || shape.z<0)
+			throw std::invalid_argument("The origin and the shape of the exported block must not be negative");
+		std::ofstream npyFile(filename.c_str(),std::ios_base::out | std::ios_base::binary);
+		if(!npyFile.is_open())
+			throw std::runtime_error("Can not write "+filename);
+		//Version 1.0 header, the magic string, the header length and the header are padded to 64 bytes
+		std::ostringstream header;
+		header<<"{'descr': '<i2', 'fortran_order': False, 'shape': ("<<shape.x<<", "<<shape.y<<", "<<shape.z<<"), }";
+		std::string headerText(header.str());
+		headerText.append(63-(10+headerText.size())%64,' ');
+		headerText.push_back('\n');
+		const unsigned short headerSize((unsigned short)headerText.size());
+		npyFile.write("\x93NUMPY\x01\x00",8);
+		npyFile.put((char)(headerSize & 0xFF));
+		npyFile.put((char)(headerSize>>8));
+		npyFile.write(headerText.c_str(),headerText.size());
+
+		const std::size_t planeSize((std::size_t)shape.y*shape.z);
+		if(planeSize>0 && shape.x>0)
 		{
-			for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+			const int size((int)volumeInfo.cellCount);
+			//Part of the block inside the domain, relative to the block origin
+			const ivec3 domainEnd(MAX(0,MIN(shape.x,size-origin.x)),MAX(0,MIN(shape.y,size-origin.y)),MAX(0,MIN(shape.z,size-origin.z)));
+			const RunMatrix& runs(GetRunMatrix());
+			//Slabs of about 1M cells, a batch of slabs is decoded in parallel then written in order
+			const int slabWidth(MIN(shape.x,MAX(1,(int)((1<<20)/planeSize))));
+			const std::size_t slabCount((shape.x+slabWidth-1)/slabWidth);
+			const unsigned int workerCount(parallel_tools::ResolveThreadCount(threadCount,slabCount));
+			std::vector<std::vector<weight_t> > slab(workerCount,std::vector<weight_t>(planeSize*slabWidth));
+			const bool swapBytes(!IsLittleEndian());
+			for(std::size_t batchBegin=0;batchBegin<slabCount;batchBegin+=workerCount)
 			{
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				do
+				const std::size_t batchEnd(MIN(slabCount,batchBegin+workerCount));
+				parallel_tools::ParallelFor(workerCount,batchBegin,batchEnd,[&](std::size_t slabBegin,std::size_t slabEnd,unsigned int)
+				{
+					for(std::size_t idSlab=slabBegin;idSlab<slabEnd;idSlab++)
+					{
+						const int xBegin(idSlab*slabWidth),xEnd(MIN(shape.x,xBegin+slabWidth));
+						const std::size_t slabCellCount(planeSize*(xEnd-xBegin));
+						std::vector<weight_t>& cells(slab[idSlab-batchBegin]);
+						std::fill(cells.begin(),cells.begin()+slabCellCount,emptyValue);
+						for(int i=xBegin;i<MIN(xEnd,domainEnd.x);i++)
+						{
+							for(int j=0;j<domainEnd.y;j++)
+							{
+								if(domainEnd.z>0)
+									runs.DecodeColumn(runs.ColumnIndex(origin.x+i,origin.y+j),origin.z,origin.z+domainEnd.z,&cells[cell_addr(i-xBegin,j,0,shape.y,shape.z)],filter,nIndex);
+							}
+						}
+						if(swapBytes)
+						{
+							for(std::size_t idCell=0;idCell<slabCellCount;idCell++)
+							{
+								unsigned short value((unsigned short)cells[idCell]);
+								cells[idCell]=(weight_t)((value>>8) | (value<<8));
+							}
+						}
+					}
+				});
+				for(std::size_t idSlab=batchBegin;idSlab<batchEnd;idSlab++)
 				{
-					SpatialDiscretization::weight_t cellValue((*currentCell).GetData()-this->volumeInfo.maximal_marker_index-1);
-					if(cellValue>=0)
-						volumeValue[cellValue]+=cellVolume*currentCell->GetSize();
-				}while(currentCell->Next(&currentCell));
+					const int xBegin(idSlab*slabWidth),xEnd(MIN(shape.x,xBegin+slabWidth));
+					npyFile.write((const char*)&slab[idSlab-batchBegin][0],planeSize*(xEnd-xBegin)*sizeof(weight_t));
+				}
 			}
 		}
+		if(!npyFile.good())
+			throw std::runtime_error("Error while writing "+filename);
 	}
-	ivec3 ScalarFieldCreator::GetFirstCellByWeight(const SpatialDiscretization::weight_t& weight,SpatialDiscretization::zcell** foundCell )
+
+	void ScalarFieldCreator::ExportChunks(const std::string& directory,const int& chunkSize)
 	{
 		using namespace SpatialDiscretization;
-		cell_id_t cell_z;
-		for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+		if(chunkSize<=0)
+			throw std::invalid_argument("The chunk size must be positive");
+		if(!file_tools::MakeDirectory(directory))
+			throw std::runtime_error("Can not create the directory "+directory);
+		#ifdef __USE_ZLIB__
+		const bool compressed(true);
+		#else
+		const bool compressed(false);
+		#endif
+		const int size((int)volumeInfo.cellCount);
+		const int chunkCount((size+chunkSize-1)/chunkSize);
+		const std::size_t totalChunkCount((std::size_t)chunkCount*chunkCount*chunkCount);
+		const RunMatrix& runs(GetRunMatrix());
+		const bool swapBytes(!IsLittleEndian());
+		const unsigned int workerCount(parallel_tools::ResolveThreadCount(threadCount,totalChunkCount));
+		//The index of a previous export would describe chunks that are being replaced
+		const std::string indexPath(directory+"/index.json");
+		if(std::remove(indexPath.c_str())!=0 && errno!=ENOENT)
+			throw std::runtime_error("Can not remove "+indexPath);
+		//Chunk files are independent, each thread decodes and writes its own range of chunks
+		parallel_tools::ParallelFor(workerCount,0,totalChunkCount,[&](std::size_t chunkBegin,std::size_t chunkEnd,unsigned int)
 		{
-			for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+			std::vector<weight_t> cells((std::size_t)chunkSize*chunkSize*chunkSize);
+			#ifdef __USE_ZLIB__
+			std::vector<unsigned char> compressedCells;
+			#endif
+			for(std::size_t idChunk=chunkBegin;idChunk<chunkEnd;idChunk++)
 			{
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
+				const ivec3 chunk(idChunk/((std::size_t)chunkCount*chunkCount),(idChunk/chunkCount)%chunkCount,idChunk%chunkCount);
+				const ivec3 chunkOrigin(chunk.x*chunkSize,chunk.y*chunkSize,chunk.z*chunkSize);
+				const ivec3 chunkShape(MIN(chunkSize,size-chunkOrigin.x),MIN(chunkSize,size-chunkOrigin.y),MIN(chunkSize,size-chunkOrigin.z));
+				const std::size_t cellCount((std::size_t)chunkShape.x*chunkShape.y*chunkShape.z);
+				for(int i=0;i<chunkShape.x;i++)
+				{
+					for(int j=0;j<chunkShape.y;j++)
+						runs.DecodeColumn(runs.ColumnIndex(chunkOrigin.x+i,chunkOrigin.y+j),chunkOrigin.z,chunkOrigin.z+chunkShape.z,&cells[cell_addr(i,j,0,chunkShape.y,chunkShape.z)]);
+				}
+				if(swapBytes)
 				{
-					if((*currentCell).GetData()==weight)
+					for(std::size_t idCell=0;idCell<cellCount;idCell++)
 					{
-						*foundCell=currentCell;
-						return ivec3(cell_x,cell_y,cell_z);
+						unsigned short value((unsigned short)cells[idCell]);
+						cells[idCell]=(weight_t)((value>>8) | (value<<8));
 					}
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
 				}
+				const char* chunkData((const char*)&cells[0]);
+				std::size_t chunkDataSize(cellCount*sizeof(weight_t));
+				#ifdef __USE_ZLIB__
+				uLongf compressedSize(compressBound(chunkDataSize));
+				compressedCells.resize(compressedSize);
+				if(compress(&compressedCells[0],&compressedSize,(const Bytef*)chunkData,chunkDataSize)!=Z_OK)
+					throw std::runtime_error("zlib compression of the exported cells failed");
+				chunkData=(const char*)&compressedCells[0];
+				chunkDataSize=compressedSize;
+				#endif
+				std::ostringstream chunkPath;
+				chunkPath<<directory<<"/"<<chunk.x<<"_"<<chunk.y<<"_"<<chunk.z<<".bin";
+				std::ofstream chunkFile(chunkPath.str().c_str(),std::ios_base::out | std::ios_base::binary);
+				chunkFile.write(chunkData,chunkDataSize);
+				if(!chunkFile.good())
+					throw std::runtime_error("Can not write "+chunkPath.str());
 			}
+		});
+		//Chunks of a previous export of a larger domain or with smaller chunks
+		const std::vector<std::string> chunkNames(file_tools::ListDirectory(directory,".bin"));
+		for(std::vector<std::string>::const_iterator itname=chunkNames.begin();itname!=chunkNames.end();itname++)
+		{
+			int chunkX,chunkY,chunkZ,nameLength(0);
+			if(sscanf(itname->c_str(),"%d_%d_%d.bin%n",&chunkX,&chunkY,&chunkZ,&nameLength)==3 && (std::size_t)nameLength==itname->size() &&
+				(chunkX>=chunkCount || chunkY>=chunkCount || chunkZ>=chunkCount))
+				std::remove((directory+"/"+*itname).c_str());
 		}
-		*foundCell=NULL;
-		return ivec3();
+		//The old index is removed first and the new one written last, an interrupted export has no index
+		std::ofstream indexFile(indexPath.c_str(),std::ios_base::out);
+		if(!indexFile.is_open())
+			throw std::runtime_error("Can not write "+indexPath);
+		const dvec3 origin(GetCenterCellCoordinates(ivec3(0,0,0)));
+		indexFile.precision(17);
+		indexFile<<"{\n";
+		indexFile<<"  \"format\": \"fastvoxel-chunks\",\n";
+		indexFile<<"  \"version\": 1,\n";
+		indexFile<<"  \"shape\": ["<<size<<", "<<size<<", "<<size<<"],\n";
+		indexFile<<"  \"chunk_shape\": ["<<chunkSize<<", "<<chunkSize<<", "<<chunkSize<<"],\n";
+		indexFile<<"  \"dtype\": \"<i2\",\n";
+		indexFile<<"  \"order\": \"C\",\n";
+		indexFile<<"  \"compression\": \""<<(compressed ? "zlib" : "none")<<"\",\n";
+		indexFile<<"  \"chunk_file\": \"{0}_{1}_{2}.bin\",\n";
+		indexFile<<"  \"origin\": ["<<origin.x<<", "<<origin.y<<", "<<origin.z<<"],\n";
+		indexFile<<"  \"cell_size\": "<<volumeInfo.cellSize<<",\n";
+		indexFile<<"  \"first_volume_index\": "<<GetFirstVolumeIndex()<<"\n";
+		indexFile<<"}\n";
+		if(!indexFile.good())
+			throw std::runtime_error("Error while writing "+indexPath);
 	}
 
-    ivec3 ScalarFieldCreator::GetCellIdByCoord(const dvec3& position)
+	/**
+	 * Header of the .fvx files, followed by the sections aligned on 8 bytes:
+	 * column offsets (UInt64), run ends (UInt32), run values (Int16), surface run values (Int16), label statistics (fvxLabelStatistics_t).
+	 * Values are in the byte order of the writer, the byteOrderMark tells it.
+	 */
+	struct fvxHeader_t
 	{
-        dvec3 tmpvec=((position-this->volumeInfo.mainVolumeCenter)/this->volumeInfo.cellSize);
-		ivec3 halfCellCount(this->volumeInfo.cellCount/2,this->volumeInfo.cellCount/2,this->volumeInfo.cellCount/2);
-		return ivec3((long)floor(tmpvec.x),(long)floor(tmpvec.y),(long)floor(tmpvec.z))+halfCellCount;
+		char magic[8];
+		unsigned int version;
+		unsigned int byteOrderMark;
+		double resolution;
+		double cellSize;
+		double mainVolumeCenter[3];
+		double cellHalfSize[3];
+		double zeroCellCenter[3];
+		double boxMin[3];
+		double boxMax[3];
+		unsigned int cellCount;
+		short volumeCount;
+		short maximalMarkerIndex;
+		unsigned long long offsetCount;
+		unsigned long long runCount;
+		unsigned long long surfaceRunCount;
+		unsigned long long labelCount;
+		unsigned long long mergedVolumeCount;
+		unsigned long long parityFallbackColumnCount;
+	};
+	struct fvxLabelStatistics_t
+	{
+		unsigned long long cellCount;
+		unsigned long long boundaryFaceCount;
+		long long cellMin[3];
+		long long cellMax[3];
+		double cellSum[3];
+	};
+	static const char fvxMagic[8]={'F','V','X','F','I','E','L','D'};
+	static const unsigned int fvxVersion=2; //2: labeling counters
+	static const unsigned int fvxByteOrderMark=0x01020304;
+
+	inline std::size_t FvxAlign(const std::size_t& offset)
+	{
+		return (offset+7)&~(std::size_t)7;
 	}
-	void ScalarFieldCreator::ExtandVolume(const SpatialDiscretization::weight_t& volumeId)
+	/**
+	 * Offset of each section of a .fvx file, the last one is the file size
+	 */
+	static void FvxSections(const fvxHeader_t& header,std::size_t sectionOffset[6])
 	{
-		long neighLink[4][2]={{0,1},
-							  {1,0},
-		                      {0,-1},
-			                  {-1,0} };
+		sectionOffset[0]=FvxAlign(sizeof(fvxHeader_t));
+		sectionOffset[1]=FvxAlign(sectionOffset[0]+header.offsetCount*sizeof(unsigned long long));
+		sectionOffset[2]=FvxAlign(sectionOffset[1]+header.runCount*sizeof(SpatialDiscretization::cell_id_t));
+		sectionOffset[3]=FvxAlign(sectionOffset[2]+header.runCount*sizeof(SpatialDiscretization::weight_t));
+		sectionOffset[4]=FvxAlign(sectionOffset[3]+header.surfaceRunCount*sizeof(SpatialDiscretization::weight_t));
+		sectionOffset[5]=sectionOffset[4]+header.labelCount*sizeof(fvxLabelStatistics_t);
+	}
+	template<typename T>
+	static void FvxWriteSection(std::ostream& stream,const T* values,const std::size_t& count,const std::size_t& sectionEnd)
+	{
+		if(count>0)
+			stream.write((const char*)values,count*sizeof(T));
+		static const char padding[8]={0,0,0,0,0,0,0,0};
+		std::size_t position((std::size_t)stream.tellp());
+		if(sectionEnd>position)
+			stream.write(padding,sectionEnd-position);
+	}
 
-		using namespace SpatialDiscretization;
-		std::size_t sizeOfMatrixXY(this->volumeInfo.cellCount*this->volumeInfo.cellCount);
-		PTR_ARR<bool> cellsToCheck(new bool[sizeOfMatrixXY]); //Matrice X,Y de bool�en indiquant les cellules � v�rifier dans le cycle courant
-		PTR_ARR<bool> NextCellsToCheck(new bool[sizeOfMatrixXY]); //Matrice X,Y de bool�en indiquant les cellules � v�rifier lors du prochain cycle.
-		memset(cellsToCheck.get(),1,sizeof(bool)*sizeOfMatrixXY);
-		memset(NextCellsToCheck.get(),0,sizeof(bool)*sizeOfMatrixXY);
-		bool moreCellsToCheck(true); //Si sur un cycle de test aucune cellule ne s'est vu modifi� alors le volume volumeId est compl�tement d�fini
-		do
+	/**
+	 * Check that each column has runs, in order, that cover exactly [0,cellCount[. Columns are checked by chunks in parallel.
+	 */
+	static bool IsValidFvxRuns(const unsigned long long* columnOffset,const SpatialDiscretization::cell_id_t* runEnd,const fvxHeader_t& header,const unsigned int& threadCount)
+	{
+		if(columnOffset[0]!=0 || columnOffset[header.offsetCount-1]!=header.runCount)
+			return false;
+		const std::size_t columnCount((std::size_t)header.offsetCount-1);
+		const unsigned int chunkCount(parallel_tools::ResolveThreadCount(threadCount,columnCount));
+		std::vector<char> chunkValid(chunkCount,1);
+		parallel_tools::ParallelFor(chunkCount,0,columnCount,[&](std::size_t columnBegin,std::size_t columnEnd,unsigned int chunk)
 		{
-			moreCellsToCheck=false;
-			cell_id_t cellXY;
-			for(cell_id_t cell_x=0;cell_x<volumeInfo.cellCount;cell_x++)
+			for(std::size_t column=columnBegin;column<columnEnd;column++)
 			{
-				for(cell_id_t cell_y=0;cell_y<volumeInfo.cellCount;cell_y++)
+				//A column ends at cellCount so it can not be empty, the offsets increase
+				if(columnOffset[column+1]<=columnOffset[column] || columnOffset[column+1]>header.runCount)
 				{
-
-					cellXY=At(cell_x,cell_y,this->volumeInfo.cellCount);
-					if(cellsToCheck[cellXY]==true)
+					chunkValid[chunk]=0;
+					return;
+				}
+				SpatialDiscretization::cell_id_t runBegin(0);
+				for(unsigned long long idRun=columnOffset[column];idRun<columnOffset[column+1];idRun++)
+				{
+					if(runEnd[idRun]<=runBegin)
 					{
-
-						ivec2 currentid(cell_x,cell_y);
-						/////////////////////////////
-						// En fonction des [2-4] voisins nous allons propager les identifiants de la s�rie.
-						bool destCellUpdated(false);
-						for(unsigned short neigh=0;neigh<4;neigh++)
-						{
-							ivec2 FromXY=ivec2(neighLink[neigh])+currentid;
-							if((unsigned int)FromXY.x>=0 && (unsigned int)FromXY.x<this->volumeInfo.cellCount && (unsigned int)FromXY.y>=0 && (unsigned int)FromXY.y<this->volumeInfo.cellCount)
-							{
-								cell_id_t neighXY=At(FromXY.x,FromXY.y,this->volumeInfo.cellCount);
-								if(CellToCellVolumePropagation(currentid,FromXY,volumeId))
-									destCellUpdated=true;
-							}
-						}
-
-						if(destCellUpdated) //Cellule de destination modifi�, toute les cellule voisines doivent �tre marqu� comme � subir une propagation
-						{
-							moreCellsToCheck=true;
-							for(unsigned short neigh=0;neigh<4;neigh++)
-							{
-								ivec2 FromXY=ivec2(neighLink[neigh])+currentid;
-								if((unsigned int)FromXY.x>=0 && (unsigned int)FromXY.x<this->volumeInfo.cellCount && (unsigned int)FromXY.y>=0 && (unsigned int)FromXY.y<this->volumeInfo.cellCount)
-								{
-									cell_id_t neighXY=At(FromXY.x,FromXY.y,this->volumeInfo.cellCount);
-									NextCellsToCheck[neighXY]=true;
-								}
-							}
-						}
+						chunkValid[chunk]=0;
+						return;
 					}
+					runBegin=runEnd[idRun];
+				}
+				if(runBegin!=header.cellCount)
+				{
+					chunkValid[chunk]=0;
+					return;
 				}
 			}
-			memcpy(cellsToCheck.get(),NextCellsToCheck.get(),sizeof(bool)*sizeOfMatrixXY);
-			memset(NextCellsToCheck.get(),0,sizeof(bool)*sizeOfMatrixXY);
-		}while(moreCellsToCheck);
+		});
+		return std::find(chunkValid.begin(),chunkValid.end(),0)==chunkValid.end();
 	}
 
+	void ScalarFieldCreator::Save(const std::string& path)
+	{
+		std::ofstream fvxFile(path.c_str(),std::ios_base::out | std::ios_base::binary);
+		if(!fvxFile.is_open())
+			throw std::runtime_error("Can not write "+path);
+		Save(fvxFile);
+		if(!fvxFile.good())
+			throw std::runtime_error("Error while writing "+path);
+	}
+	void ScalarFieldCreator::Save(std::ostream& stream)
+	{
+		using namespace SpatialDiscretization;
+		const RunMatrix& runs(GetRunMatrix());
+		fvxHeader_t header;
+		memset(&header,0,sizeof(header));
+		memcpy(header.magic,fvxMagic,sizeof(fvxMagic));
+		header.version=fvxVersion;
+		header.byteOrderMark=fvxByteOrderMark;
+		header.resolution=this->resolution;
+		header.cellSize=this->volumeInfo.cellSize;
+		for(int axis=0;axis<3;axis++)
+		{
+			header.mainVolumeCenter[axis]=this->volumeInfo.mainVolumeCenter[axis];
+			header.cellHalfSize[axis]=this->volumeInfo.cellHalfSize[axis];
+			header.zeroCellCenter[axis]=this->volumeInfo.zeroCellCenter[axis];
+			header.boxMin[axis]=this->volumeInfo.boxMin[axis];
+			header.boxMax[axis]=this->volumeInfo.boxMax[axis];
+		}
+		header.cellCount=this->volumeInfo.cellCount;
+		header.volumeCount=this->volumeInfo.volumeCount;
+		header.maximalMarkerIndex=this->volumeInfo.maximal_marker_index;
+		header.offsetCount=runs.columnOffset.size();
+		header.runCount=runs.GetRunCount();
+		header.surfaceRunCount=HasSurfaceRuns(runs) ? this->surfaceRunData.size() : 0;
+		header.labelCount=this->volumeInfo.labelStatistics.size();
+		header.mergedVolumeCount=this->mergedVolumeCount;
+		header.parityFallbackColumnCount=this->parityFallbackColumnCount;
+		std::size_t sectionOffset[6];
+		FvxSections(header,sectionOffset);
+		const std::size_t streamStart((std::size_t)stream.tellp());
+		for(int idSection=0;idSection<6;idSection++)
+			sectionOffset[idSection]+=streamStart;
+		FvxWriteSection(stream,&header,1,sectionOffset[0]);
+		if(sizeof(std::size_t)==sizeof(unsigned long long))
+			FvxWriteSection(stream,(const unsigned long long*)runs.columnOffset.begin(),runs.columnOffset.size(),sectionOffset[1]);
+		else
+		{
+			std::vector<unsigned long long> columnOffset(runs.columnOffset.begin(),runs.columnOffset.end());
+			FvxWriteSection(stream,columnOffset.empty() ? NULL : &columnOffset[0],columnOffset.size(),sectionOffset[1]);
+		}
+		FvxWriteSection(stream,runs.runEnd.begin(),runs.runEnd.size(),sectionOffset[2]);
+		FvxWriteSection(stream,runs.runData.begin(),runs.runData.size(),sectionOffset[3]);
+		FvxWriteSection(stream,this->surfaceRunData.begin(),(std::size_t)header.surfaceRunCount,sectionOffset[4]);
+		std::vector<fvxLabelStatistics_t> statistics(this->volumeInfo.labelStatistics.size());
+		for(std::size_t label=0;label<statistics.size();label++)
+		{
+			const labelStatistics_t& labelStats(this->volumeInfo.labelStatistics[label]);
+			statistics[label].cellCount=labelStats.cellCount;
+			statistics[label].boundaryFaceCount=labelStats.boundaryFaceCount;
+			for(int axis=0;axis<3;axis++)
+			{
+				statistics[label].cellMin[axis]=labelStats.cellMin.i[axis];
+				statistics[label].cellMax[axis]=labelStats.cellMax.i[axis];
+				statistics[label].cellSum[axis]=labelStats.cellSum[axis];
+			}
+		}
+		FvxWriteSection(stream,statistics.empty() ? NULL : &statistics[0],statistics.size(),sectionOffset[5]);
+	}
+	void ScalarFieldCreator::Load(const std::string& path)
+	{
+		LoadMapping(PTR<file_tools::FileMapping>(new file_tools::FileMapping(path)));
+	}
+	std::size_t ScalarFieldCreator::GetSerializedSize()
+	{
+		const SpatialDiscretization::RunMatrix& runs(GetRunMatrix());
+		fvxHeader_t header;
+		memset(&header,0,sizeof(header));
+		header.offsetCount=runs.columnOffset.size();
+		header.runCount=runs.GetRunCount();
+		header.surfaceRunCount=HasSurfaceRuns(runs) ? this->surfaceRunData.size() : 0;
+		header.labelCount=this->volumeInfo.labelStatistics.size();
+		std::size_t sectionOffset[6];
+		FvxSections(header,sectionOffset);
+		return sectionOffset[5];
+	}
+	void ScalarFieldCreator::Serialize(unsigned char* data,long long size)
+	{
+		if(size<0 || (unsigned long long)size!=(unsigned long long)GetSerializedSize())
+			throw std::invalid_argument("The buffer must have GetSerializedSize() bytes");
+		std::ostringstream stream(std::ios_base::out | std::ios_base::binary);
+		Save(stream);
+		const std::string content(stream.str());
+		memcpy(data,content.data(),content.size());
+	}
+	void ScalarFieldCreator::Deserialize(const unsigned char* data,long long size)
+	{
+		if(size<0 || (unsigned long long)size>(unsigned long long)SIZE_MAX)
+			throw std::invalid_argument("Invalid size of the serialized field");
+		LoadMapping(PTR<file_tools::FileMapping>(new file_tools::FileMapping((const char*)data,(std::size_t)size)));
+	}
+	void ScalarFieldCreator::LoadMapping(const PTR<file_tools::FileMapping>& mapping)
+	{
+		using namespace SpatialDiscretization;
+		char* data(mapping->GetData());
+		fvxHeader_t header;
+		if(mapping->GetSize()<sizeof(header))
+			throw std::runtime_error("Not a FastVoxel field, the data is too short");
+		memcpy(&header,data,sizeof(header));
+		if(memcmp(header.magic,fvxMagic,sizeof(fvxMagic))!=0)
+			throw std::runtime_error("Not a FastVoxel field");
+		if(header.version!=fvxVersion || header.byteOrderMark!=fvxByteOrderMark)
+			throw std::runtime_error("Unsupported FastVoxel field version or byte order");
+		//The counts are bounded by the data size first, so the section offsets can not overflow
+		const std::size_t dataSize(mapping->GetSize());
+		if(header.offsetCount>dataSize/sizeof(unsigned long long) || header.runCount>dataSize/sizeof(cell_id_t) || header.labelCount>dataSize/sizeof(fvxLabelStatistics_t))
+			throw std::runtime_error("Corrupted FastVoxel field, the sections do not fit in the data");
+		if(header.surfaceRunCount!=0 && header.surfaceRunCount!=header.runCount)
+			throw std::runtime_error("Corrupted FastVoxel field, the surface runs do not match the runs");
+		if(header.cellCount==0 || header.offsetCount!=(unsigned long long)header.cellCount*header.cellCount+1)
+			throw std::runtime_error("Corrupted FastVoxel field, the column count does not match the domain size");
+		std::size_t sectionOffset[6];
+		FvxSections(header,sectionOffset);
+		if(dataSize<sectionOffset[5])
+			throw std::runtime_error("Corrupted FastVoxel field, the sections do not fit in the data");
+		const unsigned long long* columnOffset((const unsigned long long*)(data+sectionOffset[0]));
+		if(!IsValidFvxRuns(columnOffset,(const cell_id_t*)(data+sectionOffset[1]),header,threadCount))
+			throw std::runtime_error("Corrupted FastVoxel field, invalid runs");
+		//Same state as after FirstStep_Params and the labeling, without the matrix
+		ClearLabeling();
+		this->fieldData=PTR<weight_matrix>();
+		this->resolution=header.resolution;
+		this->volumeInfo.cellSize=header.cellSize;
+		for(int axis=0;axis<3;axis++)
+		{
+			this->volumeInfo.mainVolumeCenter[axis]=header.mainVolumeCenter[axis];
+			this->volumeInfo.cellHalfSize[axis]=header.cellHalfSize[axis];
+			this->volumeInfo.zeroCellCenter[axis]=header.zeroCellCenter[axis];
+			this->volumeInfo.boxMin[axis]=header.boxMin[axis];
+			this->volumeInfo.boxMax[axis]=header.boxMax[axis];
+		}
+		this->volumeInfo.cellCount=header.cellCount;
+		this->volumeInfo.volumeCount=header.volumeCount;
+		this->volumeInfo.maximal_marker_index=header.maximalMarkerIndex;
+		this->mergedVolumeCount=(std::size_t)header.mergedVolumeCount;
+		this->parityFallbackColumnCount=(std::size_t)header.parityFallbackColumnCount;
+		this->domainInformation.domainSize=header.cellCount;
+		this->domainInformation.weight=0;
+		PTR<RunMatrix> runs(new RunMatrix());
+		runs->size=header.cellCount;
+		if(sizeof(std::size_t)==sizeof(unsigned long long))
+			runs->columnOffset.Map(mapping,(std::size_t*)(data+sectionOffset[0]),(std::size_t)header.offsetCount);
+		else
+			runs->columnOffset=std::vector<std::size_t>(columnOffset,columnOffset+header.offsetCount);
+		runs->runEnd.Map(mapping,(cell_id_t*)(data+sectionOffset[1]),(std::size_t)header.runCount);
+		runs->runData.Map(mapping,(weight_t*)(data+sectionOffset[2]),(std::size_t)header.runCount);
+		if(header.surfaceRunCount>0)
+		{
+			this->surfaceRunData.Map(mapping,(weight_t*)(data+sectionOffset[3]),(std::size_t)header.surfaceRunCount);
+			this->surfaceRunLayout=RunLayoutChecksum(*runs);
+		}
+		this->labeledField=true;
+		const fvxLabelStatistics_t* statistics((const fvxLabelStatistics_t*)(data+sectionOffset[4]));
+		this->volumeInfo.labelStatistics.resize((std::size_t)header.labelCount);
+		for(std::size_t label=0;label<this->volumeInfo.labelStatistics.size();label++)
+		{
+			labelStatistics_t& labelStats(this->volumeInfo.labelStatistics[label]);
+			labelStats.cellCount=(std::size_t)statistics[label].cellCount;
+			labelStats.boundaryFaceCount=(std::size_t)statistics[label].boundaryFaceCount;
+			for(int axis=0;axis<3;axis++)
+			{
+				labelStats.cellMin.i[axis]=(long)statistics[label].cellMin[axis];
+				labelStats.cellMax.i[axis]=(long)statistics[label].cellMax[axis];
+				labelStats.cellSum[axis]=statistics[label].cellSum[axis];
+			}
+		}
+		ComputeVolumesValue(this->volumeInfo.volumeValue);
+		SetRunMatrix(runs);
+	}
+	SpatialDiscretization::weight_matrix& ScalarFieldCreator::GetFieldData()
+	{
+		using namespace SpatialDiscretization;
+		if(!this->fieldData.get())
+		{
+			if(!this->runMatrix.get())
+				throw std::runtime_error("The matrix is not initialized, FirstStep_Params or Load must be called first");
+			PTR<weight_matrix> matrix(new weight_matrix(domainInformation));
+			this->runMatrix->Expand(*matrix,domainInformation,parallel_tools::ResolveThreadCount(threadCount,volumeInfo.cellCount));
+			this->fieldData=matrix;
+		}
+		return *this->fieldData;
+	}
+
+    void ScalarFieldCreator::ComputeVolumesValue(std::vector<double_t>& volumeValue)
+	{
+        volumeValue=std::vector<double_t>(this->volumeInfo.volumeCount,0.);
+        double_t cellVolume=pow(this->volumeInfo.cellSize, 3.);
+		std::size_t exteriorId(this->volumeInfo.maximal_marker_index+1);
+		for(std::size_t volId=0;volId<volumeValue.size() && exteriorId+volId<this->volumeInfo.labelStatistics.size();volId++)
+			volumeValue[volId]=cellVolume*this->volumeInfo.labelStatistics[exteriorId+volId].cellCount;
+	}
+    ivec3 ScalarFieldCreator::GetCellIdByCoord(const dvec3& position)
+	{
+        dvec3 tmpvec=((position-this->volumeInfo.mainVolumeCenter)/this->volumeInfo.cellSize);
+		ivec3 halfCellCount(this->volumeInfo.cellCount/2,this->volumeInfo.cellCount/2,this->volumeInfo.cellCount/2);
+		return ivec3((long)floor(tmpvec.x),(long)floor(tmpvec.y),(long)floor(tmpvec.z))+halfCellCount;
+	}
+    void ScalarFieldCreator::QueryPoints(const double* points,int pointCount,int pointDim,int* cells,int cellCount,int cellDim,SpatialDiscretization::weight_t* labels,int labelCount)
+    {
+		using namespace SpatialDiscretization;
+		if(pointDim!=3 || cellDim!=3)
+			throw std::invalid_argument("The points and cells arrays must have 3 columns");
+		if(cellCount!=pointCount || labelCount!=pointCount)
+			throw std::invalid_argument("There must be one cell and one label per point");
+		const std::size_t count(MAX(pointCount,0));
+		//The runs stay alive if the field is labeled again by another thread meanwhile
+		PTR<RunMatrix> sharedRuns(GetSharedRunMatrix());
+		const RunMatrix& runs(*sharedRuns);
+		const cell_id_t size(volumeInfo.cellCount);
+		//Sort key of the points in the domain: column then Z
+		const unsigned long long outsideKey(ULLONG_MAX);
+		std::vector<unsigned long long> pointKey(count);
+		const std::size_t minimalChunkSize(1<<12);
+		parallel_tools::ParallelFor(parallel_tools::ResolveThreadCount(threadCount,count/minimalChunkSize+1),0,count,[&](std::size_t begin,std::size_t end,unsigned int)
+		{
+			for(std::size_t idPoint=begin;idPoint<end;idPoint++)
+			{
+				const ivec3 cell(GetCellIdByCoord(dvec3(points[idPoint*3],points[idPoint*3+1],points[idPoint*3+2])));
+				cells[idPoint*3]=(int)cell.a;
+				cells[idPoint*3+1]=(int)cell.b;
+				cells[idPoint*3+2]=(int)cell.c;
+				if(cell.a>=0 && cell.b>=0 && cell.c>=0 && cell.a<(long)size && cell.b<(long)size && cell.c<(long)size)
+					pointKey[idPoint]=((unsigned long long)runs.ColumnIndex(cell.a,cell.b))*size+cell.c;
+				else
+				{
+					pointKey[idPoint]=outsideKey;
+					labels[idPoint]=emptyValue;
+				}
+			}
+		});
+		//Points bucketed by X
+		std::vector<std::size_t> xOffset((std::size_t)size+1,0);
+		for(std::size_t idPoint=0;idPoint<count;idPoint++)
+		{
+			if(pointKey[idPoint]!=outsideKey)
+				xOffset[cells[idPoint*3]+1]++;
+		}
+		for(cell_id_t cell_x=0;cell_x<size;cell_x++)
+			xOffset[cell_x+1]+=xOffset[cell_x];
+		std::vector<unsigned int> pointOrder(xOffset[size]);
+		{
+			std::vector<std::size_t> xFill(xOffset.begin(),xOffset.end()-1);
+			for(std::size_t idPoint=0;idPoint<count;idPoint++)
+			{
+				if(pointKey[idPoint]!=outsideKey)
+					pointOrder[xFill[cells[idPoint*3]]++]=(unsigned int)idPoint;
+			}
+		}
+		//Each slab of X sorts its points and walks the runs of each column once
+		const unsigned int slabCount(pointOrder.size()<minimalChunkSize ? 1 : parallel_tools::ResolveThreadCount(threadCount,size));
+		parallel_tools::ParallelFor(slabCount,0,size,[&](std::size_t xBegin,std::size_t xEnd,unsigned int)
+		{
+			for(std::size_t cell_x=xBegin;cell_x<xEnd;cell_x++)
+				std::sort(pointOrder.begin()+xOffset[cell_x],pointOrder.begin()+xOffset[cell_x+1],[&](unsigned int first,unsigned int second){ return pointKey[first]<pointKey[second]; });
+			for(std::size_t idOrder=xOffset[xBegin];idOrder<xOffset[xEnd];)
+			{
+				const std::size_t column((std::size_t)(pointKey[pointOrder[idOrder]]/size));
+				std::size_t idRun(runs.FindRun(column,(cell_id_t)(pointKey[pointOrder[idOrder]]%size)));
+				for(;idOrder<xOffset[xEnd] && pointKey[pointOrder[idOrder]]/size==column;idOrder++)
+				{
+					const cell_id_t cell_z((cell_id_t)(pointKey[pointOrder[idOrder]]%size));
+					while(runs.runEnd[idRun]<=cell_z)
+						idRun++;
+					labels[pointOrder[idOrder]]=runs.runData[idRun];
+				}
+			}
+		});
+    }
     dvec3 ScalarFieldCreator::GetCenterCellCoordinates( const ivec3& cell_id) const
 	{
 		return CellIdToCenterCoordinate(cell_id,this->volumeInfo.cellSize, this->volumeInfo.zeroCellCenter);
@@ -615,7 +1547,9 @@ namespace ScalarFieldBuilders
 	    if (index.x < this->volumeInfo.cellCount &&
 	        index.y < this->volumeInfo.cellCount &&
 	        index.z < this->volumeInfo.cellCount) {
-		    return (*this->fieldData)[index.x][index.y][index.z];
+		    if(this->runMatrix.get())
+		        return this->runMatrix->GetValue(index.x,index.y,index.z);
+		    return GetFieldData()[index.x][index.y][index.z];
 	    }
 	    throw std::out_of_range(
 		    "Requested index (x: " + std::to_string(index.x) +
@@ -629,109 +1563,734 @@ namespace ScalarFieldBuilders
     }
 
     void ScalarFieldCreator::CopyMatrix(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos)
+    {
+		CopyMatrixFiltered(data,ni,nj,nk,extractPos,NULL,0);
+    }
+    void ScalarFieldCreator::CopyMatrixFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos,const SpatialDiscretization::weight_t* data_filter,int nindex )
     {
         ivec3 extractPosEnd(MIN(ni+extractPos.a,volumeInfo.cellCount),MIN(nj+extractPos.b,volumeInfo.cellCount),MIN(nk+extractPos.c,volumeInfo.cellCount));
 		using namespace SpatialDiscretization;
-		cell_id_t cell_z=0;
-		int i,j,k;
-		for(cell_id_t cell_x=extractPos.a;cell_x<extractPosEnd.a;cell_x++)
+		if(extractPos.c>=extractPosEnd.c || extractPos.a>=extractPosEnd.a)
+			return;
+		const RunMatrix& runs(GetRunMatrix());
+		//Each X plane of the destination is written by one thread, the runs are clipped and filled once per column
+		const std::size_t planeCount(extractPosEnd.a-extractPos.a);
+		const std::size_t planeSize((std::size_t)MAX(extractPosEnd.b-extractPos.b,0)*(extractPosEnd.c-extractPos.c));
+		const unsigned int workerCount(planeSize<(1<<16) ? 1 : parallel_tools::ResolveThreadCount(threadCount,planeCount));
+		parallel_tools::ParallelFor(workerCount,extractPos.a,extractPosEnd.a,[&](std::size_t xBegin,std::size_t xEnd,unsigned int)
 		{
-		    i=cell_x-extractPos.a;
-			for(cell_id_t cell_y=extractPos.b;cell_y<extractPosEnd.b;cell_y++)
+			for(cell_id_t cell_x=xBegin;cell_x<xEnd;cell_x++)
 			{
-			    j=cell_y-extractPos.b;
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
+				for(cell_id_t cell_y=extractPos.b;cell_y<(cell_id_t)extractPosEnd.b;cell_y++)
 				{
-				    //Todo optimize with memset
-				    const SpatialDiscretization::weight_t &cell_data(currentCell->GetData());
-				    std::size_t cellsize=currentCell->GetSize();
-				    if(cell_z+currentCell->GetSize()>extractPos.c)
-				    {
-                        for(cell_id_t cell_z_offset=0;cell_z_offset<cellsize;cell_z_offset++)
-                        {
-                            if(cell_z+cell_z_offset<extractPosEnd.c)
-                            {
-                                k=cell_z+cell_z_offset-extractPos.c;
-                                if(k>=0)
-                                    data[cell_addr(i,j,k,nj,nk)]=cell_data;
-                            }else{
-                                break;
-                                break;
-                            }
-                        }
-				    }
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
+					weight_t* column(data+cell_addr(cell_x-extractPos.a,cell_y-extractPos.b,0,nj,nk));
+					runs.DecodeColumn(runs.ColumnIndex(cell_x,cell_y),extractPos.c,extractPosEnd.c,column,data_filter,nindex);
 				}
 			}
+		});
+    }
+    void ScalarFieldCreator::CopyMatrixStrided(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& start,const ivec3& step)
+    {
+		CopyMatrixStridedFiltered(data,ni,nj,nk,start,step,NULL,0);
+    }
+    void ScalarFieldCreator::CopyMatrixStridedFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& start,const ivec3& step,const SpatialDiscretization::weight_t* data_filter,int nindex)
+    {
+		const int count[3]={ni,nj,nk};
+		std::vector<int> index[3];
+		for(int axis=0;axis<3;axis++)
+		{
+			if(step.i[axis]==0)
+				throw std::invalid_argument("The step must not be zero");
+			index[axis].resize(MAX(count[axis],0));
+			for(int idCell=0;idCell<count[axis];idCell++)
+				index[axis][idCell]=start.i[axis]+idCell*step.i[axis];
 		}
+		if(ni>0 && nj>0 && nk>0)
+			CopyMatrixIndexedFiltered(data,ni,nj,nk,&index[0][0],ni,&index[1][0],nj,&index[2][0],nk,data_filter,nindex);
     }
-    void ScalarFieldCreator::CopyMatrixFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos,const SpatialDiscretization::weight_t* data_filter,int nindex )
+    void ScalarFieldCreator::CopyMatrixIndexed(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const int* xIndex,int nx,const int* yIndex,int ny,const int* zIndex,int nz)
+    {
+		CopyMatrixIndexedFiltered(data,ni,nj,nk,xIndex,nx,yIndex,ny,zIndex,nz,NULL,0);
+    }
+    void ScalarFieldCreator::CopyMatrixIndexedFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const int* xIndex,int nx,const int* yIndex,int ny,const int* zIndex,int nz,const SpatialDiscretization::weight_t* data_filter,int nindex)
     {
-        ivec3 extractPosEnd(MIN(ni+extractPos.a,volumeInfo.cellCount),MIN(nj+extractPos.b,volumeInfo.cellCount),MIN(nk+extractPos.c,volumeInfo.cellCount));
 		using namespace SpatialDiscretization;
-		cell_id_t cell_z=0;
-		int i,j,k;
-		for(cell_id_t cell_x=extractPos.a;cell_x<extractPosEnd.a;cell_x++)
+		if(nx!=ni || ny!=nj || nz!=nk)
+			throw std::invalid_argument("The index arrays must have the sizes of the destination axes");
+		const int* index[3]={xIndex,yIndex,zIndex};
+		const int count[3]={nx,ny,nz};
+		for(int axis=0;axis<3;axis++)
 		{
-		    i=cell_x-extractPos.a;
-			for(cell_id_t cell_y=extractPos.b;cell_y<extractPosEnd.b;cell_y++)
+			for(int idCell=0;idCell<count[axis];idCell++)
 			{
-			    j=cell_y-extractPos.b;
-				cell_z=0;
-				zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
-				while(currentCell)
+				if(index[axis][idCell]<0 || index[axis][idCell]>=(int)volumeInfo.cellCount)
+					throw std::out_of_range("Cell index "+std::to_string(index[axis][idCell])+" is out of the domain of size "+std::to_string(volumeInfo.cellCount));
+			}
+		}
+		if(nx<=0 || ny<=0 || nz<=0)
+			return;
+		//Contiguous increasing Z indices are decoded run by run, other orders cell by cell with a run lookup only when leaving the current run
+		bool zContiguous(true);
+		for(int k=1;k<nz && zContiguous;k++)
+			zContiguous=zIndex[k]==zIndex[0]+k;
+		const RunMatrix& runs(GetRunMatrix());
+		const std::size_t cellCount((std::size_t)nx*ny*nz);
+		const unsigned int workerCount(cellCount<(1<<16) ? 1 : parallel_tools::ResolveThreadCount(threadCount,nx));
+		parallel_tools::ParallelFor(workerCount,0,nx,[&](std::size_t iBegin,std::size_t iEnd,unsigned int)
+		{
+			for(std::size_t i=iBegin;i<iEnd;i++)
+			{
+				for(int j=0;j<ny;j++)
 				{
-				    //Todo optimize with memset
-				    const SpatialDiscretization::weight_t &cell_data(currentCell->GetData());
-				    std::size_t cellsize=currentCell->GetSize();
-				    if(cell_z+currentCell->GetSize()>extractPos.c)
-				    {
-                        for(cell_id_t cell_z_offset=0;cell_z_offset<cellsize;cell_z_offset++)
-                        {
-                            if(cell_z+cell_z_offset<extractPosEnd.c)
-                            {
-                                k=cell_z+cell_z_offset-extractPos.c;
-                                if(k>=0 && cell_data<nindex)
-                                    data[cell_addr(i,j,k,nj,nk)]=data_filter[cell_data];
-                            }else{
-                                break;
-                                break;
-                            }
-                        }
-				    }
-					cell_z+=currentCell->GetSize();
-					currentCell->Next(&currentCell);
+					const std::size_t column(runs.ColumnIndex(xIndex[i],yIndex[j]));
+					weight_t* destination(data+cell_addr(i,j,0,ny,nz));
+					if(zContiguous)
+					{
+						runs.DecodeColumn(column,zIndex[0],zIndex[0]+nz,destination,data_filter,nindex);
+						continue;
+					}
+					std::size_t idRun(runs.FindRun(column,zIndex[0]));
+					for(int k=0;k<nz;k++)
+					{
+						const cell_id_t cell_z(zIndex[k]);
+						if(cell_z>=runs.runEnd[idRun] || cell_z<runs.RunBegin(column,idRun))
+							idRun=runs.FindRun(column,cell_z);
+						const weight_t& value(runs.runData[idRun]);
+						if(!data_filter)
+							destination[k]=value;
+						else if(value>=0 && value<nindex)
+							destination[k]=data_filter[value];
+					}
 				}
 			}
-		}
+		});
     }
+	/**
+	 * Join the empty runs of two neighbour columns when they share at least one Z position
+	 * @param runLabel Cell value of each run used for the propagation
+	 */
+	static void UniteColumnRuns(const SpatialDiscretization::RunMatrix& runs,const std::vector<SpatialDiscretization::weight_t>& runLabel,parallel_tools::ConcurrentUnionFind& runSets,const std::size_t& columnA,const std::size_t& columnB)
+	{
+		using namespace SpatialDiscretization;
+		std::size_t runA(runs.columnOffset[columnA]),runAEnd(runs.columnOffset[columnA+1]);
+		std::size_t runB(runs.columnOffset[columnB]),runBEnd(runs.columnOffset[columnB+1]);
+		//runA and runB always overlap in this loop, the one that ends first is skipped
+		while(runA<runAEnd && runB<runBEnd)
+		{
+			if(runLabel[runA]==emptyValue && runLabel[runB]==emptyValue)
+				runSets.Unite((parallel_tools::ConcurrentUnionFind::node_t)runA,(parallel_tools::ConcurrentUnionFind::node_t)runB);
+			if(runs.runEnd[runA]<runs.runEnd[runB])
+				runA++;
+			else if(runs.runEnd[runB]<runs.runEnd[runA])
+				runB++;
+			else
+			{
+				runA++;
+				runB++;
+			}
+		}
+	}
+
+	/**
+	 * Add the overlap length of the runs of two neighbour columns that have different labels to the boundary face count of both labels
+	 */
+	static void AddColumnsBoundaryFaces(const SpatialDiscretization::RunMatrix& runs,const SpatialDiscretization::RunArray<SpatialDiscretization::weight_t>& runLabel,const std::size_t& columnA,const std::size_t& columnB,std::vector<labelStatistics_t>& statistics)
+	{
+		using namespace SpatialDiscretization;
+		std::size_t runA(runs.columnOffset[columnA]),runAEnd(runs.columnOffset[columnA+1]);
+		std::size_t runB(runs.columnOffset[columnB]),runBEnd(runs.columnOffset[columnB+1]);
+		cell_id_t cell_z(0);
+		while(runA<runAEnd && runB<runBEnd)
+		{
+			cell_id_t overlapEnd(MIN(runs.runEnd[runA],runs.runEnd[runB]));
+			const weight_t& labelA(runLabel[runA]);
+			const weight_t& labelB(runLabel[runB]);
+			if(labelA!=labelB)
+			{
+				if(labelA>=0)
+					statistics[labelA].boundaryFaceCount+=overlapEnd-cell_z;
+				if(labelB>=0)
+					statistics[labelB].boundaryFaceCount+=overlapEnd-cell_z;
+			}
+			cell_z=overlapEnd;
+			if(runs.runEnd[runA]==overlapEnd)
+				runA++;
+			if(runs.runEnd[runB]==overlapEnd)
+				runB++;
+		}
+	}
+
+	/**
+	 * Accumulate the statistics of each label from the labeled runs, each slab of X columns in its own table
+	 * @param runLabel Final cell value of each run, negative values are ignored
+	 */
+	static void ComputeRunsStatistics(const SpatialDiscretization::RunMatrix& runs,const SpatialDiscretization::RunArray<SpatialDiscretization::weight_t>& runLabel,const SpatialDiscretization::cell_id_t& size,const unsigned int& slabCount,const std::size_t& labelCount,std::vector<labelStatistics_t>& statistics)
+	{
+		using namespace SpatialDiscretization;
+		std::vector<std::vector<labelStatistics_t> > slabStatistics(slabCount);
+		parallel_tools::ParallelFor(slabCount,0,size,[&](std::size_t xBegin,std::size_t xEnd,unsigned int slab)
+		{
+			std::vector<labelStatistics_t>& slabStats(slabStatistics[slab]);
+			slabStats.resize(labelCount);
+			for(std::size_t cell_x=xBegin;cell_x<xEnd;cell_x++)
+			{
+				for(cell_id_t cell_y=0;cell_y<size;cell_y++)
+				{
+					std::size_t column(runs.ColumnIndex(cell_x,cell_y));
+					cell_id_t cell_z(0);
+					for(std::size_t idRun=runs.columnOffset[column];idRun<runs.columnOffset[column+1];idRun++)
+					{
+						const weight_t& label(runLabel[idRun]);
+						cell_id_t runEnd(runs.runEnd[idRun]);
+						if(label>=0)
+						{
+							labelStatistics_t& labelStats(slabStats[label]);
+							cell_id_t runSize(runEnd-cell_z);
+							labelStats.cellCount+=runSize;
+							labelStats.cellSum+=dvec3((double_t)cell_x*runSize,(double_t)cell_y*runSize,(double_t)runSize*(cell_z+runEnd-1)/2.);
+							labelStats.cellMin.set(MIN(labelStats.cellMin.x,(long)cell_x),MIN(labelStats.cellMin.y,(long)cell_y),MIN(labelStats.cellMin.z,(long)cell_z));
+							labelStats.cellMax.set(MAX(labelStats.cellMax.x,(long)cell_x+1),MAX(labelStats.cellMax.y,(long)cell_y+1),MAX(labelStats.cellMax.z,(long)runEnd));
+							//Faces with the next run of the column
+							if(idRun+1<runs.columnOffset[column+1] && runLabel[idRun+1]!=label)
+								labelStats.boundaryFaceCount++;
+						}
+						if(idRun>runs.columnOffset[column] && label>=0 && runLabel[idRun-1]!=label)
+							slabStats[label].boundaryFaceCount++;
+						cell_z=runEnd;
+					}
+					if(cell_y+1<size)
+						AddColumnsBoundaryFaces(runs,runLabel,column,runs.ColumnIndex(cell_x,cell_y+1),slabStats);
+					if(cell_x+1<size)
+						AddColumnsBoundaryFaces(runs,runLabel,column,runs.ColumnIndex(cell_x+1,cell_y),slabStats);
+				}
+			}
+		});
+		statistics.assign(labelCount,labelStatistics_t());
+		for(unsigned int slab=0;slab<slabCount;slab++)
+		{
+			for(std::size_t label=0;label<slabStatistics[slab].size();label++)
+			{
+				const labelStatistics_t& slabStats(slabStatistics[slab][label]);
+				labelStatistics_t& labelStats(statistics[label]);
+				labelStats.cellCount+=slabStats.cellCount;
+				labelStats.boundaryFaceCount+=slabStats.boundaryFaceCount;
+				labelStats.cellSum+=slabStats.cellSum;
+				labelStats.cellMin.set(MIN(labelStats.cellMin.x,slabStats.cellMin.x),MIN(labelStats.cellMin.y,slabStats.cellMin.y),MIN(labelStats.cellMin.z,slabStats.cellMin.z));
+				labelStats.cellMax.set(MAX(labelStats.cellMax.x,slabStats.cellMax.x),MAX(labelStats.cellMax.y,slabStats.cellMax.y),MAX(labelStats.cellMax.z,slabStats.cellMax.z));
+			}
+		}
+	}
+
+	/**
+	 * Add the number of faces shared between an empty run and the surface runs around it
+	 */
+	static void AddRunSurfaceFaces(const SpatialDiscretization::RunMatrix& runs,const std::size_t& column,const std::size_t& idRun,std::map<SpatialDiscretization::weight_t,std::size_t>& surfaceFaces)
+	{
+		using namespace SpatialDiscretization;
+		const long neighLink[4][2]={{0,1},{1,0},{0,-1},{-1,0}};
+		//The runs before and after in the column are surfaces
+		if(idRun>runs.columnOffset[column] && runs.runData[idRun-1]>=0)
+			surfaceFaces[runs.runData[idRun-1]]++;
+		if(idRun+1<runs.columnOffset[column+1] && runs.runData[idRun+1]>=0)
+			surfaceFaces[runs.runData[idRun+1]]++;
+		cell_id_t runBegin(runs.RunBegin(column,idRun)),runEnd(runs.runEnd[idRun]);
+		long cell_x(column/runs.size),cell_y(column%runs.size);
+		for(unsigned short neigh=0;neigh<4;neigh++)
+		{
+			long neigh_x(cell_x+neighLink[neigh][0]),neigh_y(cell_y+neighLink[neigh][1]);
+			if(neigh_x<0 || neigh_y<0 || neigh_x>=(long)runs.size || neigh_y>=(long)runs.size)
+				continue;
+			std::size_t neighColumn(runs.ColumnIndex(neigh_x,neigh_y));
+			for(std::size_t neighRun=runs.FindRun(neighColumn,runBegin);neighRun<runs.columnOffset[neighColumn+1];neighRun++)
+			{
+				cell_id_t overlapBegin(MAX(runBegin,runs.RunBegin(neighColumn,neighRun)));
+				cell_id_t overlapEnd(MIN(runEnd,runs.runEnd[neighRun]));
+				if(runs.runData[neighRun]>=0)
+					surfaceFaces[runs.runData[neighRun]]+=overlapEnd-overlapBegin;
+				if(runs.runEnd[neighRun]>=runEnd)
+					break;
+			}
+		}
+	}
+
+	/**
+	 * Find the enclosed sets of empty runs smaller than the minimal cell count and choose their cell value
+	 * @param smallVolumeValue Value given to the small volumes, emptyValue to use the surface that share the most faces with the volume
+	 * @param[out] mergedRootLabel For each root run of a small volume, the cell value of the volume. emptyValue for the other runs.
+	 * @return Number of small volumes
+	 */
+	static std::size_t FindSmallVolumes(const SpatialDiscretization::RunMatrix& runs,const std::vector<parallel_tools::ConcurrentUnionFind::node_t>& runRoot,const std::vector<char>& exteriorRoot,const std::size_t& minimalCellCount,const SpatialDiscretization::weight_t& smallVolumeValue,std::vector<SpatialDiscretization::weight_t>& mergedRootLabel)
+	{
+		using namespace SpatialDiscretization;
+		const std::size_t runCount(runs.GetRunCount());
+		mergedRootLabel.assign(runCount,emptyValue);
+		std::vector<std::size_t> rootCellCount(runCount,0);
+		for(std::size_t column=0;column+1<runs.columnOffset.size();column++)
+		{
+			for(std::size_t idRun=runs.columnOffset[column];idRun<runs.columnOffset[column+1];idRun++)
+				if(runs.runData[idRun]==emptyValue && !exteriorRoot[runRoot[idRun]])
+					rootCellCount[runRoot[idRun]]+=runs.runEnd[idRun]-runs.RunBegin(column,idRun);
+		}
+		std::map<std::size_t,std::map<weight_t,std::size_t> > rootSurfaceFaces;
+		std::size_t smallVolumeCount(0);
+		for(std::size_t idRun=0;idRun<runCount;idRun++)
+		{
+			if(rootCellCount[idRun]>0 && rootCellCount[idRun]<minimalCellCount)
+			{
+				smallVolumeCount++;
+				mergedRootLabel[idRun]=smallVolumeValue;
+				if(smallVolumeValue==emptyValue)
+					rootSurfaceFaces[idRun];
+			}
+		}
+		if(rootSurfaceFaces.empty())
+			return smallVolumeCount;
+		//Count the faces shared with each surface by the small volumes
+		for(std::size_t column=0;column+1<runs.columnOffset.size();column++)
+		{
+			for(std::size_t idRun=runs.columnOffset[column];idRun<runs.columnOffset[column+1];idRun++)
+			{
+				if(runs.runData[idRun]==emptyValue && mergedRootLabel[runRoot[idRun]]==emptyValue && rootCellCount[runRoot[idRun]]>0 && rootCellCount[runRoot[idRun]]<minimalCellCount)
+					AddRunSurfaceFaces(runs,column,idRun,rootSurfaceFaces[runRoot[idRun]]);
+			}
+		}
+		for(std::map<std::size_t,std::map<weight_t,std::size_t> >::iterator itroot=rootSurfaceFaces.begin();itroot!=rootSurfaceFaces.end();itroot++)
+		{
+			std::size_t mostFaces(0);
+			for(std::map<weight_t,std::size_t>::iterator itsurf=itroot->second.begin();itsurf!=itroot->second.end();itsurf++)
+			{
+				if(itsurf->second>mostFaces)
+				{
+					mostFaces=itsurf->second;
+					mergedRootLabel[itroot->first]=itsurf->first;
+				}
+			}
+			//Without a surface to merge into, the small volume keeps its own volume id
+			if(mostFaces==0)
+				smallVolumeCount--;
+		}
+		return smallVolumeCount;
+	}
+
 	void ScalarFieldCreator::ThirdStep_VolumesCreator()
 	{
 		using namespace SpatialDiscretization;
-		//Initialisation du volume exterieur
-		InitExteriorVolumeId();
-		ExtandVolume(SpatialDiscretization::weight_t(this->volumeInfo.maximal_marker_index+1));
-		zcell* foundCell(NULL);
-		GetFirstCellByWeight(weight_t(SpatialDiscretization::emptyValue),&foundCell); //Find the first empty cell
-		weight_t volId(this->volumeInfo.maximal_marker_index+2);
-		while(foundCell!=NULL)
+		typedef parallel_tools::ConcurrentUnionFind::node_t node_t;
+		const cell_id_t size(volumeInfo.cellCount);
+		const unsigned int slabCount(parallel_tools::ResolveThreadCount(threadCount,size));
+		PTR<RunMatrix> labeledRuns(new RunMatrix());
+		RunMatrix& runs(*labeledRuns);
+		std::vector<zcell*> runCell;
+		runs.Build(GetFieldData(),slabCount,&runCell);
+		const std::size_t runCount(runs.runData.size());
+		if(runCount>=UINT_MAX)
+			throw std::overflow_error("Too many runs in the matrix to label the volumes");
+		RestoreSurfaceRuns(runs);
+		std::vector<weight_t> propagationData;
+		BuildPropagationData(runs.runData,propagationData);
+
+		//Provisional labels, each slab of X columns join its own empty runs
+		parallel_tools::ConcurrentUnionFind runSets(runCount);
+		std::vector<std::size_t> slabBegin(slabCount+1,size);
+		parallel_tools::ParallelFor(slabCount,0,size,[&](std::size_t xBegin,std::size_t xEnd,unsigned int slab)
 		{
+			slabBegin[slab]=xBegin;
+			for(std::size_t cell_x=xBegin;cell_x<xEnd;cell_x++)
+			{
+				for(cell_id_t cell_y=0;cell_y<size;cell_y++)
+				{
+					//Runs of a column are only connected through transparent surfaces
+					std::size_t column(runs.ColumnIndex(cell_x,cell_y));
+					for(std::size_t idRun=runs.columnOffset[column];idRun+1<runs.columnOffset[column+1];idRun++)
+						if(propagationData[idRun]==emptyValue && propagationData[idRun+1]==emptyValue)
+							runSets.Unite((node_t)idRun,(node_t)idRun+1);
+					if(cell_y+1<size)
+						UniteColumnRuns(runs,propagationData,runSets,runs.ColumnIndex(cell_x,cell_y),runs.ColumnIndex(cell_x,cell_y+1));
+					if(cell_x+1<xEnd)
+						UniteColumnRuns(runs,propagationData,runSets,runs.ColumnIndex(cell_x,cell_y),runs.ColumnIndex(cell_x+1,cell_y));
+				}
+			}
+		});
+		//Boundary merge, join the runs on both sides of the slab seams
+		parallel_tools::ParallelFor(slabCount,1,slabCount,[&](std::size_t seamBegin,std::size_t seamEnd,unsigned int)
+		{
+			for(std::size_t seam=seamBegin;seam<seamEnd;seam++)
+			{
+				std::size_t cell_x(slabBegin[seam]);
+				for(cell_id_t cell_y=0;cell_y<size;cell_y++)
+					UniteColumnRuns(runs,propagationData,runSets,runs.ColumnIndex(cell_x-1,cell_y),runs.ColumnIndex(cell_x,cell_y));
+			}
+		});
 
-			#ifdef _DEBUG
-			std::cout<<"Propagation of volume id="<<volId<<std::endl;
-			#endif
-			//Initialisation du volume volId
-			foundCell->SetData(volId);
-			ExtandVolume(volId);
-			//Passage au prochain volume
+		//The root of a set is its first run in the X,Y,Z scan order
+		std::vector<node_t> runRoot(runCount);
+		parallel_tools::ParallelFor(slabCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int)
+		{
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+				runRoot[idRun]=runSets.Find((node_t)idRun);
+		});
+		//The sets that contain the first or last run of a column belong to the exterior volume
+		std::vector<char> exteriorRoot(runCount,0);
+		for(std::size_t column=0;column+1<runs.columnOffset.size();column++)
+		{
+			std::size_t firstRun(runs.columnOffset[column]),lastRun(runs.columnOffset[column+1]-1);
+			if(propagationData[firstRun]==emptyValue)
+				exteriorRoot[runRoot[firstRun]]=1;
+			if(propagationData[lastRun]==emptyValue)
+				exteriorRoot[runRoot[lastRun]]=1;
+		}
+		//Sets made only of transparent surfaces are not volumes
+		std::vector<char> emptyRoot(runCount,0);
+		for(std::size_t idRun=0;idRun<runCount;idRun++)
+			if(runs.runData[idRun]==emptyValue)
+				emptyRoot[runRoot[idRun]]=1;
+		//The volumes below the minimal size are merged in a surface instead of getting their own id
+		std::vector<weight_t> rootLabel;
+		const std::size_t minimalCellCount(ResolveMinimalCellCount());
+		if(smallVolumeValue>this->volumeInfo.maximal_marker_index)
+			throw std::invalid_argument("The small volumes value ("+std::to_string(smallVolumeValue)+") must be a surface marker or -1");
+		this->mergedVolumeCount=0;
+		if(minimalCellCount>1)
+			this->mergedVolumeCount=FindSmallVolumes(runs,runRoot,exteriorRoot,minimalCellCount,smallVolumeValue,rootLabel);
+		else
+			rootLabel.assign(runCount,emptyValue);
+		//Volume ids are given in the scan order of the roots, as the sequential propagation did
+		std::vector<std::size_t> slabVolumeCount(slabCount+1,0);
+		auto isVolumeRoot=[&](const std::size_t& idRun) {
+			return emptyRoot[idRun] && runRoot[idRun]==idRun && !exteriorRoot[idRun] && rootLabel[idRun]==emptyValue;
+		};
+		parallel_tools::ParallelFor(slabCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int slab)
+		{
+			std::size_t volumeCount(0);
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+				if(isVolumeRoot(idRun))
+					volumeCount++;
+			slabVolumeCount[slab+1]=volumeCount;
+		});
+		for(unsigned int slab=1;slab<=slabCount;slab++)
+			slabVolumeCount[slab]+=slabVolumeCount[slab-1];
+		//The last volume id is exteriorId+volume count, it must be a valid cell value
+		if((std::size_t)this->volumeInfo.maximal_marker_index+1+slabVolumeCount.back()>(std::size_t)SHRT_MAX)
+			throw std::overflow_error("Too many volumes in the matrix, the volume ids would exceed "+std::to_string(SHRT_MAX));
+		const weight_t exteriorId(this->volumeInfo.maximal_marker_index+1);
+		parallel_tools::ParallelFor(slabCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int slab)
+		{
+			weight_t volId(weight_t(exteriorId+1+slabVolumeCount[slab]));
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+			{
+				if(isVolumeRoot(idRun))
+					rootLabel[idRun]=volId++;
+				else if(exteriorRoot[idRun])
+					rootLabel[idRun]=exteriorId;
+			}
+		});
+		//Final labels are written back in the matrix, the transparent surfaces keep their marker
+		parallel_tools::ParallelFor(slabCount,0,runCount,[&](std::size_t runBegin,std::size_t runEnd,unsigned int)
+		{
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+			{
+				if(runs.runData[idRun]==emptyValue)
+					runs.runData[idRun]=rootLabel[runRoot[idRun]];
+				if(runCell[idRun]->GetData()!=runs.runData[idRun])
+					runCell[idRun]->SetData(runs.runData[idRun]);
+			}
+		});
+		volumeInfo.volumeCount=weight_t(1+slabVolumeCount.back());
+		ComputeRunsStatistics(runs,runs.runData,size,slabCount,(std::size_t)exteriorId+volumeInfo.volumeCount,this->volumeInfo.labelStatistics);
+		ComputeVolumesValue(this->volumeInfo.volumeValue);
+		SetRunMatrix(labeledRuns);
+	}
+
+	inline bool IsColumnEndRun(const SpatialDiscretization::RunMatrix& runs,const std::size_t& column,const std::size_t& idRun)
+	{
+		return idRun==runs.columnOffset[column] || idRun+1==runs.columnOffset[column+1];
+	}
 
-			volId++;
-			GetFirstCellByWeight(weight_t(SpatialDiscretization::emptyValue),&foundCell);
+	typedef std::pair<std::size_t,std::size_t> frontierRun_t; //Run index, column index
+
+	/**
+	 * Propagate fillValue from the runs of the frontier to the connected empty runs.
+	 * The runs in the frontier must already hold fillValue.
+	 * @param runLabel Cell value of each run used for the propagation, filled runs receive fillValue
+	 * @param stopAtExterior Return as soon as the fill reach the first or last run of a column
+	 * @return True if the fill reached the first or last run of a column
+	 */
+	static bool FloodFillRuns(const SpatialDiscretization::RunMatrix& runs,std::vector<SpatialDiscretization::weight_t>& runLabel,std::vector<frontierRun_t>& frontier,const SpatialDiscretization::weight_t& fillValue,bool stopAtExterior)
+	{
+		using namespace SpatialDiscretization;
+		const long neighLink[4][2]={{0,1},{1,0},{0,-1},{-1,0}};
+		bool exteriorReached(false);
+		while(!frontier.empty())
+		{
+			frontierRun_t current(frontier.back());
+			frontier.pop_back();
+			if(IsColumnEndRun(runs,current.second,current.first))
+			{
+				exteriorReached=true;
+				if(stopAtExterior)
+					return true;
+			}
+			//Runs before and after in the column, connected if they are transparent surfaces
+			if(current.first>runs.columnOffset[current.second] && runLabel[current.first-1]==emptyValue)
+			{
+				runLabel[current.first-1]=fillValue;
+				frontier.push_back(frontierRun_t(current.first-1,current.second));
+			}
+			if(current.first+1<runs.columnOffset[current.second+1] && runLabel[current.first+1]==emptyValue)
+			{
+				runLabel[current.first+1]=fillValue;
+				frontier.push_back(frontierRun_t(current.first+1,current.second));
+			}
+			cell_id_t runStart(runs.RunBegin(current.second,current.first));
+			cell_id_t runEnd(runs.runEnd[current.first]);
+			long cell_x(current.second/runs.size),cell_y(current.second%runs.size);
+			for(unsigned short neigh=0;neigh<4;neigh++)
+			{
+				long neigh_x(cell_x+neighLink[neigh][0]),neigh_y(cell_y+neighLink[neigh][1]);
+				if(neigh_x<0 || neigh_y<0 || neigh_x>=(long)runs.size || neigh_y>=(long)runs.size)
+					continue;
+				std::size_t neighColumn(runs.ColumnIndex(neigh_x,neigh_y));
+				//Visit the runs of the neighbour column that share a Z position with the current run
+				for(std::size_t idRun=runs.FindRun(neighColumn,runStart);idRun<runs.columnOffset[neighColumn+1];idRun++)
+				{
+					if(runLabel[idRun]==emptyValue)
+					{
+						runLabel[idRun]=fillValue;
+						frontier.push_back(frontierRun_t(idRun,neighColumn));
+					}
+					if(runs.runEnd[idRun]>=runEnd)
+						break;
+				}
+			}
+		}
+		return exteriorReached;
+	}
+
+	std::vector<SpatialDiscretization::weight_t> ScalarFieldCreator::LabelVolumesFromSeeds(const std::vector<dvec3>& seeds)
+	{
+		using namespace SpatialDiscretization;
+		const cell_id_t size(volumeInfo.cellCount);
+		PTR<RunMatrix> labeledRuns(new RunMatrix());
+		RunMatrix& runs(*labeledRuns);
+		std::vector<zcell*> runCell;
+		runs.Build(GetFieldData(),parallel_tools::ResolveThreadCount(threadCount,size),&runCell);
+		RestoreSurfaceRuns(runs);
+		std::vector<weight_t> runLabel;
+		BuildPropagationData(runs.runData,runLabel);
+		//Exterior fill from the first and last runs of the columns
+		const weight_t exteriorId(this->volumeInfo.maximal_marker_index+1);
+		std::vector<frontierRun_t> frontier;
+		for(std::size_t column=0;column+1<runs.columnOffset.size();column++)
+		{
+			std::size_t firstRun(runs.columnOffset[column]),lastRun(runs.columnOffset[column+1]-1);
+			if(runLabel[firstRun]==emptyValue)
+			{
+				runLabel[firstRun]=exteriorId;
+				frontier.push_back(frontierRun_t(firstRun,column));
+			}
+			if(runLabel[lastRun]==emptyValue)
+			{
+				runLabel[lastRun]=exteriorId;
+				frontier.push_back(frontierRun_t(lastRun,column));
+			}
+		}
+		FloodFillRuns(runs,runLabel,frontier,exteriorId,false);
+		//Only the volumes that contain a seed are filled
+		std::vector<weight_t> seedLabels;
+		seedLabels.reserve(seeds.size());
+		weight_t volId(exteriorId+1);
+		for(std::vector<dvec3>::const_iterator itseed=seeds.begin();itseed!=seeds.end();itseed++)
+		{
+			ivec3 seedCell(this->GetCellIdByCoord(*itseed));
+			if(seedCell.x<0 || seedCell.y<0 || seedCell.z<0 || seedCell.x>=(long)size || seedCell.y>=(long)size || seedCell.z>=(long)size)
+			{
+				seedLabels.push_back(exteriorId);
+				continue;
+			}
+			std::size_t seedColumn(runs.ColumnIndex(seedCell.x,seedCell.y));
+			std::size_t seedRun(runs.FindRun(seedColumn,seedCell.z));
+			if(runLabel[seedRun]==emptyValue)
+			{
+				if(volId==SHRT_MAX)
+					throw std::overflow_error("Too many volumes in the matrix, the volume ids would exceed "+std::to_string(SHRT_MAX));
+				runLabel[seedRun]=volId;
+				frontier.push_back(frontierRun_t(seedRun,seedColumn));
+				FloodFillRuns(runs,runLabel,frontier,volId,false);
+				volId++;
+			}
+			seedLabels.push_back(runLabel[seedRun]);
+		}
+		//Labels are written back in the matrix, the other empty runs are left unlabeled and the transparent surfaces keep their marker
+		parallel_tools::ParallelFor(parallel_tools::ResolveThreadCount(threadCount,runCell.size()),0,runCell.size(),[&](std::size_t runBegin,std::size_t runEnd,unsigned int)
+		{
+			for(std::size_t idRun=runBegin;idRun<runEnd;idRun++)
+			{
+				if(runs.runData[idRun]==emptyValue)
+					runs.runData[idRun]=runLabel[idRun];
+				if(runCell[idRun]->GetData()!=runs.runData[idRun])
+					runCell[idRun]->SetData(runs.runData[idRun]);
+			}
+		});
+		volumeInfo.volumeCount=volId-exteriorId;
+		ComputeRunsStatistics(runs,runs.runData,size,parallel_tools::ResolveThreadCount(threadCount,size),(std::size_t)volId,this->volumeInfo.labelStatistics);
+		ComputeVolumesValue(this->volumeInfo.volumeValue);
+		SetRunMatrix(labeledRuns);
+		return seedLabels;
+	}
+
+	void ScalarFieldCreator::ThirdStep_VolumesFromCrossings(const std::vector<std::size_t>& crossingOffset,const std::vector<double_t>& crossingZ)
+	{
+		using namespace SpatialDiscretization;
+		const cell_id_t size(volumeInfo.cellCount);
+		const unsigned int slabCount(parallel_tools::ResolveThreadCount(threadCount,size));
+		if(crossingOffset.size()!=(std::size_t)size*size+1)
+			throw std::invalid_argument("Crossings must be given for the "+std::to_string((std::size_t)size*size)+" columns of the matrix");
+		PTR<RunMatrix> labeledRuns(new RunMatrix());
+		RunMatrix& runs(*labeledRuns);
+		std::vector<zcell*> runCell;
+		runs.Build(GetFieldData(),slabCount,&runCell);
+		RestoreSurfaceRuns(runs);
+		const weight_t exteriorId(this->volumeInfo.maximal_marker_index+1);
+		const weight_t interiorId(exteriorId+1);
+		if(interiorId==SHRT_MAX)
+			throw std::overflow_error("Too many volumes in the matrix, the volume ids would exceed "+std::to_string(SHRT_MAX));
+		//Empty runs take the state of the ray at their center, the columns with an odd crossing count
+		//or with a crossing inside an empty run are left to the propagation
+		std::vector<weight_t> runLabel(runs.runData.begin(),runs.runData.end());
+		std::vector<char> fallbackColumn((std::size_t)size*size,0);
+		parallel_tools::ParallelFor(slabCount,0,size,[&](std::size_t xBegin,std::size_t xEnd,unsigned int)
+		{
+			for(std::size_t column=runs.ColumnIndex(xBegin,0);column<runs.ColumnIndex(xEnd,0);column++)
+			{
+				std::size_t crossingBegin(crossingOffset[column]),crossingEnd(crossingOffset[column+1]);
+				bool consistent((crossingEnd-crossingBegin)%2==0);
+				std::size_t idCrossing(crossingBegin);
+				for(std::size_t idRun=runs.columnOffset[column];consistent && idRun<runs.columnOffset[column+1];idRun++)
+				{
+					if(runs.runData[idRun]!=emptyValue)
+						continue;
+					double_t runBegin(runs.RunBegin(column,idRun)+.5),runEnd(runs.runEnd[idRun]-.5);
+					while(idCrossing<crossingEnd && crossingZ[idCrossing]<runBegin)
+						idCrossing++;
+					if(idCrossing<crossingEnd && crossingZ[idCrossing]<=runEnd)
+						consistent=false;
+					else
+						runLabel[idRun]=(idCrossing-crossingBegin)%2==1 ? interiorId : exteriorId;
+				}
+				if(!consistent)
+				{
+					fallbackColumn[column]=1;
+					for(std::size_t idRun=runs.columnOffset[column];idRun<runs.columnOffset[column+1];idRun++)
+						runLabel[idRun]=runs.runData[idRun];
+				}
+			}
+		});
+		//Fallback columns are filled from the labeled runs around them, exterior first
+		const long neighLink[4][2]={{0,1},{1,0},{0,-1},{-1,0}};
+		this->parityFallbackColumnCount=0;
+		const weight_t fillValues[2]={exteriorId,interiorId};
+		for(int idFill=0;idFill<2;idFill++)
+		{
+			std::vector<frontierRun_t> frontier;
+			for(std::size_t column=0;column<fallbackColumn.size();column++)
+			{
+				if(!fallbackColumn[column])
+					continue;
+				if(idFill==0)
+				{
+					this->parityFallbackColumnCount++;
+					std::size_t firstRun(runs.columnOffset[column]),lastRun(runs.columnOffset[column+1]-1);
+					if(runLabel[firstRun]==emptyValue)
+					{
+						runLabel[firstRun]=exteriorId;
+						frontier.push_back(frontierRun_t(firstRun,column));
+					}
+					if(runLabel[lastRun]==emptyValue)
+					{
+						runLabel[lastRun]=exteriorId;
+						frontier.push_back(frontierRun_t(lastRun,column));
+					}
+				}
+				long cell_x(column/size),cell_y(column%size);
+				for(unsigned short neigh=0;neigh<4;neigh++)
+				{
+					long neigh_x(cell_x+neighLink[neigh][0]),neigh_y(cell_y+neighLink[neigh][1]);
+					if(neigh_x<0 || neigh_y<0 || neigh_x>=(long)size || neigh_y>=(long)size)
+						continue;
+					std::size_t neighColumn(runs.ColumnIndex(neigh_x,neigh_y));
+					if(fallbackColumn[neighColumn])
+						continue;
+					for(std::size_t idRun=runs.columnOffset[neighColumn];idRun<runs.columnOffset[neighColumn+1];idRun++)
+						if(runs.runData[idRun]==emptyValue && runLabel[idRun]==fillValues[idFill])
+							frontier.push_back(frontierRun_t(idRun,neighColumn));
+				}
+			}
+			FloodFillRuns(runs,runLabel,frontier,fillValues[idFill],false);
 		}
-		volumeInfo.volumeCount=volId-this->volumeInfo.maximal_marker_index-1;
+		//Write back, the empty runs not reached by the fills are enclosed in the fallback columns
+		bool hasInterior(false);
+		for(std::size_t idRun=0;idRun<runCell.size();idRun++)
+		{
+			if(runs.runData[idRun]==emptyValue)
+			{
+				runs.runData[idRun]=runLabel[idRun]==emptyValue ? interiorId : runLabel[idRun];
+				hasInterior=hasInterior || runs.runData[idRun]==interiorId;
+			}
+			if(runCell[idRun]->GetData()!=runs.runData[idRun])
+				runCell[idRun]->SetData(runs.runData[idRun]);
+		}
+		this->mergedVolumeCount=0;
+		volumeInfo.volumeCount=hasInterior ? 2 : 1;
+		ComputeRunsStatistics(runs,runs.runData,size,slabCount,(std::size_t)exteriorId+volumeInfo.volumeCount,this->volumeInfo.labelStatistics);
 		ComputeVolumesValue(this->volumeInfo.volumeValue);
+		SetRunMatrix(labeledRuns);
+	}
+	std::size_t ScalarFieldCreator::GetParityFallbackColumnCount()
+	{
+		return this->parityFallbackColumnCount;
+	}
+
+	bool ScalarFieldCreator::IsSeedEnclosed(const dvec3& seed)
+	{
+		using namespace SpatialDiscretization;
+		const cell_id_t size(volumeInfo.cellCount);
+		ivec3 seedCell(this->GetCellIdByCoord(seed));
+		if(seedCell.x<0 || seedCell.y<0 || seedCell.z<0 || seedCell.x>=(long)size || seedCell.y>=(long)size || seedCell.z>=(long)size)
+			return false;
+		if(!this->labeledField && !this->runMatrix.get())
+		{
+			//The runs are not built yet, the seeds on a surface or in a run at an end of its column are found on the matrix cells
+			zcell* seedRun(&(GetFieldData()[seedCell.x][seedCell.y]));
+			zcell* nextCell;
+			bool columnEnd(true);
+			cell_id_t cellEnd(seedRun->GetSize());
+			while(cellEnd<=(cell_id_t)seedCell.z && seedRun->Next(&nextCell))
+			{
+				seedRun=nextCell;
+				cellEnd+=seedRun->GetSize();
+				columnEnd=false;
+			}
+			const weight_t seedValue(seedRun->GetData());
+			const bool transparent(seedValue>=0 && (std::size_t)seedValue<this->transparentMarker.size() && this->transparentMarker[seedValue]);
+			if(seedValue!=emptyValue && !transparent)
+				return false; //Seed in a surface
+			if(columnEnd || !seedRun->Next(&nextCell))
+				return false; //Seed in the exterior volume
+		}
+		//The fill is done on the surfaces, even if the matrix is already labeled
+		const RunMatrix& runs(GetRunMatrix());
+		std::size_t seedColumn(runs.ColumnIndex(seedCell.x,seedCell.y));
+		if(this->labeledField && !HasSurfaceRuns(runs))
+		{
+			//The surfaces are lost (loaded without them), the labels tell if the seed is in a closed volume
+			return runs.runData[runs.FindRun(seedColumn,seedCell.z)]>this->volumeInfo.maximal_marker_index+1;
+		}
+		std::vector<weight_t> runLabel;
+		BuildPropagationData(HasSurfaceRuns(runs) ? surfaceRunData : runs.runData,runLabel);
+		std::vector<frontierRun_t> frontier(1,frontierRun_t(runs.FindRun(seedColumn,seedCell.z),seedColumn));
+		if(runLabel[frontier.back().first]!=emptyValue)
+			return false; //Seed in a surface
+		runLabel[frontier.back().first]=this->volumeInfo.maximal_marker_index+2;
+		return !FloodFillRuns(runs,runLabel,frontier,this->volumeInfo.maximal_marker_index+2,true);
 	}
 }
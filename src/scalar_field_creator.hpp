@@ -22,6 +22,9 @@
 #include "spatial_discretization.hpp"
 #include <vector>
 #include <string>
+#include <iosfwd>
+#include <climits>
+#include <mutex>
 
 #ifndef __SCALARFIELDBUILDERS__
 #define __SCALARFIELDBUILDERS__
@@ -32,6 +35,22 @@ namespace ScalarFieldBuilders
 	 * Retourne les coordonnées du centre du cube correspondant à l'indice en paramètre
 	 */
     dvec3 CellIdToCenterCoordinate( const ivec3& cell_id, const double_t& cellSize, const dvec3& zeroCellCenter);
+
+	/**
+	 * Statistics of a cell value (marker, exterior or volume id), accumulated by the labeling step
+	 */
+	struct labelStatistics_t
+	{
+		labelStatistics_t()
+		: cellCount(0),boundaryFaceCount(0),cellMin(LONG_MAX,LONG_MAX,LONG_MAX),cellMax(0,0,0),cellSum(0.,0.,0.)
+		{
+		}
+		std::size_t cellCount;
+		std::size_t boundaryFaceCount; /*!< Number of cell faces shared with another cell value */
+		ivec3 cellMin;                 /*!< Bounding box of the cells, cellMin included */
+		ivec3 cellMax;                 /*!< Bounding box of the cells, cellMax excluded */
+		dvec3 cellSum;                 /*!< Sum of the cell indices, the centroid cell is cellSum/cellCount */
+	};
 	/**
 	 * Cette classe permet de générer un espace discrétisé en plusieurs volumes. C'est la première étape de la reconstruction du modèle.
 	 */
@@ -54,38 +73,98 @@ namespace ScalarFieldBuilders
             dvec3 zeroCellCenter;
 			SpatialDiscretization::weight_t volumeCount;
             std::vector<double_t> volumeValue;
+            std::vector<labelStatistics_t> labelStatistics; //Indexed by cell value
             dvec3 boxMin;
             dvec3 boxMax;
 			SpatialDiscretization::weight_t maximal_marker_index;
 		} volumeInfo;
 		SpatialDiscretization::domainInformation_t domainInformation;
         double_t resolution;
+		unsigned int threadCount;
+		double_t minimalVolume;                         //Volumes below this value (m^3) are merged
+		std::size_t minimalCellCount;                   //Volumes below this cell count are merged
+		SpatialDiscretization::weight_t smallVolumeValue; //Cell value of the merged volumes, emptyValue for the nearest surface
+		std::size_t mergedVolumeCount;
+		std::size_t parityFallbackColumnCount;
+		PTR<SpatialDiscretization::RunMatrix> runMatrix; //Flat copy of fieldData, NULL when outdated
+		std::mutex runMatrixMutex;                       //Readers that release the GIL may build runMatrix concurrently
+		/**
+		 * Runs of each cell value, built on demand
+		 * The runs of the cell value v are labelRun[labelRunOffset[v],labelRunOffset[v+1][ in the X,Y,Z scan order
+		 */
+		std::vector<std::size_t> labelRunOffset;
+		std::vector<std::size_t> labelRun;
+		SpatialDiscretization::RunArray<SpatialDiscretization::weight_t> surfaceRunData; //Values of the runs before labeling, empty if the matrix has not been labeled
+		unsigned long long surfaceRunLayout;                         //Checksum of the run layout surfaceRunData was saved from
+		bool labeledField;                                           //fieldData holds volume labels, RestoreSurfaces must put back the surfaces
+		std::vector<char> transparentMarker;                         //Indexed by marker
         static void ComputeMatrixParams(const dvec3& boxMin,const dvec3& boxMax, const double_t& minResolution, mainVolumeConstruction_t& computedVolumeInfo);
 		/**
-		 * Initialise les données pour le volume extérieur
+		 * Calcul pour chaque volume sa valeur en m^3, à partir des statistiques des labels
+		 * @param[out] volumeValue Un tableau de dimension égale au nombre de volume dans le domaine. Dont la valeur est en m^3.
 		 */
-		void InitExteriorVolumeId();
+        void ComputeVolumesValue(std::vector<double_t>& volumeValue);
 		/**
-		 * Propage les valeurs des identifiants de volume d'une cellule à l'autre
-		 * Si la cellule cible est modifié cette méthode retourne vrai
+		 * Must be called when fieldData is modified, drop the labeling results (statistics, runs and run index)
 		 */
-		bool CellToCellVolumePropagation(const ivec2& destinationPropa,const ivec2& sourcePropa,const SpatialDiscretization::weight_t& volumeId);
+		void ClearLabeling();
 		/**
-		 * Propage un indice de volume dans toute la matrice
+		 * Keep the runs of the labeled matrix, the run index is built again on demand
 		 */
-		void ExtandVolume(const SpatialDiscretization::weight_t& volumeId);
+		void SetRunMatrix(const PTR<SpatialDiscretization::RunMatrix>& labeledRuns);
 		/**
-		 * Retourne la position de la première cellule avec la valeur en paramètre
+		 * Put back the surface values in the runs of a labeled matrix, or save them if the matrix is not labeled yet
+		 * @param runs Runs copied from fieldData
 		 */
-		ivec3 GetFirstCellByWeight(const SpatialDiscretization::weight_t& weight,SpatialDiscretization::zcell** foundCell);
-
+		void RestoreSurfaceRuns(SpatialDiscretization::RunMatrix& runs);
 		/**
-		 * Calcul pour chaque volume sa valeur en m^3
-		 * @param[out] volumeValue Un tableau de dimension égale au nombre de volume dans le domaine. Dont la valeur est en m^3.
+		 * @return True if surfaceRunData was saved from runs with the same layout
 		 */
-        void ComputeVolumesValue(std::vector<double_t>& volumeValue);
+		bool HasSurfaceRuns(const SpatialDiscretization::RunMatrix& runs) const;
+		/**
+		 * Copy the surface values of the runs where the transparent markers are replaced by the empty value
+		 */
+		void BuildPropagationData(const SpatialDiscretization::RunArray<SpatialDiscretization::weight_t>& surfaceData,std::vector<SpatialDiscretization::weight_t>& propagationData);
+		/**
+		 * Label the empty cells from the surface crossings of a ray cast along Z at the center of each column, instead of the propagation.
+		 * The empty cells after an odd number of crossings are inside. Columns with an odd crossing count, or with a crossing
+		 * in an empty run, are filled from the neighbour columns instead.
+		 * All the interior cells get the first volume id after the exterior.
+		 * @param crossingOffset Crossings of the column ColumnIndex(x,y) are crossingZ[crossingOffset[column],crossingOffset[column+1][
+		 * @param crossingZ Z position of the crossings in cell units (cell k is [k,k+1[), sorted in each column
+		 */
+		void ThirdStep_VolumesFromCrossings(const std::vector<std::size_t>& crossingOffset,const std::vector<double_t>& crossingZ);
+		/**
+		 * Bounding box of the cells with a value in [firstLabel,lastLabel], from the statistics or the run index
+		 */
+		void GetLabelRangeBoundaries(ivec3& min,ivec3& max,const SpatialDiscretization::weight_t& firstLabel,const SpatialDiscretization::weight_t& lastLabel);
+		/**
+		 * Matrix of the field. After Load the matrix is rebuilt from the runs on the first call.
+		 */
+		SpatialDiscretization::weight_matrix& GetFieldData();
+		/**
+		 * Read the field from a serialized buffer, the runs point into the buffer
+		 */
+		virtual void LoadMapping(const PTR<file_tools::FileMapping>& mapping);
 
 
+	public:
+		/**
+		 * File formats of ExportVTK
+		 */
+		enum EXPORT_FORMAT
+		{
+			EXPORT_VTK_ASCII,  //Legacy VTK STRUCTURED_POINTS, one value per line
+			EXPORT_VTK_BINARY, //Legacy VTK STRUCTURED_POINTS, big endian Int16
+			EXPORT_VTI,        //XML ImageData, raw appended Int16
+			EXPORT_VTI_ZLIB    //XML ImageData, zlib compressed appended Int16 (requires a build with zlib)
+		};
+	protected:
+		/**
+		 * Write a block of cells in a file readable by ParaView, the slabs of Z are decoded on workerThreadCount threads
+		 * @param showProgression Print the progression, only done when a single file is written at once
+		 */
+		void WriteVTKBlock(const std::string& filename,const ivec3& blockOrigin,const ivec3& blockShape,EXPORT_FORMAT format,unsigned int workerThreadCount,bool showProgression);
 	public:
 		/**
 		 * Constructeur
@@ -97,14 +176,85 @@ namespace ScalarFieldBuilders
 		 * @param boxMin Coordonnées minimale des objets qui alimenteront la matrice
 		 * @param boxMax Coordonnées maximale des objets qui alimenteront la matrice
 		 */
-        void FirstStep_Params(const dvec3& boxMin,const dvec3& boxMax);
+        virtual void FirstStep_Params(const dvec3& boxMin,const dvec3& boxMax);
 		virtual ~ScalarFieldCreator();
 
 		/**
 		 * Une fois toutes les primitives renseignées. Cette méthode doit être appelée afin de détecter les volumes délimité par les limites.
+		 * The connected empty runs are labeled by slabs of X columns in parallel, the resulting volume ids do not depend on the thread count.
 		 */
 		void ThirdStep_VolumesCreator();
 
+		/**
+		 * The cells of these markers do not stop the volumes propagation, the volumes on both sides get the same id.
+		 * The cells keep their marker value. Labeling methods can be called again with other transparent markers,
+		 * the surfaces are kept aside by the first labeling so the triangles do not need to be pushed again.
+		 * @param markers Surface markers, empty to restore the default behaviour
+		 */
+		void SetTransparentMarkers(const std::vector<SpatialDiscretization::weight_t>& markers);
+		std::vector<SpatialDiscretization::weight_t> GetTransparentMarkers();
+		/**
+		 * Remove the labels from the matrix, only the surfaces and the empty cells remain.
+		 * Called before new triangles are pushed in a labeled matrix.
+		 */
+		void RestoreSurfaces();
+
+		/**
+		 * Label only the volumes that contain the seeds, instead of ThirdStep_VolumesCreator.
+		 * The exterior volume is filled, then each seed volume is filled from the seed cell. The other empty cells keep the empty value.
+		 * @param seeds Coordinates of points inside the volumes to label
+		 * @return For each seed the cell value at the seed position (volume id, exterior id, or marker if the seed is on a non transparent surface)
+		 */
+		std::vector<SpatialDiscretization::weight_t> LabelVolumesFromSeeds(const std::vector<dvec3>& seeds);
+
+		/**
+		 * Check if the volume that contains the seed is closed, without labeling the matrix.
+		 * The fill stops as soon as it meets the exterior volume. The seeds on a surface or in a run at an end of its column
+		 * are rejected from the matrix cells, before the runs are built. On a labeled field without its surfaces (loaded from a file
+		 * saved without them) the answer is read from the label of the seed cell, with the transparent surfaces of that labeling.
+		 * @return False if the seed volume is connected to the exterior or if the seed is on a surface
+		 */
+		bool IsSeedEnclosed(const dvec3& seed);
+
+		/**
+		 * Set the number of threads used by the parallel steps
+		 * @param _threadCount Thread count, 0 to use all hardware threads (default)
+		 */
+		void SetThreadCount(const unsigned int& _threadCount);
+		unsigned int GetThreadCount();
+
+		/**
+		 * Enclosed volumes smaller than this value are merged while labeling instead of getting their own volume id
+		 * @param _minimalVolume Minimal volume in m^3, 0 to keep all the volumes (default)
+		 */
+		void SetMinimalVolume(const double_t& _minimalVolume);
+		double_t GetMinimalVolume();
+		/**
+		 * Enclosed volumes with less cells than this count are merged while labeling instead of getting their own volume id
+		 * @param _minimalCellCount Minimal cell count, 0 to keep all the volumes (default)
+		 */
+		void SetMinimalCellCount(const std::size_t& _minimalCellCount);
+		std::size_t GetMinimalCellCount();
+		/**
+		 * Cell value given to the merged volumes
+		 * @param _smallVolumeValue A surface marker, or emptyValue (default) to use the surface that share the most cell faces with each small volume
+		 * @throw std::invalid_argument If the value is below emptyValue
+		 */
+		void SetSmallVolumeValue(const SpatialDiscretization::weight_t& _smallVolumeValue);
+		SpatialDiscretization::weight_t GetSmallVolumeValue();
+		/**
+		 * Minimal cell count of a volume, from the minimal volume and the minimal cell count
+		 */
+		std::size_t ResolveMinimalCellCount();
+		/**
+		 * Number of small volumes merged by the last ThirdStep_VolumesCreator call
+		 */
+		std::size_t GetMergedVolumeCount();
+		/**
+		 * Number of columns labeled by propagation in the last parity labeling, because their crossings were inconsistent
+		 */
+		std::size_t GetParityFallbackColumnCount();
+
 		/**
 		 * Retourne la valeur de la matrice selon les indices des cellules
 		 * @param index Entier positif désignant le n° de cellule.
@@ -136,21 +286,146 @@ namespace ScalarFieldBuilders
 		 */
         double_t GetVolumeValue(const SpatialDiscretization::weight_t& volId);
 
+		/**
+		 * Number of cell values with statistics. Markers, exterior and volumes ids are in [0,GetLabelCount()[.
+		 * Zero if the matrix has not been labeled.
+		 */
+		SpatialDiscretization::weight_t GetLabelCount();
+		/**
+		 * Statistics of a cell value, computed by the labeling step
+		 */
+		const labelStatistics_t& GetLabelStatistics(const SpatialDiscretization::weight_t& label);
+		/**
+		 * Copy the statistics of all the cell values [0,GetLabelCount()[ in the arrays
+		 * @param cellCount Number of cells
+		 * @param volume Volume in m^3
+		 * @param boundingBox Cell index bounding box min x,y,z (included) max x,y,z (excluded), (GetLabelCount() x 6)
+		 * @param centroid Centroid coordinates in m (GetLabelCount() x 3)
+		 * @param boundaryFaceCount Number of cell faces shared with another cell value
+		 */
+		void CopyLabelStatistics(long long* cellCount,int nCellCount,double* volume,int nVolume,int* boundingBox,int nBox,int nBoxCoord,double* centroid,int nCentroid,int nCentroidCoord,long long* boundaryFaceCount,int nFaces);
+
         void GetMinMax(dvec3& minBox,dvec3& maxBox);
 
+		/**
+		 * Flat copy of the matrix runs. Kept from the labeling step, or copied from the matrix on the first call.
+		 */
+		const SpatialDiscretization::RunMatrix& GetRunMatrix();
+		/**
+		 * Shared reference on the run matrix, it stays valid when the field drops or replaces its runs
+		 */
+		PTR<SpatialDiscretization::RunMatrix> GetSharedRunMatrix();
+		/**
+		 * Build the index of the runs of each cell value, done on the first call of the methods that need it.
+		 * Extraction and export of a single volume are then proportional to the volume size instead of the domain size.
+		 */
+		void BuildLabelRunIndex();
+		/**
+		 * Number of runs with the cell value
+		 */
+		std::size_t GetLabelRunCount(const SpatialDiscretization::weight_t& label);
+		/**
+		 * Copy the runs with the cell value
+		 * @param runs For each run cell index i,j and Z range zBegin (included) zEnd (excluded), (GetLabelRunCount(label) x 4)
+		 */
+		void CopyLabelRuns(const SpatialDiscretization::weight_t& label,int* runs,int nRuns,int nRunCoord);
+		/**
+		 * Compute the block that contains the cells of a volume
+		 * @param volId Cell value of the volume
+		 * @param padding Number of cells added on each side of the bounding box, the block is clipped to the domain
+		 * @param[out] origin First cell of the block
+		 * @param[out] shape Cell count of the block, zero if there is no cell with this value
+		 */
+		void GetVolumeBlock(const SpatialDiscretization::weight_t& volId,const int& padding,ivec3& origin,ivec3& shape);
+		/**
+		 * Copy the block that contains the cells of a volume in a single call.
+		 * The padding cells hold the values of the neighbour cells of the matrix.
+		 * @param volId Cell value of the volume
+		 * @param padding Number of cells added on each side of the bounding box, the block is clipped to the domain
+		 * @param[out] block Cell values in i,j,k order (k varies fastest)
+		 * @param[out] shape Cell count of the block
+		 * @param filter If not NULL, the values in [0,nIndex[ are replaced by filter[value], other cells get emptyValue
+		 * @return First cell of the block
+		 */
+		ivec3 ExtractVolume(const SpatialDiscretization::weight_t& volId,const int& padding,std::vector<SpatialDiscretization::weight_t>& block,ivec3& shape,const SpatialDiscretization::weight_t* filter=NULL,int nIndex=0);
+
 		/**
 		 * Exporte les indices et volumes des domaines
 		 * @param fileName Nom et chemin du fichier de sortie
 		 * @param volsLabelsFileName Nom et chemin du fichier d'entrée des noms utilisateur de volume (fichier texte avec "x y z NomDuVolume" à chaque ligne)
 		 */
 		void ExportVolsStats(const std::string& fileName, const std::string& volsLabelsFileName=std::string());
+		/**
+		 * Write the domain parameters, the runs and the label statistics of the field in a .fvx file
+		 */
+		void Save(const std::string& path);
+		void Save(std::ostream& stream);
+		/**
+		 * Read a .fvx file written by Save. The file is memory mapped and the read methods use the runs of the mapping
+		 * without copy. The matrix is rebuilt from the runs only when it is modified (new triangles or labeling).
+		 */
+		void Load(const std::string& path);
+		/**
+		 * Size in bytes of the .fvx serialization of the field
+		 */
+		std::size_t GetSerializedSize();
+		/**
+		 * Write the .fvx serialization of the field in a buffer of GetSerializedSize() bytes
+		 */
+		void Serialize(unsigned char* data,long long size);
+		/**
+		 * Read the field from a copy of a .fvx serialization, throw std::runtime_error if the data is not a valid field
+		 */
+		void Deserialize(const unsigned char* data,long long size);
 		///////////////////////////////
 		// Debug Functions
 		unsigned int count();
 		void MakeXYZ(const std::string& filename,const SpatialDiscretization::weight_t& idVol);
+		/**
+		 * Write the cell and value of the points of a text file, a line "id i j k value" per line "id x y z". The file is
+		 * parsed by chunks of lines in parallel and the points are resolved by QueryPoints. The blank and malformed lines, and the
+		 * lines whose id is not an integer, are skipped.
+		 */
 		void ExportIJKData(const std::string& Infilename,const std::string& Outfilename);
         void MakeXYZ(const std::string& filename,const double_t& minVol);
-		void ExportVTK(const std::string& filename,const SpatialDiscretization::weight_t& idVol=-1);
+		/**
+		 * Write the cell values of a volume, or of all the surfaces, in a file readable by ParaView.
+		 * The cells are decoded from the runs by slabs of Z, the whole block is never in memory.
+		 * The slabs are decoded and compressed on threadCount threads and written in order.
+		 * @param idVol Volume index, -1 to export the bounding box of the surfaces
+		 * @param format File format
+		 */
+		void ExportVTK(const std::string& filename,const SpatialDiscretization::weight_t& idVol=-1,EXPORT_FORMAT format=EXPORT_VTK_ASCII);
+		/**
+		 * Write each volume in its own file, the volume id is inserted before the extension of filename (room.vtk gives room_12.vtk).
+		 * The blocks of all the volumes are found at once and the files are written in parallel.
+		 * @param volumeIds Cell values of the volumes, the volumes without cells and the repeated ids are skipped
+		 * @param format File format
+		 * @throw std::invalid_argument If an id is negative, ExportVTK writes the whole domain
+		 */
+		void ExportVolumesVTK(const std::string& filename,const std::vector<SpatialDiscretization::weight_t>& volumeIds,EXPORT_FORMAT format=EXPORT_VTK_ASCII);
+		/**
+		 * Write the cells of a block in a NumPy .npy file (little endian Int16, C order: k varies fastest), readable with numpy.load(mmap_mode='r').
+		 * The cells are decoded from the runs by slabs of X, the whole block is never in memory.
+		 * @param origin First cell of the block
+		 * @param shape Cell count of the block, the cells out of the domain get emptyValue
+		 */
+		void ExportNpy(const std::string& filename,const ivec3& origin,const ivec3& shape);
+		/**
+		 * ExportNpy where the values in [0,nIndex[ are replaced by filter[value], other cells get emptyValue
+		 */
+		void ExportNpyFiltered(const std::string& filename,const ivec3& origin,const ivec3& shape,const SpatialDiscretization::weight_t* filter,int nIndex);
+		/**
+		 * Write the cells of the domain in a directory of cubic chunks, for random access reads of sub-blocks.
+		 * Each chunk file holds the little endian Int16 cells of the chunk in C order (k varies fastest), zlib compressed
+		 * if FastVoxel is built with zlib. Chunks on the upper sides of the domain are clipped to it.
+		 * index.json gives the domain shape, the chunk shape, the compression and the chunk file name pattern.
+		 * The chunks are decoded and written on threadCount threads. The index and the chunk files of a previous export
+		 * to the same directory that are outside of the new chunk grid are removed.
+		 * @param directory Output directory, created if it does not exist
+		 * @param chunkSize Cell count of the chunks on each axis
+		 */
+		void ExportChunks(const std::string& directory,const int& chunkSize=64);
 		std::size_t GetDomainSize();
 		bool CheckDiscretisation();
 		SpatialDiscretization::weight_t GetLargestVolumeId();
@@ -165,13 +440,54 @@ namespace ScalarFieldBuilders
          */
         void CopyMatrix(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos);
         void CopyMatrixFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& extractPos,const SpatialDiscretization::weight_t* data_filter,int nindex );
+        /**
+         * Copy the cells start+(i,j,k)*step of the matrix, throw std::out_of_range if a cell is out of the domain
+         * @param data Previously allocated data (ni x nj x nk)
+         * @param step Cell step on each axis, negative steps copy in decreasing order
+         */
+        void CopyMatrixStrided(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& start,const ivec3& step);
+        void CopyMatrixStridedFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const ivec3& start,const ivec3& step,const SpatialDiscretization::weight_t* data_filter,int nindex);
+        /**
+         * Copy the cells (xIndex[i],yIndex[j],zIndex[k]) of the matrix, throw std::out_of_range if a cell is out of the domain
+         * @param data Previously allocated data (nx x ny x nz)
+         */
+        void CopyMatrixIndexed(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const int* xIndex,int nx,const int* yIndex,int ny,const int* zIndex,int nz);
+        void CopyMatrixIndexedFiltered(SpatialDiscretization::weight_t* data,int ni,int nj,int nk,const int* xIndex,int nx,const int* yIndex,int ny,const int* zIndex,int nz,const SpatialDiscretization::weight_t* data_filter,int nindex);
         /**
 		 * Retourne l'indice de la cellule contenant le point passé en paramètre
 		 */
         ivec3 GetCellIdByCoord(const dvec3& position);
+        /**
+         * Cell (as GetCellIdByCoord) and value of each point. The points are sorted by column and the runs of each column
+         * are walked once for all its points, the columns are read by slabs of X in parallel.
+         * Throw std::invalid_argument if the arrays do not have one row of 3 values per point.
+         * @param points pointCount rows of x,y,z
+         * @param[out] cells pointCount rows of i,j,k
+         * @param[out] labels Value of the cell of each point, -1 for the points outside of the domain
+         */
+        void QueryPoints(const double* points,int pointCount,int pointDim,int* cells,int cellCount,int cellDim,SpatialDiscretization::weight_t* labels,int labelCount);
 
 		void GetCellValueBoundaries(ivec3& min,ivec3& max,const SpatialDiscretization::weight_t& volid);
 	};
+	/**
+	 * Views on the run arrays of a field, without copy. The runs of column (i,j) are
+	 * [columnOffset[i*GetDomainSize()+j],columnOffset[i*GetDomainSize()+j+1][, they cover the Z range of the column in order.
+	 * The runs are shared with the field and stay valid as long as this object, even when the field is modified, labeled again or deleted.
+	 */
+	class RunViews
+	{
+	public:
+		explicit RunViews(ScalarFieldCreator& field);
+		/**
+		 * @param[out] columnOffset First run of each column followed by the run count (GetDomainSize()^2+1 values)
+		 * @param[out] runEnd Last Z+1 of each run
+		 * @param[out] runValue Cell value of each run
+		 */
+		void GetViews(unsigned long long** columnOffset,int* nColumnOffset,unsigned int** runEnd,int* nRunEnd,SpatialDiscretization::weight_t** runValue,int* nRunValue);
+	private:
+		PTR<SpatialDiscretization::RunMatrix> runs;
+		std::vector<unsigned long long> wideColumnOffset; //Copy of the column offsets when std::size_t is not 64 bits
+	};
 
 }
 
@@ -22,3 +22,65 @@
  */
 #include "spatial_discretization.hpp"
 
+#include <tools/parallel_for.hpp>
+
+namespace SpatialDiscretization {
+    void RunMatrix::Build(weight_matrix &matrix, const unsigned int &threadCount, std::vector<zcell *> *runCell) {
+        size = matrix.size();
+        columnOffset.assign((std::size_t) size * size + 1, 0);
+        parallel_tools::ParallelFor(threadCount, 0, size, [&](std::size_t xBegin, std::size_t xEnd, unsigned int) {
+            for (std::size_t cell_x = xBegin; cell_x < xEnd; cell_x++) {
+                for (cell_id_t cell_y = 0; cell_y < size; cell_y++) {
+                    std::size_t runCount(1);
+                    zcell *currentCell = &(matrix[cell_x][cell_y]);
+                    while (currentCell->Next(&currentCell))
+                        runCount++;
+                    columnOffset[ColumnIndex(cell_x, cell_y) + 1] = runCount;
+                }
+            }
+        });
+        for (std::size_t column = 1; column < columnOffset.size(); column++)
+            columnOffset[column] += columnOffset[column - 1];
+        std::size_t runCount(columnOffset.back());
+        runEnd.resize(runCount);
+        runData.resize(runCount);
+        if (runCell)
+            runCell->resize(runCount);
+        parallel_tools::ParallelFor(threadCount, 0, size, [&](std::size_t xBegin, std::size_t xEnd, unsigned int) {
+            for (std::size_t cell_x = xBegin; cell_x < xEnd; cell_x++) {
+                for (cell_id_t cell_y = 0; cell_y < size; cell_y++) {
+                    std::size_t idRun(columnOffset[ColumnIndex(cell_x, cell_y)]);
+                    cell_id_t cell_z(0);
+                    zcell *currentCell = &(matrix[cell_x][cell_y]);
+                    while (currentCell) {
+                        cell_z += currentCell->GetSize();
+                        runEnd[idRun] = cell_z;
+                        runData[idRun] = currentCell->GetData();
+                        if (runCell)
+                            (*runCell)[idRun] = currentCell;
+                        idRun++;
+                        currentCell->Next(&currentCell);
+                    }
+                }
+            }
+        });
+    }
+
+    void RunMatrix::Expand(weight_matrix &matrix, const domainInformation_t &domainInformation, const unsigned int &threadCount) const {
+        parallel_tools::ParallelFor(threadCount, 0, size, [&](std::size_t xBegin, std::size_t xEnd, unsigned int) {
+            for (std::size_t cell_x = xBegin; cell_x < xEnd; cell_x++) {
+                for (cell_id_t cell_y = 0; cell_y < size; cell_y++) {
+                    std::size_t column(ColumnIndex(cell_x, cell_y));
+                    std::size_t idRun(columnOffset[column]);
+                    zcell *currentCell = &(matrix[cell_x][cell_y]);
+                    currentCell->Resize(runEnd[idRun], domainInformation);
+                    currentCell->SetData(runData[idRun]);
+                    for (idRun++; idRun < columnOffset[column + 1]; idRun++) {
+                        currentCell->InsertCellAfter(runEnd[idRun] - runEnd[idRun - 1], runData[idRun], domainInformation);
+                        currentCell->Next(&currentCell);
+                    }
+                }
+            }
+        });
+    }
+}
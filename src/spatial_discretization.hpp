@@ -31,7 +31,10 @@
 #endif
 
 #include <Core/mathlib.h> //Mathlib de libinterface
+#include <tools/file_mapping.hpp>
 #include <stdexcept>
+#include <vector>
+#include <algorithm>
 
 #ifndef __SPATIAL_DISCRETIZATION__
 #define __SPATIAL_DISCRETIZATION__
@@ -315,6 +318,201 @@ namespace SpatialDiscretization {
     typedef PTR<Cell<weight_t> > zcell_ptr_t;
     typedef Cell<weight_t> zcell;
     typedef CellArray<CellArray<zcell> > weight_matrix;
+
+    /**
+     * Array of the run matrix, holds its own values or points into a file mapping (see ScalarFieldCreator::Load).
+     * A copy always holds its own values.
+     */
+    template<typename T>
+    class RunArray {
+    public:
+        RunArray() : values(NULL), count(0) {
+        }
+
+        RunArray(const RunArray &other) : values(NULL), count(0) {
+            *this = other;
+        }
+
+        RunArray &operator=(const RunArray &other) {
+            if (this != &other)
+                Assign(other.begin(), other.end());
+            return *this;
+        }
+
+        RunArray &operator=(const std::vector<T> &other) {
+            Assign(other.empty() ? NULL : &other[0], other.empty() ? NULL : &other[0] + other.size());
+            return *this;
+        }
+
+        /**
+         * Point to count values of the mapping, the mapping is kept alive by the array
+         */
+        void Map(const PTR<file_tools::FileMapping> &_mapping, T *mappedValues, const std::size_t &mappedCount) {
+            owned.clear();
+            mapping = _mapping;
+            values = mappedValues;
+            count = mappedCount;
+        }
+
+        bool IsMapped() const {
+            return mapping.get() != NULL;
+        }
+
+        std::size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        T &operator[](const std::size_t &id) {
+            return values[id];
+        }
+
+        const T &operator[](const std::size_t &id) const {
+            return values[id];
+        }
+
+        T *begin() {
+            return values;
+        }
+
+        T *end() {
+            return values + count;
+        }
+
+        const T *begin() const {
+            return values;
+        }
+
+        const T *end() const {
+            return values + count;
+        }
+
+        T &back() {
+            return values[count - 1];
+        }
+
+        const T &back() const {
+            return values[count - 1];
+        }
+
+        void resize(const std::size_t &newCount, const T &value = T()) {
+            if (IsMapped())
+                Assign(begin(), begin() + std::min(count, newCount));
+            owned.resize(newCount, value);
+            Sync();
+        }
+
+        void assign(const std::size_t &newCount, const T &value) {
+            mapping = PTR<file_tools::FileMapping>();
+            owned.assign(newCount, value);
+            Sync();
+        }
+
+        void clear() {
+            mapping = PTR<file_tools::FileMapping>();
+            owned.clear();
+            Sync();
+        }
+
+    private:
+        void Assign(const T *first, const T *last) {
+            std::vector<T> copy(first, last);
+            owned.swap(copy);
+            mapping = PTR<file_tools::FileMapping>();
+            Sync();
+        }
+
+        void Sync() {
+            values = owned.empty() ? NULL : &owned[0];
+            count = owned.size();
+        }
+
+        std::vector<T> owned;
+        PTR<file_tools::FileMapping> mapping;
+        T *values;
+        std::size_t count;
+    };
+
+    /**
+     * Flat copy of the run lists of a weight_matrix.
+     * The runs of the column (x,y) are [columnOffset[ColumnIndex(x,y)],columnOffset[ColumnIndex(x,y)+1][ in increasing Z order,
+     * so the run index follow the X,Y,Z scan order of the matrix.
+     */
+    struct RunMatrix {
+        RunMatrix() : size(0) {
+        }
+
+        cell_id_t size;
+        RunArray<std::size_t> columnOffset;
+        RunArray<cell_id_t> runEnd; //Last Z+1 of the run
+        RunArray<weight_t> runData;
+
+        /**
+         * Copy the runs of the matrix, the columns are read by slabs of X in parallel
+         * @param[out] runCell If not NULL, receive the matrix cell of each run
+         */
+        void Build(weight_matrix &matrix, const unsigned int &threadCount, std::vector<zcell *> *runCell = NULL);
+
+        /**
+         * Write the runs in a new matrix of the same size, the columns are written by slabs of X in parallel
+         */
+        void Expand(weight_matrix &matrix, const domainInformation_t &domainInformation, const unsigned int &threadCount) const;
+
+        std::size_t ColumnIndex(const std::size_t &x, const std::size_t &y) const {
+            return x * size + y;
+        }
+
+        std::size_t GetRunCount() const {
+            return runData.size();
+        }
+
+        /**
+         * Column of a run, O(log(column count))
+         */
+        std::size_t FindColumn(const std::size_t &idRun) const {
+            return std::upper_bound(columnOffset.begin(), columnOffset.end(), idRun) - columnOffset.begin() - 1;
+        }
+
+        /**
+         * First Z of the run
+         */
+        cell_id_t RunBegin(const std::size_t &column, const std::size_t &idRun) const {
+            return idRun == columnOffset[column] ? 0 : runEnd[idRun - 1];
+        }
+
+        /**
+         * Index of the run of the column that contains the Z position
+         */
+        std::size_t FindRun(const std::size_t &column, const cell_id_t &cell_z) const {
+            return std::upper_bound(runEnd.begin() + columnOffset[column], runEnd.begin() + columnOffset[column + 1],
+                                    cell_z) - runEnd.begin();
+        }
+
+        weight_t GetValue(const cell_id_t &x, const cell_id_t &y, const cell_id_t &z) const {
+            return runData[FindRun(ColumnIndex(x, y), z)];
+        }
+
+        /**
+         * Write the values of the cells [zBegin,zEnd[ of a column in destination
+         * @param filter If not NULL, the values in [0,filterSize[ are replaced by filter[value], the other cells are not written
+         */
+        void DecodeColumn(const std::size_t &column, const cell_id_t &zBegin, const cell_id_t &zEnd, weight_t *destination,
+                          const weight_t *filter = NULL, const int &filterSize = 0) const {
+            cell_id_t cell_z(zBegin);
+            for (std::size_t idRun = FindRun(column, zBegin); cell_z < zEnd; idRun++) {
+                cell_id_t runStop(std::min(runEnd[idRun], zEnd));
+                const weight_t &value(runData[idRun]);
+                if (!filter)
+                    std::fill(destination + (cell_z - zBegin), destination + (runStop - zBegin), value);
+                else if (value >= 0 && value < filterSize)
+                    std::fill(destination + (cell_z - zBegin), destination + (runStop - zBegin), filter[value]);
+                cell_z = runStop;
+            }
+        }
+    };
 }
 
 #endif
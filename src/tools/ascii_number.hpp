@@ -0,0 +1,145 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#ifndef __ASCII_NUMBER_H__
+#define __ASCII_NUMBER_H__
+
+#include <algorithm>
+#include <climits>
+#include <locale>
+#include <sstream>
+#include <string>
+
+namespace file_tools
+{
+    /**
+     * Parse a number of a text file whatever the locale. The numbers of up to 15 significant digits with a small
+     * exponent are computed exactly, the other ones are read by a stream in the classic locale.
+     * @param cursor Moved after the number
+     * @return False if there is no number before the end of the line or the number is followed by other characters than spaces
+     */
+    inline bool ParseAsciiNumber(const char*& cursor,const char* lineEnd,double& value)
+    {
+        static const double powerOfTen[]={1e0,1e1,1e2,1e3,1e4,1e5,1e6,1e7,1e8,1e9,1e10,1e11,1e12,1e13,1e14,1e15,1e16,1e17,1e18,1e19,1e20,1e21,1e22};
+        while(cursor<lineEnd && (*cursor==' ' || *cursor=='\t' || *cursor=='\r'))
+            cursor++;
+        const char* tokenBegin(cursor);
+        bool negative(false);
+        if(cursor<lineEnd && (*cursor=='-' || *cursor=='+'))
+        {
+            negative=(*cursor=='-');
+            cursor++;
+        }
+        unsigned long long mantissa(0);
+        int significantDigits(0),digitCount(0),exponent(0);
+        for(;cursor<lineEnd && *cursor>='0' && *cursor<='9';cursor++,digitCount++)
+        {
+            if(significantDigits<19)
+            {
+                mantissa=mantissa*10+(*cursor-'0');
+                if(mantissa>0)
+                    significantDigits++;
+            }else
+                exponent++;
+        }
+        if(cursor<lineEnd && *cursor=='.')
+        {
+            for(cursor++;cursor<lineEnd && *cursor>='0' && *cursor<='9';cursor++,digitCount++)
+            {
+                if(significantDigits<19)
+                {
+                    mantissa=mantissa*10+(*cursor-'0');
+                    if(mantissa>0)
+                        significantDigits++;
+                    exponent--;
+                }
+            }
+        }
+        if(digitCount==0)
+            return false;
+        if(cursor<lineEnd && (*cursor=='e' || *cursor=='E'))
+        {
+            cursor++;
+            bool negativeExponent(false);
+            if(cursor<lineEnd && (*cursor=='-' || *cursor=='+'))
+            {
+                negativeExponent=(*cursor=='-');
+                cursor++;
+            }
+            if(cursor>=lineEnd || *cursor<'0' || *cursor>'9')
+                return false;
+            int exponentValue(0);
+            for(;cursor<lineEnd && *cursor>='0' && *cursor<='9';cursor++)
+                exponentValue=std::min(exponentValue*10+(*cursor-'0'),100000);
+            exponent+=negativeExponent ? -exponentValue : exponentValue;
+        }
+        if(cursor<lineEnd && *cursor!=' ' && *cursor!='\t' && *cursor!='\r')
+            return false;
+        if(significantDigits<=15 && exponent>=-22 && exponent<=22)
+        {
+            value=exponent<0 ? (double)mantissa/powerOfTen[-exponent] : (double)mantissa*powerOfTen[exponent];
+        }else{
+            std::istringstream token(std::string(tokenBegin,cursor));
+            token.imbue(std::locale::classic());
+            if(!(token>>value))
+                return false;
+            return true;
+        }
+        if(negative)
+            value=-value;
+        return true;
+    }
+
+    /**
+     * Parse an integer of a text file, without decimal part nor exponent
+     * @param cursor Moved after the integer
+     * @return False if there is no integer before the end of the line, it does not fit in a long long or it is followed by
+     * other characters than spaces
+     */
+    inline bool ParseAsciiInteger(const char*& cursor,const char* lineEnd,long long& value)
+    {
+        while(cursor<lineEnd && (*cursor==' ' || *cursor=='\t' || *cursor=='\r'))
+            cursor++;
+        bool negative(false);
+        if(cursor<lineEnd && (*cursor=='-' || *cursor=='+'))
+        {
+            negative=(*cursor=='-');
+            cursor++;
+        }
+        if(cursor>=lineEnd || *cursor<'0' || *cursor>'9')
+            return false;
+        unsigned long long magnitude(0);
+        for(;cursor<lineEnd && *cursor>='0' && *cursor<='9';cursor++)
+        {
+            magnitude=magnitude*10+(*cursor-'0');
+            if(magnitude>(unsigned long long)LLONG_MAX+1)
+                return false;
+        }
+        if(cursor<lineEnd && *cursor!=' ' && *cursor!='\t' && *cursor!='\r')
+            return false;
+        if(!negative && magnitude>(unsigned long long)LLONG_MAX)
+            return false;
+        value=negative ? (long long)(0-magnitude) : (long long)magnitude;
+        return true;
+    }
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin
+ * This project is the production of IFSTTAR (www.ifsttar.fr)
+ * @copyright GNU Public License.V3
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#ifndef __CONCURRENT_UNION_FIND_H__
+#define __CONCURRENT_UNION_FIND_H__
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace parallel_tools
+{
+    /**
+     * Lock-free disjoint set forest.
+     * Roots are always linked toward the lowest index, so once all Unite calls are done
+     * the root of a set is its smallest element whatever the order or the thread count of the calls.
+     */
+    class ConcurrentUnionFind
+    {
+    public:
+        typedef unsigned int node_t;
+
+        explicit ConcurrentUnionFind(std::size_t nodeCount)
+            : parent(nodeCount)
+        {
+            for(std::size_t node = 0; node < nodeCount; node++)
+                parent[node].store((node_t)node, std::memory_order_relaxed);
+        }
+
+        std::size_t size() const
+        {
+            return parent.size();
+        }
+
+        /**
+         * Return the current root of the node, compress the path on the way (path halving)
+         */
+        node_t Find(node_t node)
+        {
+            node_t nodeParent(parent[node].load(std::memory_order_relaxed));
+            while(nodeParent != node)
+            {
+                node_t grandParent(parent[nodeParent].load(std::memory_order_relaxed));
+                if(grandParent != nodeParent)
+                    parent[node].compare_exchange_weak(nodeParent, grandParent, std::memory_order_relaxed);
+                node = nodeParent;
+                nodeParent = parent[node].load(std::memory_order_relaxed);
+            }
+            return node;
+        }
+
+        /**
+         * Merge the sets of the two nodes. Can be called concurrently.
+         */
+        void Unite(node_t first, node_t second)
+        {
+            while(true)
+            {
+                first = Find(first);
+                second = Find(second);
+                if(first == second)
+                    return;
+                if(first < second)
+                    std::swap(first, second);
+                //first is the highest root, it must still be a root to be linked
+                node_t expected(first);
+                if(parent[first].compare_exchange_strong(expected, second, std::memory_order_acq_rel))
+                    return;
+            }
+        }
+    private:
+        std::vector<std::atomic<node_t> > parent;
+    };
+}
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin
+ * This project is the production of IFSTTAR (www.ifsttar.fr)
+ * @copyright GNU Public License.V3
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#ifndef __FILE_MAPPING_H__
+#define __FILE_MAPPING_H__
+
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <direct.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace file_tools
+{
+    /**
+     * Create a directory, nothing is done if it already exists
+     * @return False if the directory does not exist and can not be created
+     */
+    inline bool MakeDirectory(const std::string& path)
+    {
+#ifdef _WIN32
+        if(_mkdir(path.c_str()) == 0)
+            return true;
+        DWORD attributes(GetFileAttributesA(path.c_str()));
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+        if(mkdir(path.c_str(), 0777) == 0)
+            return true;
+        struct stat directoryStat;
+        return stat(path.c_str(), &directoryStat) == 0 && S_ISDIR(directoryStat.st_mode);
+#endif
+    }
+
+    /**
+     * Names of the entries of a directory that end with the suffix, nothing if the directory can not be read
+     */
+    inline std::vector<std::string> ListDirectory(const std::string& path, const std::string& suffix)
+    {
+        std::vector<std::string> names;
+#ifdef _WIN32
+        WIN32_FIND_DATAA findData;
+        HANDLE findHandle(FindFirstFileA((path + "\\*" + suffix).c_str(), &findData));
+        if(findHandle != INVALID_HANDLE_VALUE)
+        {
+            do
+            {
+                names.push_back(findData.cFileName);
+            } while(FindNextFileA(findHandle, &findData));
+            FindClose(findHandle);
+        }
+#else
+        DIR* dir(opendir(path.c_str()));
+        if(dir)
+        {
+            while(struct dirent* entry = readdir(dir))
+            {
+                std::string name(entry->d_name);
+                if(name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+                    names.push_back(name);
+            }
+            closedir(dir);
+        }
+#endif
+        return names;
+    }
+
+    /**
+     * Read only view of a whole file mapped in memory, or of a copied memory buffer.
+     * The file pages are private (copy on write): writing in the view never modify the file.
+     */
+    class FileMapping
+    {
+    public:
+        /**
+         * Map the file, throw std::runtime_error if the file can not be opened or mapped
+         */
+        explicit FileMapping(const std::string& path)
+            : data(NULL), size(0)
+#ifdef _WIN32
+            , file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+        {
+#ifdef _WIN32
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if(file == INVALID_HANDLE_VALUE)
+                throw std::runtime_error("Can not open " + path);
+            LARGE_INTEGER fileSize;
+            GetFileSizeEx(file, &fileSize);
+            size = (std::size_t)fileSize.QuadPart;
+            if(size > 0)
+            {
+                mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+                if(mapping)
+                    data = (char*)MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+                if(!data)
+                {
+                    Close();
+                    throw std::runtime_error("Can not map " + path);
+                }
+            }
+#else
+            int fd(open(path.c_str(), O_RDONLY));
+            if(fd < 0)
+                throw std::runtime_error("Can not open " + path);
+            struct stat fileStat;
+            if(fstat(fd, &fileStat) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Can not read the size of " + path);
+            }
+            size = (std::size_t)fileStat.st_size;
+            if(size > 0)
+            {
+                void* view(mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0));
+                if(view == MAP_FAILED)
+                {
+                    close(fd);
+                    throw std::runtime_error("Can not map " + path);
+                }
+                data = (char*)view;
+            }
+            close(fd); //The mapping keeps its own reference to the file
+#endif
+        }
+
+        /**
+         * Copy of a memory buffer, for the data that does not come from a file
+         */
+        FileMapping(const char* buffer, std::size_t bufferSize)
+            : data(NULL), size(bufferSize), copy(bufferSize)
+#ifdef _WIN32
+            , file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+        {
+            if(size > 0)
+            {
+                memcpy(&copy[0], buffer, size);
+                data = &copy[0];
+            }
+        }
+
+        ~FileMapping()
+        {
+            Close();
+        }
+
+        char* GetData() const
+        {
+            return data;
+        }
+
+        std::size_t GetSize() const
+        {
+            return size;
+        }
+    private:
+        FileMapping(const FileMapping&);
+        FileMapping& operator=(const FileMapping&);
+
+        void Close()
+        {
+            if(copy.empty())
+            {
+#ifdef _WIN32
+                if(data)
+                    UnmapViewOfFile(data);
+                if(mapping)
+                    CloseHandle(mapping);
+                if(file != INVALID_HANDLE_VALUE)
+                    CloseHandle(file);
+                mapping = NULL;
+                file = INVALID_HANDLE_VALUE;
+#else
+                if(data)
+                    munmap(data, size);
+#endif
+            }
+            data = NULL;
+        }
+
+        char* data;
+        std::size_t size;
+        std::vector<char> copy; //Owned values when the view is not a file
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+    };
+}
+
+#endif
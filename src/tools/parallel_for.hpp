@@ -0,0 +1,102 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin
+ * This project is the production of IFSTTAR (www.ifsttar.fr)
+ * @copyright GNU Public License.V3
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+
+#ifndef __PARALLEL_FOR_H__
+#define __PARALLEL_FOR_H__
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace parallel_tools
+{
+    /**
+     * Number of threads to use for a job
+     * @param requested Thread count asked by the user, 0 for all hardware threads
+     * @param workSize Number of work items, no more threads than items are started
+     */
+    inline unsigned int ResolveThreadCount(unsigned int requested, std::size_t workSize)
+    {
+        unsigned int threadCount(requested);
+        if(threadCount == 0)
+            threadCount = std::thread::hardware_concurrency();
+        if(threadCount == 0)
+            threadCount = 1;
+        if(workSize < threadCount)
+            threadCount = workSize > 0 ? (unsigned int)workSize : 1;
+        return threadCount;
+    }
+
+    /**
+     * Split [begin,end[ in contiguous chunks and process each chunk on its own thread.
+     * Chunk boundaries only depend on the range and the chunk count.
+     * @param chunkCount Number of chunks (and threads) as returned by ResolveThreadCount
+     * @param func Called with (chunkBegin, chunkEnd, chunkIndex)
+     * The first exception thrown by a chunk is rethrown in the calling thread.
+     */
+    template<typename Func>
+    void ParallelFor(unsigned int chunkCount, std::size_t begin, std::size_t end, Func func)
+    {
+        if(end <= begin)
+            return;
+        std::size_t rangeSize(end - begin);
+        if(chunkCount > rangeSize)
+            chunkCount = (unsigned int)rangeSize;
+        if(chunkCount <= 1)
+        {
+            func(begin, end, 0u);
+            return;
+        }
+        std::vector<std::exception_ptr> errors(chunkCount);
+        std::vector<std::thread> workers;
+        workers.reserve(chunkCount - 1);
+        for(unsigned int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            std::size_t chunkBegin(begin + rangeSize * chunk / chunkCount);
+            std::size_t chunkEnd(begin + rangeSize * (chunk + 1) / chunkCount);
+            auto job = [&func, &errors, chunkBegin, chunkEnd, chunk]() {
+                try
+                {
+                    func(chunkBegin, chunkEnd, chunk);
+                } catch(...)
+                {
+                    errors[chunk] = std::current_exception();
+                }
+            };
+            if(chunk + 1 < chunkCount)
+                workers.push_back(std::thread(job));
+            else
+                job(); //The calling thread process the last chunk
+        }
+        for(std::size_t idThread = 0; idThread < workers.size(); idThread++)
+            workers[idThread].join();
+        for(unsigned int chunk = 0; chunk < chunkCount; chunk++)
+        {
+            if(errors[chunk])
+                std::rethrow_exception(errors[chunk]);
+        }
+    }
+}
+
+#endif
@@ -21,9 +21,13 @@
  * Official repository is https://github.com/nicolas-f/FastVoxel
  */
 #include "triangle_feeder.hpp"
-#include <tools/octree44_triangleElement.hpp>
+#include "load_job.hpp"
+#include "triangle_stream.hpp"
 #include <input_output/ply/rply_interface.hpp>
+#include <tools/octree44_triangleElement.hpp>
 #include <cstring>
+#include <algorithm>
+#include <tools/parallel_for.hpp>
 
 #ifndef MINREF
 	#define MINREF(a, b)  if(a>b) a=b;
@@ -76,57 +80,438 @@ namespace ScalarFieldBuilders
 {
 
 	TriangleScalarFieldCreator::TriangleScalarFieldCreator(const decimal& _resolution)
-	:ScalarFieldCreator(_resolution)
+	:ScalarFieldCreator(_resolution),parityMode(false),hasModelBounds(false),jobProgress(NULL),keptTrianglesReleased(false)
+	{
+
+
+	}
+
+	void TriangleScalarFieldCreator::FirstStep_Params(const dvec3& boxMin,const dvec3& boxMax)
 	{
+		std::vector<dvec3>().swap(keptTriangles);
+		std::vector<std::size_t>().swap(crossingOffset);
+		std::vector<double_t>().swap(crossingZ);
+		keptTrianglesReleased=false;
+		ScalarFieldCreator::FirstStep_Params(boxMin,boxMax);
+	}
+
+	void TriangleScalarFieldCreator::LoadMapping(const PTR<file_tools::FileMapping>& mapping)
+	{
+		ScalarFieldCreator::LoadMapping(mapping);
+		std::vector<dvec3>().swap(keptTriangles);
+		std::vector<std::size_t>().swap(crossingOffset);
+		std::vector<double_t>().swap(crossingZ);
+		keptTrianglesReleased=true;
+	}
+
+	void TriangleScalarFieldCreator::SetParityMode(bool _parityMode)
+	{
+		this->parityMode=_parityMode;
+		if(!parityMode)
+		{
+			std::vector<dvec3>().swap(keptTriangles);
+			std::vector<std::size_t>().swap(crossingOffset);
+			std::vector<double_t>().swap(crossingZ);
+		}
+	}
 
+	bool TriangleScalarFieldCreator::GetParityMode()
+	{
+		return this->parityMode;
+	}
 
+	void TriangleScalarFieldCreator::SetJobProgress(JobProgress* _jobProgress)
+	{
+		jobProgress=_jobProgress;
+	}
+	void TriangleScalarFieldCreator::SetModelBounds(const dvec3& boxMin,const dvec3& boxMax)
+	{
+		hasModelBounds=true;
+		modelBoxMin=boxMin;
+		modelBoxMax=boxMax;
+	}
+	bool TriangleScalarFieldCreator::GetModelBounds(dvec3& boxMin,dvec3& boxMax)
+	{
+		if(hasModelBounds)
+		{
+			boxMin=modelBoxMin;
+			boxMax=modelBoxMax;
+		}
+		return hasModelBounds;
+	}
+	void TriangleScalarFieldCreator::ClearModelBounds()
+	{
+		hasModelBounds=false;
+	}
+	void TriangleScalarFieldCreator::SetCache(const std::string& directory,const unsigned long long& maxSize)
+	{
+		if(directory.empty())
+			this->fieldCache=PTR<FieldCache>();
+		else
+			this->fieldCache=PTR<FieldCache>(new FieldCache(directory,maxSize));
+	}
+	std::string TriangleScalarFieldCreator::GetCacheDirectory()
+	{
+		return this->fieldCache.get() ? this->fieldCache->GetDirectory() : std::string();
+	}
+	unsigned long long TriangleScalarFieldCreator::GetCacheMaxSize()
+	{
+		return this->fieldCache.get() ? this->fieldCache->GetMaxSize() : 0;
+	}
+
+	std::string TriangleScalarFieldCreator::GetCacheKey(const Mesh& mesh) const
+	{
+		ContentHash hash;
+		hash.AddString("fastvoxel-cache-1"); //Changed when the labeling gives other results for the same input
+		const std::vector<dvec3>& vertices(mesh.GetVertices());
+		hash.AddValue((unsigned long long)vertices.size());
+		for(std::vector<dvec3>::const_iterator itvert=vertices.begin();itvert!=vertices.end();itvert++)
+		{
+			hash.AddValue(itvert->x);
+			hash.AddValue(itvert->y);
+			hash.AddValue(itvert->z);
+		}
+		const std::vector<unsigned int>& faces(mesh.GetFaces());
+		hash.AddValue((unsigned long long)faces.size());
+		if(!faces.empty())
+			hash.Add(&faces[0],faces.size()*sizeof(unsigned int));
+		const std::vector<SpatialDiscretization::weight_t>& markers(mesh.GetMarkers());
+		if(!markers.empty())
+			hash.Add(&markers[0],markers.size()*sizeof(SpatialDiscretization::weight_t));
+		//The push order of the triangles may change the markers of the shared cells
+		const std::vector<unsigned int>& mortonOrder(mesh.GetMortonOrder());
+		hash.AddValue((char)!mortonOrder.empty());
+		//The thread count does not change the labels
+		hash.AddValue(this->resolution);
+		hash.AddValue(this->minimalVolume);
+		hash.AddValue((unsigned long long)this->minimalCellCount);
+		hash.AddValue(this->smallVolumeValue);
+		hash.AddValue((unsigned long long)this->transparentMarker.size());
+		if(!this->transparentMarker.empty())
+			hash.Add(&this->transparentMarker[0],this->transparentMarker.size());
+		hash.AddValue((char)this->parityMode);
+		//The domain is fitted to the model bounds
+		hash.AddValue((char)this->hasModelBounds);
+		if(this->hasModelBounds)
+		{
+			hash.AddValue(this->modelBoxMin.x);
+			hash.AddValue(this->modelBoxMin.y);
+			hash.AddValue(this->modelBoxMin.z);
+			hash.AddValue(this->modelBoxMax.x);
+			hash.AddValue(this->modelBoxMax.y);
+			hash.AddValue(this->modelBoxMax.z);
+		}
+		return hash.GetHex();
+	}
+
+	bool TriangleScalarFieldCreator::FetchCachedField(const std::string& key)
+	{
+		return this->fieldCache.get() && this->fieldCache->Fetch(key,*this);
+	}
+
+	void TriangleScalarFieldCreator::StoreCachedField(const std::string& key)
+	{
+		if(this->fieldCache.get())
+			this->fieldCache->Store(key,*this);
+	}
+
+	typedef std::pair<double_t,int> crossing_t; //Z in cell units, sign of the triangle normal
+
+	void TriangleScalarFieldCreator::ThirdStep_ParityVolumesCreator()
+	{
+		if(keptTrianglesReleased)
+			throw std::runtime_error("The triangles of the parity labeling have been released, FirstStep_Params must be called and the triangles pushed again");
+		if(crossingOffset.empty())
+			BuildCrossings();
+		this->ThirdStep_VolumesFromCrossings(crossingOffset,crossingZ);
+	}
+
+	void TriangleScalarFieldCreator::BuildCrossings()
+	{
+		using namespace SpatialDiscretization;
+		const cell_id_t size(this->volumeInfo.cellCount);
+		const std::size_t columnCount((std::size_t)size*size);
+		const std::size_t triangleCount(keptTriangles.size()/3);
+		const decimal cellSize(this->volumeInfo.cellSize);
+		const dvec3 zeroCenter(this->volumeInfo.zeroCellCenter);
+		//Columns whose center is in the XY bounding box of the triangle
+		std::vector<ivec2> triangleColumnMin(triangleCount),triangleColumnMax(triangleCount);
+		std::vector<std::size_t> binOffset(columnCount+1,0);
+		for(std::size_t idTri=0;idTri<triangleCount;idTri++)
+		{
+			const dvec3* tri(&keptTriangles[idTri*3]);
+			ivec2& colMin(triangleColumnMin[idTri]);
+			ivec2& colMax(triangleColumnMax[idTri]);
+			colMin.x=(long)ceil((MIN(MIN(tri[0].x,tri[1].x),tri[2].x)-zeroCenter.x)/cellSize);
+			colMin.y=(long)ceil((MIN(MIN(tri[0].y,tri[1].y),tri[2].y)-zeroCenter.y)/cellSize);
+			colMax.x=(long)floor((MAX(MAX(tri[0].x,tri[1].x),tri[2].x)-zeroCenter.x)/cellSize);
+			colMax.y=(long)floor((MAX(MAX(tri[0].y,tri[1].y),tri[2].y)-zeroCenter.y)/cellSize);
+			colMin.x=MAX(colMin.x,0l);colMin.y=MAX(colMin.y,0l);
+			colMax.x=MIN(colMax.x,(long)size-1);colMax.y=MIN(colMax.y,(long)size-1);
+			for(long cell_x=colMin.x;cell_x<=colMax.x;cell_x++)
+				for(long cell_y=colMin.y;cell_y<=colMax.y;cell_y++)
+					binOffset[cell_x*size+cell_y+1]++;
+		}
+		for(std::size_t column=0;column<columnCount;column++)
+			binOffset[column+1]+=binOffset[column];
+		std::vector<unsigned int> binTriangle(binOffset[columnCount]);
+		{
+			std::vector<std::size_t> binFill(binOffset.begin(),binOffset.end()-1);
+			for(std::size_t idTri=0;idTri<triangleCount;idTri++)
+				for(long cell_x=triangleColumnMin[idTri].x;cell_x<=triangleColumnMax[idTri].x;cell_x++)
+					for(long cell_y=triangleColumnMin[idTri].y;cell_y<=triangleColumnMax[idTri].y;cell_y++)
+						binTriangle[binFill[cell_x*size+cell_y]++]=(unsigned int)idTri;
+		}
+		//Crossings of the ray at the center of each column, computed in slabs of X
+		const unsigned int slabCount(parallel_tools::ResolveThreadCount(this->threadCount,size));
+		const double_t zOrigin(zeroCenter.z-cellSize/2.);
+		const double_t mergeEpsilon(1e-6);
+		std::vector<std::vector<crossing_t> > slabCrossings(slabCount);
+		crossingOffset.assign(columnCount+1,0);
+		parallel_tools::ParallelFor(slabCount,0,size,[&](std::size_t xBegin,std::size_t xEnd,unsigned int slab)
+		{
+			std::vector<crossing_t>& crossings(slabCrossings[slab]);
+			std::vector<crossing_t> columnCrossings;
+			for(std::size_t column=xBegin*size;column<xEnd*size;column++)
+			{
+				const double_t px(zeroCenter.x+cellSize*(column/size)),py(zeroCenter.y+cellSize*(column%size));
+				columnCrossings.clear();
+				for(std::size_t idBin=binOffset[column];idBin<binOffset[column+1];idBin++)
+				{
+					const dvec3* tri(&keptTriangles[binTriangle[idBin]*3]);
+					//Signed areas of the edges, the ray cross the triangle if they all have the sign of the triangle
+					double_t area((tri[1].x-tri[0].x)*(tri[2].y-tri[0].y)-(tri[2].x-tri[0].x)*(tri[1].y-tri[0].y));
+					if(area==0)
+						continue; //Parallel to the ray
+					double_t w0((tri[2].x-tri[1].x)*(py-tri[1].y)-(tri[2].y-tri[1].y)*(px-tri[1].x));
+					double_t w1((tri[0].x-tri[2].x)*(py-tri[2].y)-(tri[0].y-tri[2].y)*(px-tri[2].x));
+					double_t w2((tri[1].x-tri[0].x)*(py-tri[0].y)-(tri[1].y-tri[0].y)*(px-tri[0].x));
+					if(area<0)
+					{
+						w0=-w0;w1=-w1;w2=-w2;
+					}
+					if(w0<0 || w1<0 || w2<0)
+						continue;
+					double_t z((w0*tri[0].z+w1*tri[1].z+w2*tri[2].z)/(w0+w1+w2));
+					columnCrossings.push_back(crossing_t((z-zOrigin)/cellSize,area>0 ? 1 : -1));
+				}
+				//A ray through a shared edge or vertex cross the same surface once for each triangle
+				std::sort(columnCrossings.begin(),columnCrossings.end());
+				std::size_t keptCount(0);
+				for(std::size_t idCrossing=0;idCrossing<columnCrossings.size();idCrossing++)
+				{
+					if(keptCount>0 && columnCrossings[idCrossing].second==crossings.back().second && columnCrossings[idCrossing].first-crossings.back().first<mergeEpsilon)
+						continue;
+					crossings.push_back(columnCrossings[idCrossing]);
+					keptCount++;
+				}
+				crossingOffset[column+1]=keptCount;
+			}
+		});
+		for(std::size_t column=0;column<columnCount;column++)
+			crossingOffset[column+1]+=crossingOffset[column];
+		crossingZ.clear();
+		crossingZ.reserve(crossingOffset[columnCount]);
+		for(unsigned int slab=0;slab<slabCount;slab++)
+		{
+			for(std::size_t idCrossing=0;idCrossing<slabCrossings[slab].size();idCrossing++)
+				crossingZ.push_back(slabCrossings[slab][idCrossing].first);
+			std::vector<crossing_t>().swap(slabCrossings[slab]);
+		}
+		//The crossings are enough to label again, the triangles are not kept for the life of the field
+		std::vector<dvec3>().swap(keptTriangles);
 	}
 
+	/**
+	 * Push the faces of a PLY file to a triangle stream while it is read
+	 */
+	class PlyStreamFeeder : public formatRPLY::t_import_listener
+	{
+	public:
+		PlyStreamFeeder(TriangleScalarFieldCreator& _field,JobProgress* _jobProgress,const dvec3* _boxMin,const dvec3* _boxMax)
+			:field(_field),jobProgress(_jobProgress),boxMin(_boxMin),boxMax(_boxMax),faceRowCount(0),missingVertex(false)
+		{
+		}
+		virtual void VerticesRead(const formatRPLY::t_model& model,std::size_t _faceRowCount)
+		{
+			const std::vector<dvec3>& vertices(model.modelVertices);
+			if(vertices.empty())
+				return;
+			faceRowCount=_faceRowCount;
+			if(boxMin && boxMax)
+			{
+				stream.reset(new TriangleStream(field,*boxMin,*boxMax));
+				return;
+			}
+			//Same bounding box than Mesh
+			dvec3 vertexMin(vertices.front()),vertexMax(vertices.front());
+			for(std::vector<dvec3>::const_iterator itvert=vertices.begin();itvert!=vertices.end();itvert++)
+			{
+				vertexMin.set(MIN(vertexMin.x,itvert->x),MIN(vertexMin.y,itvert->y),MIN(vertexMin.z,itvert->z));
+				vertexMax.set(MAX(vertexMax.x,itvert->x),MAX(vertexMax.y,itvert->y),MAX(vertexMax.z,itvert->z));
+			}
+			stream.reset(new TriangleStream(field,vertexMin,vertexMax));
+		}
+		virtual void FacesRead(const formatRPLY::t_model& model,std::size_t faceBegin,std::size_t faceEnd)
+		{
+			if(!stream)
+				return;
+			if(jobProgress)
+			{
+				jobProgress->CheckCanceled();
+				if(faceRowCount>0)
+					jobProgress->SetProgress(.8f*MIN(1.f,(float)faceEnd/faceRowCount));
+			}
+			const std::vector<dvec3>& vertices(model.modelVertices);
+			for(std::size_t idFace=faceBegin;idFace<faceEnd;idFace++)
+			{
+				const ivec3& indices(model.modelFaces[idFace].indicesSommets);
+				if(indices.a<0 || indices.b<0 || indices.c<0 || (std::size_t)MAX(MAX(indices.a,indices.b),indices.c)>=vertices.size())
+				{
+					missingVertex=true;
+					continue;
+				}
+				//The faces after the last layer index have the default marker
+				const SpatialDiscretization::weight_t marker(idFace<model.modelFacesLayerIndex.size() ? (SpatialDiscretization::weight_t)model.modelFacesLayerIndex[idFace] : 1);
+				stream->Push(vertices[indices.a],vertices[indices.b],vertices[indices.c],marker);
+			}
+		}
+		/**
+		 * Wait for the rasterization of the faces
+		 * @return False if there is no vertex or a face refers to a missing vertex
+		 */
+		bool Finish()
+		{
+			if(!stream)
+				return false;
+			stream->Finish();
+			return !missingVertex;
+		}
+	private:
+		TriangleScalarFieldCreator& field;
+		JobProgress* jobProgress;
+		const dvec3* boxMin;
+		const dvec3* boxMax;
+		std::size_t faceRowCount;
+		bool missingVertex;
+		std::unique_ptr<TriangleStream> stream;
+	};
+
     bool TriangleScalarFieldCreator::LoadPlyModel(const std::string& fileInput)
     {
-        formatRPLY::t_model model3D;
-        if(!formatRPLY::CPly::ImportPly(model3D,fileInput) || model3D.modelVertices.size()==0)
+        if(this->fieldCache.get())
+        {
+            //The cache key is computed from the whole mesh
+            Mesh mesh;
+            mesh.SetThreadCount(this->threadCount);
+            if(!mesh.LoadPly(fileInput))
+                return false;
+            VoxelizeMesh(mesh);
+            return true;
+        }
+        if(jobProgress)
+            jobProgress->CheckCanceled();
+        formatRPLY::t_model model;
+        PlyStreamFeeder feeder(*this,jobProgress,hasModelBounds ? &modelBoxMin : NULL,hasModelBounds ? &modelBoxMax : NULL);
+        if(!formatRPLY::CPly::ImportPly(model,fileInput,&feeder,this->threadCount) || !feeder.Finish())
             return false;
-
-        dvec3 minBoundingBox=(*model3D.modelVertices.begin());
-        dvec3 maxBoundingBox=(*model3D.modelVertices.begin());
-        std::vector<dvec3> vertices_vec;
-        vertices_vec.reserve(model3D.modelVertices.size());
-        for(std::list<dvec3>::iterator itvert=model3D.modelVertices.begin();itvert!=model3D.modelVertices.end();itvert++)
+        if(jobProgress)
         {
-            MAXVEC(maxBoundingBox,(*itvert));
-            MINVEC(minBoundingBox,(*itvert));
-            vertices_vec.push_back(*itvert);
+            jobProgress->CheckCanceled();
+            jobProgress->SetProgress(.8f);
         }
-
-        model3D.modelVertices.clear();
-        this->FirstStep_Params(minBoundingBox,maxBoundingBox);
-        std::list<std::size_t>::iterator itlayerindex=model3D.modelFacesLayerIndex.begin();
-        std::size_t layerIndex=1;
-        for(std::list<formatRPLY::t_face>::iterator itface=model3D.modelFaces.begin();itface!=model3D.modelFaces.end();itface++)
+        if(parityMode)
+            this->ThirdStep_ParityVolumesCreator();
+        else
+            this->ThirdStep_VolumesCreator();
+        return true;
+    }
+    void TriangleScalarFieldCreator::VoxelizeMesh(const Mesh& mesh)
+    {
+        if(mesh.GetVertexCount()==0)
+            throw std::invalid_argument("The mesh has no vertex");
+        //Progress of a job: 20% for the reading, 60% for the triangles and 20% for the labeling
+        if(jobProgress)
         {
-            if(itlayerindex!=model3D.modelFacesLayerIndex.end())
+            jobProgress->CheckCanceled();
+            jobProgress->SetProgress(.2f);
+        }
+        std::string cacheKey;
+        if(this->fieldCache.get())
+        {
+            cacheKey=this->GetCacheKey(mesh);
+            if(this->FetchCachedField(cacheKey))
+                return;
+        }
+        if(hasModelBounds)
+            this->FirstStep_Params(modelBoxMin,modelBoxMax);
+        else
+            this->FirstStep_Params(mesh.GetBoxMin(),mesh.GetBoxMax());
+        const std::vector<dvec3>& vertices(mesh.GetVertices());
+        const std::vector<unsigned int>& faces(mesh.GetFaces());
+        const std::vector<SpatialDiscretization::weight_t>& markers(mesh.GetMarkers());
+        const std::vector<unsigned int>& mortonOrder(mesh.GetMortonOrder());
+        const std::size_t faceCount(mesh.GetFaceCount());
+        for(std::size_t idFace=0;idFace<faceCount;idFace++)
+        {
+            if(jobProgress)
             {
-                layerIndex=*itlayerindex;
-                itlayerindex++;
+                jobProgress->CheckCanceled();
+                jobProgress->SetProgress(.2f+.6f*idFace/faceCount);
             }
-            this->SecondStep_PushTri(vertices_vec[(*itface).indicesSommets.a],
-                vertices_vec[(*itface).indicesSommets.b],
-                vertices_vec[(*itface).indicesSommets.c],
-                layerIndex);
+            const std::size_t face(mortonOrder.empty() ? idFace : mortonOrder[idFace]);
+            this->SecondStep_PushTri(vertices[faces[face*3]],
+                vertices[faces[face*3+1]],
+                vertices[faces[face*3+2]],
+                markers[face]);
         }
-        this->ThirdStep_VolumesCreator();
-		return true;
+        if(jobProgress)
+        {
+            jobProgress->CheckCanceled();
+            jobProgress->SetProgress(.8f);
+        }
+        if(parityMode)
+            this->ThirdStep_ParityVolumesCreator();
+        else
+            this->ThirdStep_VolumesCreator();
+        if(this->fieldCache.get())
+            this->StoreCachedField(cacheKey);
     }
     void TriangleScalarFieldCreator::SecondStep_PushTri(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker)
+	{
+        this->volumeInfo.maximal_marker_index=MAX(this->volumeInfo.maximal_marker_index,marker);
+        this->RestoreSurfaces(); //Surfaces changed, the labeling must be done again
+        KeepParityTriangle(A,B,C);
+        RasterizeTri(A,B,C,marker,0,(SpatialDiscretization::cell_id_t)-1);
+	}
+    void TriangleScalarFieldCreator::KeepParityTriangle(const dvec3& A,const dvec3& B,const dvec3& C)
+	{
+        if(!parityMode || keptTrianglesReleased)
+            return;
+        if(!crossingOffset.empty())
+        {
+            //The crossings do not contain this triangle
+            std::vector<std::size_t>().swap(crossingOffset);
+            std::vector<double_t>().swap(crossingZ);
+            keptTrianglesReleased=true;
+            return;
+        }
+        keptTriangles.push_back(A);
+        keptTriangles.push_back(B);
+        keptTriangles.push_back(C);
+	}
+    void TriangleScalarFieldCreator::RasterizeTri(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker,const SpatialDiscretization::cell_id_t& xBegin,const SpatialDiscretization::cell_id_t& xEnd)
 	{
 		#ifdef _DEBUG
 		bool insideABox(false);
 		#endif
-        this->volumeInfo.maximal_marker_index=MAX(this->volumeInfo.maximal_marker_index,marker);
 		using namespace SpatialDiscretization;
 		ivec3 minRange,maxRange;
 		GetRangeIntersectedBoundingCubeByTri(this->volumeInfo.cellCount,this->volumeInfo.mainVolumeCenter,this->volumeInfo.cellSize,A,B,C,minRange,maxRange);
+		const cell_id_t xFirst(MAX((cell_id_t)minRange.x,xBegin));
+		const cell_id_t xLast(MIN((cell_id_t)maxRange.x,xEnd-1));
+		if(xFirst>xLast)
+			return;
         double_t boxhalfsize[3],triverts[3][3];
 
         memcpy(boxhalfsize,&this->volumeInfo.cellHalfSize,sizeof(dvec3));
@@ -136,7 +521,8 @@ namespace ScalarFieldBuilders
 
 		//Todo multi-thread sur X ou X,Y
         dvec3 boxcenter;
-		for(cell_id_t cell_x=minRange.x;cell_x<=(cell_id_t)maxRange.x;cell_x++)
+        weight_matrix& matrix(this->GetFieldData());
+		for(cell_id_t cell_x=xFirst;cell_x<=xLast;cell_x++)
 		{
 			for(cell_id_t cell_y=minRange.y;cell_y<=(cell_id_t)maxRange.y;cell_y++)
 			{
@@ -146,13 +532,13 @@ namespace ScalarFieldBuilders
 					if(boxtri_test::triBoxOverlap(boxcenter,boxhalfsize,triverts)==1)
 					{
 						//TODO optimize to set a range of Z to the corresponding values
-						(*this->fieldData)[cell_x][cell_y].SetData(cell_z,this->domainInformation,weight_t(marker));
+						matrix[cell_x][cell_y].SetData(cell_z,this->domainInformation,weight_t(marker));
 
 						#ifdef _DEBUG
 						insideABox=true;
 						//Check Z length
 						cell_id_t cell_z_test=0;
-						zcell* currentCell=&((*this->fieldData)[cell_x][cell_y]);
+						zcell* currentCell=&(matrix[cell_x][cell_y]);
 						while(currentCell)
 						{
 
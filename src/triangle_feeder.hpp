@@ -20,13 +20,16 @@
  */
 
 #include "scalar_field_creator.hpp"
+#include "field_cache.hpp"
+#include "mesh.hpp"
 
 #ifndef __TRIANGLE_SCALARFIELDBUILDERS__
 #define __TRIANGLE_SCALARFIELDBUILDERS__
 
 namespace ScalarFieldBuilders
 {
-
+class JobProgress;
+class TriangleStream;
 
 class TriangleScalarFieldCreator : public ScalarFieldCreator
 {
@@ -44,7 +47,103 @@ public:
   * @param marker Marker of the triangle. [0-32768]
   */
  void SecondStep_PushTri(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker=1);
+ /**
+  * Read the PLY file and voxelize it. Without cache the triangles are fed by the thread count of the field while
+  * the file is read, with a cache the file is read in a Mesh and voxelized by VoxelizeMesh.
+  * @return False if the file can not be read or a face refers to a missing vertex, then the field is not labeled
+  */
  bool LoadPlyModel(const std::string& fileInput);
+ /**
+  * LoadPlyModel and VoxelizeMesh fit the domain to these bounds instead of the bounding box of the vertices. The model must be inside.
+  */
+ void SetModelBounds(const dvec3& boxMin,const dvec3& boxMax);
+ /**
+  * @return False if the domain is fitted to the bounding box of the vertices, then the bounds are not modified
+  */
+ bool GetModelBounds(dvec3& boxMin,dvec3& boxMax);
+ /**
+  * LoadPlyModel and VoxelizeMesh fit the domain to the bounding box of the vertices (default)
+  */
+ void ClearModelBounds();
+ /**
+  * Fit the domain to the bounding box of the mesh or to the model bounds, push its triangles (in Morton order if the mesh has one) and label the volumes.
+  * The mesh is not modified, it can be voxelized by other fields at the same time.
+  */
+ void VoxelizeMesh(const Mesh& mesh);
+ virtual void FirstStep_Params(const dvec3& boxMin,const dvec3& boxMax);
+ /**
+  * Keep the pushed triangles to label the volumes by parity ray casting. Must be set before pushing the triangles.
+  * Then LoadPlyModel and VoxelizeMesh use ThirdStep_ParityVolumesCreator instead of ThirdStep_VolumesCreator.
+  */
+ void SetParityMode(bool _parityMode);
+ bool GetParityMode();
+ /**
+  * Solid voxelization of a watertight mesh: the empty cells are inside if a ray cast along Z from the cell center cross
+  * an odd number of triangles. Columns where the crossings are not consistent with the surface cells are labeled by propagation.
+  * All the interior cells get the first volume id after the exterior.
+  * The kept triangles are replaced by their crossings with the rays on the first call, the volumes can be labeled again from
+  * the crossings (after SetTransparentMarkers for example). Throw std::runtime_error if the crossings do not match the surfaces,
+  * after Load or a triangle pushed after the first call; then FirstStep_Params must be called and the triangles pushed again.
+  */
+ void ThirdStep_ParityVolumesCreator();
+ /**
+  * Keep the labeled fields of LoadPlyModel and VoxelizeMesh in a directory. A model already loaded with the same triangles, markers
+  * and labeling parameters is read from the directory instead of being fed and labeled again.
+  * @param directory Cache directory, created if it does not exist. Empty to disable the cache (default).
+  * @param maxSize Size cap of the directory in bytes, the least recently used fields are removed above it. 0 for no cap.
+  */
+ void SetCache(const std::string& directory,const unsigned long long& maxSize=0);
+ /**
+  * Cache directory, empty if there is no cache
+  */
+ std::string GetCacheDirectory();
+ unsigned long long GetCacheMaxSize();
+ /**
+  * Cache key of a mesh with the current resolution and labeling parameters
+  */
+ std::string GetCacheKey(const Mesh& mesh) const;
+ /**
+  * Load the field of the key from the cache
+  * @return False if there is no cache or the key is not in it
+  */
+ bool FetchCachedField(const std::string& key);
+ /**
+  * Save the labeled field under the key, nothing is done if there is no cache
+  */
+ void StoreCachedField(const std::string& key);
+ /**
+  * LoadPlyModel and VoxelizeMesh report their progress to the job and throws JobCanceled when the job is canceled
+  * @param _jobProgress Not owned by the field, NULL to detach the job (default)
+  */
+ void SetJobProgress(JobProgress* _jobProgress);
+private:
+ friend class TriangleStream;
+ /**
+  * Load the runs of the field, the kept triangles are released as they do not match the loaded field
+  */
+ virtual void LoadMapping(const PTR<file_tools::FileMapping>& mapping);
+ /**
+  * Set the cells of the triangle in the X slab [xBegin,xEnd)
+  */
+ void RasterizeTri(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker,const SpatialDiscretization::cell_id_t& xBegin,const SpatialDiscretization::cell_id_t& xEnd);
+ /**
+  * Keep the triangle for the parity labeling, the crossings are released if they are already built
+  */
+ void KeepParityTriangle(const dvec3& A,const dvec3& B,const dvec3& C);
+ /**
+  * Compute the crossings of the kept triangles with the ray at the center of each column, then release the triangles
+  */
+ void BuildCrossings();
+ bool parityMode;
+ bool hasModelBounds;
+ dvec3 modelBoxMin;
+ dvec3 modelBoxMax;
+ JobProgress* jobProgress;
+ PTR<FieldCache> fieldCache;
+ std::vector<dvec3> keptTriangles;
+ std::vector<std::size_t> crossingOffset; //Built by the parity labeling from the kept triangles, empty before
+ std::vector<double_t> crossingZ;
+ bool keptTrianglesReleased; //Set by Load and by a triangle pushed after the crossings, the parity labeling is not possible
 };
 
 }
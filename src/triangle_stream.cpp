@@ -0,0 +1,143 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "triangle_stream.hpp"
+#include <algorithm>
+#include <tools/parallel_for.hpp>
+
+namespace ScalarFieldBuilders
+{
+	TriangleStream::TriangleStream(TriangleScalarFieldCreator& _field,const dvec3& boxMin,const dvec3& boxMax,const std::size_t& _batchSize,const std::size_t& _queueSize)
+		:field(_field),batchSize(std::max(_batchSize,(std::size_t)1)),queueSize(std::max(_queueSize,(std::size_t)1)),firstBatch(0),closed(false),stopped(false)
+	{
+		using namespace SpatialDiscretization;
+		field.FirstStep_Params(boxMin,boxMax);
+		field.RestoreSurfaces();
+		field.GetFieldData(); //Allocated before the feeders share it
+		const cell_id_t size(field.volumeInfo.cellCount);
+		const unsigned int feederCount(parallel_tools::ResolveThreadCount(field.threadCount,size));
+		feederBatch.assign(feederCount,0);
+		for(unsigned int feeder=0;feeder<feederCount;feeder++)
+		{
+			const cell_id_t xBegin((cell_id_t)((std::size_t)size*feeder/feederCount));
+			const cell_id_t xEnd((cell_id_t)((std::size_t)size*(feeder+1)/feederCount));
+			feeders.push_back(std::thread(&TriangleStream::FeedLoop,this,feeder,xBegin,xEnd));
+		}
+	}
+	TriangleStream::~TriangleStream()
+	{
+		Stop();
+	}
+	void TriangleStream::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			stopped=true;
+		}
+		queueChanged.notify_all();
+		for(std::vector<std::thread>::iterator itfeeder=feeders.begin();itfeeder!=feeders.end();itfeeder++)
+		{
+			if(itfeeder->joinable())
+				itfeeder->join();
+		}
+	}
+	void TriangleStream::Push(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker)
+	{
+		//Same field state than SecondStep_PushTri, updated by the pushing thread only
+		field.volumeInfo.maximal_marker_index=std::max(field.volumeInfo.maximal_marker_index,marker);
+		field.KeepParityTriangle(A,B,C);
+		if(!currentBatch)
+		{
+			currentBatch.reset(new triangle_batch_t());
+			currentBatch->vertices.reserve(batchSize*3);
+			currentBatch->markers.reserve(batchSize);
+		}
+		currentBatch->vertices.push_back(A);
+		currentBatch->vertices.push_back(B);
+		currentBatch->vertices.push_back(C);
+		currentBatch->markers.push_back(marker);
+		if(currentBatch->markers.size()>=batchSize)
+			PostBatch();
+	}
+	void TriangleStream::PostBatch()
+	{
+		std::shared_ptr<const triangle_batch_t> batch(currentBatch.release());
+		std::unique_lock<std::mutex> lock(queueMutex);
+		queueChanged.wait(lock,[this]{ return batches.size()<queueSize || error || stopped; });
+		if(error || stopped)
+			return; //Finish rethrows the error
+		batches.push_back(batch);
+		lock.unlock();
+		queueChanged.notify_all();
+	}
+	void TriangleStream::Finish()
+	{
+		if(currentBatch)
+			PostBatch();
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			closed=true;
+			queueChanged.notify_all();
+			queueChanged.wait(lock,[this]{ return batches.empty() || error; });
+		}
+		Stop();
+		if(error)
+			std::rethrow_exception(error);
+	}
+	void TriangleStream::FeedLoop(unsigned int feeder,SpatialDiscretization::cell_id_t xBegin,SpatialDiscretization::cell_id_t xEnd)
+	{
+		try
+		{
+			while(true)
+			{
+				std::shared_ptr<const triangle_batch_t> batch;
+				{
+					std::unique_lock<std::mutex> lock(queueMutex);
+					queueChanged.wait(lock,[&]{ return feederBatch[feeder]<firstBatch+batches.size() || closed || stopped || error; });
+					if(feederBatch[feeder]>=firstBatch+batches.size() || stopped || error)
+						return;
+					batch=batches[feederBatch[feeder]-firstBatch];
+				}
+				for(std::size_t idTri=0;idTri<batch->markers.size();idTri++)
+					field.RasterizeTri(batch->vertices[idTri*3],batch->vertices[idTri*3+1],batch->vertices[idTri*3+2],batch->markers[idTri],xBegin,xEnd);
+				{
+					//The batch is removed once all the feeders did it
+					std::lock_guard<std::mutex> lock(queueMutex);
+					feederBatch[feeder]++;
+					const std::size_t doneBatch(*std::min_element(feederBatch.begin(),feederBatch.end()));
+					while(firstBatch<doneBatch)
+					{
+						batches.pop_front();
+						firstBatch++;
+					}
+				}
+				queueChanged.notify_all();
+			}
+		} catch(...)
+		{
+			{
+				std::lock_guard<std::mutex> lock(queueMutex);
+				if(!error)
+					error=std::current_exception();
+			}
+			queueChanged.notify_all();
+		}
+	}
+}
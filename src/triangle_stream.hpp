@@ -0,0 +1,89 @@
+/*
+ *     This file is part of FastVoxel.
+ *
+ *     FastVoxel is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     FastVoxel is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *     along with FastVoxel.  If not, see <http://www.gnu.org/licenses/>.
+ * FastVoxel is a voxelisation library of polygonal 3d model and do volumes identifications.
+ * It is dedicated to finite element solvers
+ * @author Nicolas Fortin , Judicaël Picaut judicael.picaut (home) ifsttar.fr
+ * Official repository is https://github.com/nicolas-f/FastVoxel
+ */
+#include "triangle_feeder.hpp"
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef __TRIANGLE_STREAM__
+#define __TRIANGLE_STREAM__
+
+namespace ScalarFieldBuilders
+{
+	/**
+	 * Feed the triangles of a model while it is read. The reading thread push the triangles in batches to a bounded queue,
+	 * each feeder thread rasterize all the batches in its own slab of X cells. The cells get their triangles in the push
+	 * order, so the field is the same as with SecondStep_PushTri whatever the thread count.
+	 */
+	class TriangleStream
+	{
+	public:
+		/**
+		 * Fit the domain of the field to the bounding box and start the feeder threads (the thread count of the field)
+		 * @param batchSize Triangles count of a batch
+		 * @param queueSize Batches count waiting for the feeders, Push waits above it
+		 */
+		TriangleStream(TriangleScalarFieldCreator& field,const dvec3& boxMin,const dvec3& boxMax,const std::size_t& batchSize=4096,const std::size_t& queueSize=16);
+		/**
+		 * Stop the feeders without waiting for the queued batches
+		 */
+		~TriangleStream();
+		/**
+		 * Append a triangle, the triangle must be in the domain
+		 */
+		void Push(const dvec3& A,const dvec3& B,const dvec3& C,const SpatialDiscretization::weight_t& marker=1);
+		/**
+		 * Wait for the rasterization of the pushed triangles and stop the feeders. Rethrow the first error of the feeders.
+		 */
+		void Finish();
+	private:
+		TriangleStream(const TriangleStream&);
+		TriangleStream& operator=(const TriangleStream&);
+		struct triangle_batch_t
+		{
+			std::vector<dvec3> vertices; /*!< 3 vertices per triangle */
+			std::vector<SpatialDiscretization::weight_t> markers;
+		};
+		void PostBatch();
+		void FeedLoop(unsigned int feeder,SpatialDiscretization::cell_id_t xBegin,SpatialDiscretization::cell_id_t xEnd);
+		void Stop();
+
+		TriangleScalarFieldCreator& field;
+		std::size_t batchSize;
+		std::size_t queueSize;
+		std::unique_ptr<triangle_batch_t> currentBatch;
+		std::mutex queueMutex;
+		std::condition_variable queueChanged;
+		std::deque<std::shared_ptr<const triangle_batch_t> > batches;
+		std::size_t firstBatch; /*!< Index of the first batch of the queue */
+		std::vector<std::size_t> feederBatch; /*!< Next batch of each feeder */
+		bool closed;
+		bool stopped;
+		std::exception_ptr error;
+		std::vector<std::thread> feeders;
+	};
+}
+
+#endif